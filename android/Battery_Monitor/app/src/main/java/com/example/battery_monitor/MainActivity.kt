@@ -41,11 +41,13 @@ class MainActivity : PermissionsAwareActivity() {
     private val processor by lazy {
         ProcessManager("Process", this, notifier,
             addressMapper = { addr ->
-            when (addr) {
-                secrets.DEVICE_ADDR -> "${secrets.DEVICE_NAME} ($addr)"
-                else -> addr
-            }
-        })
+                when (addr) {
+                    secrets.DEVICE_ADDR -> "${secrets.DEVICE_NAME} ($addr)"
+                    else -> addr
+                }
+            },
+            onDiagnosticsRequest = { connector.requestDiagnostics() }
+        )
     }
     private val connector by lazy {
         ConnectManager ("Connnect", this,
@@ -13,7 +13,10 @@ import android.bluetooth.le.ScanFilter
 import android.bluetooth.le.ScanSettings
 import android.os.ParcelUuid
 import android.util.Log
+import org.json.JSONObject
 import java.nio.charset.StandardCharsets
+import java.time.Instant
+import java.time.format.DateTimeFormatter
 import java.util.UUID
 
 @SuppressLint("MissingPermission")
@@ -40,9 +43,12 @@ class BluetoothDeviceHandler(
         private val onDisconnected: (BluetoothDeviceConnection) -> Unit,
         private val onError: (BluetoothDeviceConnection) -> Unit,
         private val onDiscovered: (BluetoothDeviceConnection) -> Unit,
+        private val onSubscribed: (BluetoothDeviceConnection) -> Unit,
         private val onReceived: (BluetoothDeviceConnection, UUID, String) -> Unit
     ) {
         private var gatt: BluetoothGatt? = null
+        private val reassemblers = mutableMapOf<UUID, ConnectDecoder.Reassembler>()    // each characteristic chunks its own frames
+        private val subscriptions = ArrayDeque<UUID>()    // one descriptor write at a time
         private val callback = object : BluetoothGattCallback() {
             override fun onConnectionStateChange(gatt: BluetoothGatt, status: Int, newState: Int) {
                 when (status) {
@@ -71,7 +77,14 @@ class BluetoothDeviceHandler(
                 }
             }
             override fun onCharacteristicChanged(gatt: BluetoothGatt, characteristic: BluetoothGattCharacteristic, value: ByteArray) {
-                onReceived(this@BluetoothDeviceConnection, characteristic.uuid, String(value))
+                reassemblers.getOrPut(characteristic.uuid) { ConnectDecoder.Reassembler() }
+                    .chunk(value)?.let { onReceived(this@BluetoothDeviceConnection, characteristic.uuid, ConnectDecoder.decode(it)) }
+            }
+            override fun onDescriptorWrite(gatt: BluetoothGatt, descriptor: BluetoothGattDescriptor, status: Int) {
+                if (status != BluetoothGatt.GATT_SUCCESS) {
+                    Log.e(tag, "onDescriptorWrite: error=$status (${descriptor.characteristic.uuid})")
+                    onError(this@BluetoothDeviceConnection)
+                } else if (!subscribeNext()) onError(this@BluetoothDeviceConnection)
             }
             override fun onMtuChanged(gatt: BluetoothGatt, mtu: Int, status: Int) {
                 if (status != BluetoothGatt.GATT_SUCCESS) {
@@ -90,10 +103,24 @@ class BluetoothDeviceHandler(
                 discoverServices()
             }
         } != null
-        fun enableNotifications(): Boolean = tag.withOperation("GATT", "enableNotifications") {
+        // data, and diag which the device only sends when asked; the device also has alarms, but they are in the data
+        fun enableNotifications(): Boolean {
+            subscriptions.clear()
+            subscriptions.addAll(listOf(config.characteristicUuid, config.characteristicDiagUuid))
+            return subscribeNext()
+        }
+        private fun subscribeNext(): Boolean {
+            val uuid = subscriptions.removeFirstOrNull() ?: return true.also { onSubscribed(this) }
+            if (uuid != config.characteristicUuid && gatt?.getService(config.serviceUuid)?.getCharacteristic(uuid) == null) {
+                Log.d(tag, "Device has no characteristic $uuid, older firmware")
+                return subscribeNext()
+            }
+            return enableNotification(uuid)
+        }
+        private fun enableNotification(uuid: UUID): Boolean = tag.withOperation("GATT", "enableNotification") {
             gatt?.let { gatt ->
                 gatt.getService(config.serviceUuid)
-                    ?.getCharacteristic(config.characteristicUuid)
+                    ?.getCharacteristic(uuid)
                     ?.let { characteristic ->
                         val descriptor = characteristic.getDescriptor(UUID.fromString("00002902-0000-1000-8000-00805f9b34fb"))
                         when {
@@ -113,7 +140,7 @@ class BluetoothDeviceHandler(
         fun write(value: String): Boolean = tag.withOperation("GATT", "write") {
             gatt?.let { gatt ->
                 gatt.getService(config.serviceUuid)
-                    ?.getCharacteristic(config.characteristicUuid)
+                    ?.let { it.getCharacteristic(config.characteristicControlUuid) ?: it.getCharacteristic(config.characteristicUuid) }
                     ?.let { characteristic ->
                         when {
                             gatt.writeCharacteristic(characteristic, value.toByteArray(StandardCharsets.UTF_8), BluetoothGattCharacteristic.WRITE_TYPE_DEFAULT) == BluetoothStatusCodes.SUCCESS -> true
@@ -135,20 +162,24 @@ class BluetoothDeviceHandler(
 
     //
 
+    private val assembler = ConnectDecoder.Assembler(tag) { connection.write(it) }
+
     private val connection = BluetoothDeviceConnection(tag, activity,
         config,
         onDiscovered = {
             Log.d(tag, "Device discovered")
-            if (it.enableNotifications()) {
-                Log.d(tag, "Device notifications enabled on ${config.characteristicUuid}")
-                setConnectionIsConnected()
-            } else {
+            if (!it.enableNotifications()) {
                 Log.e(tag, "Device service ${config.serviceUuid} or characteristic ${config.characteristicUuid} not found")
                 setConnectionDoReconnect()
             }
         },
+        onSubscribed = {
+            Log.d(tag, "Device notifications enabled on ${config.characteristicUuid}")
+            setConnectionIsConnected()
+        },
         onConnected = {
             Log.d(tag, "Device connected")
+            assembler.reset()
             setConnectionIsActive()
             it.discover().let { discovered ->
                 if (!discovered) setConnectionDoReconnect()
@@ -157,7 +188,7 @@ class BluetoothDeviceHandler(
         onReceived = { _, uuid, value ->
             Log.d(tag, "Device received ($uuid): $value")
             setConnectionIsActive()
-            dataCallback(value)
+            assembler.frame(value)?.let { dataCallback(it) }
         },
         onKeepalive = {
             setConnectionIsActive()
@@ -216,4 +247,13 @@ class BluetoothDeviceHandler(
     override fun doConnectionIdentify(): Boolean {
         return connection.write(connectInfo.toJsonString())
     }
+    fun requestDiagnostics(): Boolean {
+        if (!isConnected()) return false
+        Log.d(tag, "Device diagnostics requested")
+        return connection.write(JSONObject().apply {
+            put("type", "ctrl")
+            put("time", DateTimeFormatter.ISO_INSTANT.format(Instant.now()))
+            put("ctrl", "diag")
+        }.toString())
+    }
 }
\ No newline at end of file
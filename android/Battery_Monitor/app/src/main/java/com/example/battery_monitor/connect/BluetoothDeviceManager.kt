@@ -30,6 +30,8 @@ class BluetoothDeviceManager(
         val deviceName: String,
         val serviceUuid: UUID = UUID.fromString("4fafc201-1fb5-459e-8fcc-c5c9c331914b"),
         val characteristicUuid: UUID = UUID.fromString("beb5483e-36e1-4688-b7f5-ea07361b26a8"),
+        val characteristicDiagUuid: UUID = UUID.fromString("beb5483f-36e1-4688-b7f5-ea07361b26a8"),
+        val characteristicControlUuid: UUID = UUID.fromString("beb54841-36e1-4688-b7f5-ea07361b26a8"),
         val connectionScanDelay : Int = 5,
         val connectionScanPeriod : Int = 30,
         val connectionActiveCheck: Int = 15,
@@ -50,4 +52,6 @@ class BluetoothDeviceManager(
         isAvailable = { adapter.isEnabled() },
         isPermitted = { permissions.allowed },
     )
+
+    fun requestDiagnostics() = device.requestDiagnostics()
 }
\ No newline at end of file
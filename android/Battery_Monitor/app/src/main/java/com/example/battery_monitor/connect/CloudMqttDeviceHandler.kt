@@ -173,11 +173,14 @@ class CloudMqttDeviceHandler(
     private var root = "${config.root}/${connectInfo.deviceAddress}"
     private var topic = ""
 
+    private val assembler = ConnectDecoder.Assembler(tag) { }    // no way back to the device, so wait for its next keyframe
+
     private val connection = MqttDeviceConnection(tag,
         config,
         connectInfo.identity,
         onConnected = {
             Log.d(tag, "Device connected")
+            assembler.reset()
             setConnectionIsConnected()
             if (topic.isNotEmpty())
                 if (!it.subscribe(topic))
@@ -186,7 +189,7 @@ class CloudMqttDeviceHandler(
         onReceived = { _, value ->
             Log.d(tag, "Device received: $value")
             setConnectionIsActive()
-            dataCallback(value)
+            assembler.frame(value)?.let { dataCallback(it) }
         },
         onKeepalive = {
             setConnectionIsActive()
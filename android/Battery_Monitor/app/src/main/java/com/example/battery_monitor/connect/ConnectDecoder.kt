@@ -0,0 +1,161 @@
+package com.example.battery_monitor.connect
+
+import android.util.Log
+import org.json.JSONArray
+import org.json.JSONObject
+import java.io.ByteArrayOutputStream
+import java.nio.ByteBuffer
+import java.nio.charset.StandardCharsets
+import java.time.Instant
+import java.time.format.DateTimeFormatter
+
+// frames arrive as json text or as MessagePack of the same document, told apart by the first byte ('{' vs a map)
+object ConnectDecoder {
+
+    fun isMsgPack(value: ByteArray): Boolean =
+        value.isNotEmpty() && (value[0].toInt() and 0xff).let { it in 0x80..0x8f || it == 0xde || it == 0xdf }
+
+    fun decode(value: ByteArray): String =
+        if (isMsgPack(value)) (MsgPackReader(ByteBuffer.wrap(value)).value() as JSONObject).toString()
+        else String(value, StandardCharsets.UTF_8)
+
+    // keyframe plus delta frames back into full frames: a keyframe ("key": true) replaces the state, a delta applies
+    // to it if its "seq" follows on, otherwise deltas are dropped and a keyframe asked for; frames without "seq" are
+    // already full
+    class Assembler(private val tag: String, private val requestKeyframe: (String) -> Unit) {
+        private var state: JSONObject? = null
+        private var expected = 0L
+        private var dropped = 0
+
+        fun reset() {
+            state = null
+            dropped = 0
+        }
+        fun frame(value: String): String? {
+            val frame = try { JSONObject(value) } catch (e: Exception) { return value }
+            if (!frame.has("seq")) return value
+            val seq = frame.remove("seq").toString().toLong()
+            val key = frame.remove("key") == true
+            val current = state
+            when {
+                key -> state = frame
+                current == null || seq != expected -> {
+                    state = null
+                    if (dropped++ % KEYFRAME_REQUEST_EVERY == 0) {
+                        Log.d(tag, "Assembler: delta seq=$seq without its keyframe (expected=$expected), requesting")
+                        requestKeyframe(keyframeRequest())
+                    }
+                    return null
+                }
+                else -> merge(current, frame)
+            }
+            dropped = 0
+            expected = seq + 1
+            return state.toString()
+        }
+
+        private fun merge(target: Any, change: JSONObject) {
+            for (name in change.keys()) {
+                val value = change.get(name)
+                when (target) {
+                    is JSONArray -> {
+                        val index = name.toInt()
+                        val existing = target.opt(index)
+                        if (value is JSONObject && (existing is JSONObject || existing is JSONArray)) merge(existing, value)
+                        else target.put(index, value)
+                    }
+                    is JSONObject -> {
+                        val existing = target.opt(name)
+                        when {
+                            value == JSONObject.NULL -> target.remove(name)
+                            value is JSONObject && (existing is JSONObject || existing is JSONArray) -> merge(existing, value)
+                            else -> target.put(name, value)
+                        }
+                    }
+                }
+            }
+        }
+        private fun keyframeRequest(): String =
+            JSONObject().apply {
+                put("type", "ctrl")
+                put("time", DateTimeFormatter.ISO_INSTANT.format(Instant.now()))
+                put("ctrl", "keyframe")
+            }.toString()
+
+        companion object {
+            private const val KEYFRAME_REQUEST_EVERY = 5    // dropped deltas, in case the request itself was lost
+        }
+    }
+
+    // frames larger than the link's payload arrive as chunks of [0x1e, frame, index, total] and the next part of it,
+    // in order; a chunk from another frame means the rest of this one was lost
+    class Reassembler {
+        private var frame = -1
+        private var parts = arrayOfNulls<ByteArray>(0)
+        private var received = 0
+
+        fun chunk(value: ByteArray): ByteArray? {
+            if (!isChunk(value)) return value
+            val id = value[1].toInt() and 0xff
+            val index = value[2].toInt() and 0xff
+            val total = value[3].toInt() and 0xff
+            if (id != frame || parts.size != total) {
+                frame = id
+                parts = arrayOfNulls(total)
+                received = 0
+            }
+            if (index >= total || parts[index] != null) return null
+            parts[index] = value.copyOfRange(CHUNK_HEADER, value.size)
+            if (++received < total) return null
+            frame = -1
+            return ByteArrayOutputStream().apply { parts.forEach { write(it!!) } }.toByteArray()
+        }
+    }
+    private const val CHUNK_MARKER = 0x1e
+    private const val CHUNK_HEADER = 4
+    private fun isChunk(value: ByteArray): Boolean = value.size >= CHUNK_HEADER && value[0].toInt() == CHUNK_MARKER
+
+    private class MsgPackReader(private val buffer: ByteBuffer) {
+        private fun u8(): Int = buffer.get().toInt() and 0xff
+        private fun u16(): Int = buffer.getShort().toInt() and 0xffff
+        private fun u32(): Long = buffer.getInt().toLong() and 0xffffffffL
+        private fun string(length: Int): String = ByteArray(length).also { buffer.get(it) }.toString(StandardCharsets.UTF_8)
+        private fun array(length: Int): JSONArray = JSONArray().apply { repeat(length) { put(value()) } }
+        private fun map(length: Int): JSONObject = JSONObject().apply { repeat(length) { put(value().toString(), value()) } }
+        private fun float(value: Float): Double = value.toString().toDouble()    // float32 on the wire, keep its shortest form (3.3, not 3.299999952)
+
+        fun value(): Any {
+            val b = u8()
+            return when {
+                b <= 0x7f -> b
+                b >= 0xe0 -> b - 0x100
+                b in 0x80..0x8f -> map(b and 0x0f)
+                b in 0x90..0x9f -> array(b and 0x0f)
+                b in 0xa0..0xbf -> string(b and 0x1f)
+                else -> when (b) {
+                    0xc0 -> JSONObject.NULL
+                    0xc2 -> false
+                    0xc3 -> true
+                    0xca -> float(buffer.getFloat())
+                    0xcb -> buffer.getDouble()
+                    0xcc -> u8()
+                    0xcd -> u16()
+                    0xce -> u32()
+                    0xcf -> buffer.getLong()
+                    0xd0 -> buffer.get().toInt()
+                    0xd1 -> buffer.getShort().toInt()
+                    0xd2 -> buffer.getInt()
+                    0xd3 -> buffer.getLong()
+                    0xd9 -> string(u8())
+                    0xda -> string(u16())
+                    0xdb -> string(u32().toInt())
+                    0xdc -> array(u16())
+                    0xdd -> array(u32().toInt())
+                    0xde -> map(u16())
+                    0xdf -> map(u32().toInt())
+                    else -> throw IllegalArgumentException("MsgPack: unsupported type 0x${b.toString(16)} at ${buffer.position() - 1}")
+                }
+            }
+        }
+    }
+}
@@ -43,6 +43,7 @@ class ConnectInfo(
             put("time", DateTimeFormatter.ISO_INSTANT.format(Instant.now()))
             put("info", identity)
             put("peer", deviceAddress)
+            put("format", "msgpack")
         }.toString()
     }
 }
\ No newline at end of file
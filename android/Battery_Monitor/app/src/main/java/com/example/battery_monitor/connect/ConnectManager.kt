@@ -123,4 +123,7 @@ class ConnectManager(
     private fun onDoubleTap() {
         managers.forEach { it.onDoubleTap() }
     }
+    fun requestDiagnostics() {    // bluetooth only, the others have them pushed
+        managerDirect.requestDiagnostics()
+    }
 }
\ No newline at end of file
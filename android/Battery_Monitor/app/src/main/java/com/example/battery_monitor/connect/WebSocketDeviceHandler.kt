@@ -7,6 +7,7 @@ import org.java_websocket.client.WebSocketClient
 import org.java_websocket.framing.Framedata
 import org.java_websocket.handshake.ServerHandshake
 import java.net.URI
+import java.nio.ByteBuffer
 
 class WebSocketDeviceHandler(
     tag: String,
@@ -42,6 +43,11 @@ class WebSocketDeviceHandler(
                     Log.d(tag, "onMessage: $message")
                     onReceived(this@WebSocketDeviceConnection, message)
                 }
+                override fun onMessage(bytes: ByteBuffer) {
+                    val message = ConnectDecoder.decode(ByteArray(bytes.remaining()).also { bytes.get(it) })
+                    Log.d(tag, "onMessage: (binary) $message")
+                    onReceived(this@WebSocketDeviceConnection, message)
+                }
                 override fun onClose(code: Int, reason: String, remote: Boolean) {
                     Log.d(tag, "onClose: remote=$remote, code=$code, reason='$reason'")
                     if (remote) onDisconnected(this@WebSocketDeviceConnection)
@@ -78,16 +84,19 @@ class WebSocketDeviceHandler(
 
     //
 
+    private val assembler = ConnectDecoder.Assembler(tag) { connection.send(it) }
+
     private val connection = WebSocketDeviceConnection(tag,
         config,
         onConnected = {
             Log.d(tag, "Device connected")
+            assembler.reset()
             setConnectionIsConnected()
         },
         onReceived = { _, value ->
             Log.d(tag, "Device received: $value")
             setConnectionIsActive()
-            dataCallback(value)
+            assembler.frame(value)?.let { dataCallback(it) }
         },
         onKeepalive = {
             setConnectionIsActive()
@@ -30,7 +30,8 @@ class ProcessDataAlarm(
         "UPDATE_VERS" to Alarm("UPDATE_VERS", "Device update", "Device update available"),
         "UPDATE_LONG" to Alarm("UPDATE_LONG", "Device check", "Device update check needed"),
         "SYSTEM_MEMLOW" to Alarm("SYSTEM_MEMLOW", "Device memory", "Device memory low"),
-        "SYSTEM_BADRESET" to Alarm("SYSTEM_BADRESET", "Device fault", "Device reset unexpectedly")
+        "SYSTEM_BADRESET" to Alarm("SYSTEM_BADRESET", "Device fault", "Device reset unexpectedly"),
+        "TYRE_LEAK" to Alarm("TYRE_LEAK", "Tyre leak", "Tyre pressure falling steadily")
     )
     private fun translate(alarmCodes: String): List<Pair<String, String>> {
         return alarmCodes.split(",").mapNotNull { alarms[it.trim()] }.map { Pair(it.name, it.description) }
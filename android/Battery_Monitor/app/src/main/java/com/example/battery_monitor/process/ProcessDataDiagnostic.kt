@@ -13,7 +13,8 @@ import org.json.JSONObject
 
 @SuppressLint("ClickableViewAccessibility")
 class ProcessDataDiagnostic(
-    private val activity: Activity
+    private val activity: Activity,
+    private val onRequest: () -> Unit
 ) {
 
     private val scrollView: ScrollView = activity.findViewById(R.id.diagnosticScrollView)
@@ -26,6 +27,10 @@ class ProcessDataDiagnostic(
                 clear()
                 return true
             }
+            override fun onSingleTapConfirmed(e: MotionEvent): Boolean {
+                onRequest()
+                return true
+            }
         })
     }
 
@@ -9,9 +9,10 @@ class ProcessManager(
     private val tag: String,
     activity: Activity,
     notificationsManager: NotificationsManager,
-    addressMapper: (String) -> String = { addr -> addr }
+    addressMapper: (String) -> String = { addr -> addr },
+    onDiagnosticsRequest: () -> Unit = {}
 ) {
-    private val processDataDiagnostic: ProcessDataDiagnostic = ProcessDataDiagnostic(activity)
+    private val processDataDiagnostic: ProcessDataDiagnostic = ProcessDataDiagnostic(activity, onDiagnosticsRequest)
     private val processDataStatus: ProcessDataStatus = ProcessDataStatus(activity, addressMapper)
     private val processDataAlarm: ProcessDataAlarm = ProcessDataAlarm(activity, notificationsManager)
 
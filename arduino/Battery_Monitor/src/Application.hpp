@@ -50,6 +50,7 @@
 #include "program/Program.hpp"
 #include "factory/FactoryTemperatureCalibration.hpp"
 #include "factory/FactoryHardwareTest.hpp"
+#include "factory/FactoryFanZonesCalibration.hpp"
 
 // -----------------------------------------------------------------------------------------------
 
@@ -93,6 +94,11 @@ void app_setup () {
     // --> tie pin 21 to high to boot to hardware testing
     // --> leave pin 21 n/c to boot normally to program
 #define BOOT_MODE_PIN 21
+#ifdef FACTORY_FANZONES_CALIBRATION    // a build of its own, as it runs for over an hour with the pack warm
+    DEBUG_PRINTF ("BOOT: FAN ZONES CALIBRATION\n");
+    factory_fanZonesCalibration ();
+    esp_deep_sleep_start ();
+#endif
     if (TemperatureSensor_DS18B20::present (BOOT_MODE_PIN)) {
         DEBUG_PRINTF ("BOOT: TEMPERATURE CALIBRATION\n");
         factory_temperatureCalibration ();
@@ -8,6 +8,8 @@ public:
     virtual String name () const = 0;
     virtual void begin (ProgramInterfaceFanControllers &interface, OpenSmart_QuadMotorDriver &hardware) = 0;
     virtual bool setSpeed (const OpenSmart_QuadMotorDriver::MotorSpeed speed) = 0;
+    virtual void process () { }
+    virtual void collectDiagnostics (JsonVariant &) const { }
 };
 
 class ProgramInterfaceFanControllers : public Component, public Diagnosticable {
@@ -17,12 +19,19 @@ public:
     static inline constexpr FanSpeedType FanSpeedMin = 0, FanSpeedMax = (1 << OpenSmart_QuadMotorDriver::MotorSpeedResolution) - 1;
     static inline constexpr size_t FanSpeedRange = (1 << OpenSmart_QuadMotorDriver::MotorSpeedResolution);
 
+    typedef struct {
+        FanSpeedType DEADBAND;    // ignore changes smaller than this, except to/from off
+        float SLEW_RATE;          // speed units per second
+        interval_t DWELL_MINIMUM;
+    } OutputConfig;
+
     typedef struct {
         OpenSmart_QuadMotorDriver::Config hardware;
         FanDirectionType DIRECTION;
         FanSpeedType MIN_SPEED, MAX_SPEED;
         std::array<int, OpenSmart_QuadMotorDriver::MotorCount> MOTOR_ORDER;
-        interval_t MOTOR_ROTATE;
+        interval_t MOTOR_ROTATE, MOTOR_PERSIST;
+        OutputConfig output;
     } Config;
 
 private:
@@ -36,6 +45,35 @@ private:
     StatsWithValue<FanSpeedType> _speedStats;
     ActivationTracker _actives;
 
+    interval_t _changedAt = 0, _processedAt = 0, _processInterval = 0, _outputAt = 0;
+    struct {
+        uint32_t writes = 0, deadband = 0, dwell = 0, slew = 0;
+    } _outputCounts;
+
+    FanSpeedType output (const FanSpeedType speedRequested) {
+        const interval_t now = millis (), tick = std::min (now - _outputAt, _processInterval);    // no more than one interval's slew, however long since the last write
+        _outputAt = now;
+        if (speedRequested == _speed)
+            return _speed;
+        const bool onoff = (speedRequested == FanSpeedMin || _speed == FanSpeedMin);
+        if (! onoff && std::abs (static_cast<int> (speedRequested) - static_cast<int> (_speed)) < static_cast<int> (config.output.DEADBAND)) {
+            _outputCounts.deadband++;
+            return _speed;
+        }
+        if ((now - _changedAt) < config.output.DWELL_MINIMUM) {
+            _outputCounts.dwell++;
+            return _speed;
+        }
+        if (speedRequested != FanSpeedMin && config.output.SLEW_RATE > 0.0f) {    // turning off is not slewed, turning on ramps up from above the stall region, where the strategies map the lowest speeds
+            const int slewMaximum = std::max (1, static_cast<int> (config.output.SLEW_RATE * static_cast<float> (tick) / 1000.0f)), slewRequested = static_cast<int> (speedRequested) - static_cast<int> (_speed);
+            if (std::abs (slewRequested) > slewMaximum) {
+                _outputCounts.slew++;
+                return static_cast<FanSpeedType> (static_cast<int> (_speed) + (slewRequested > 0 ? slewMaximum : -slewMaximum));
+            }
+        }
+        return speedRequested;
+    }
+
 public:
     ProgramInterfaceFanControllers (const Config &cfg, ProgramInterfaceFanControllersStrategy &strategy) :
         config (cfg),
@@ -55,15 +93,23 @@ public:
     void end () {
         _hardware.setSpeed (static_cast<OpenSmart_QuadMotorDriver::MotorSpeed> (0), OpenSmart_QuadMotorDriver::MOTOR_ALL);
     }
+    void process () override {
+        const interval_t now = millis ();
+        if (_processedAt != 0)
+            _processInterval = now - _processedAt;
+        _processedAt = now;
+        _strategy.process ();
+    }
 
-    void setSpeed (const float speed) {
-        const FanSpeedType speedNew = std::clamp (static_cast<FanSpeedType> (map<float> (speed, 0.0f, 100.0f, static_cast<float> (FanSpeedMin), static_cast<float> (FanSpeedMax))), FanSpeedMin, FanSpeedMax);
+    void setSpeed (const float speed) {    // call periodically, as the slew and dwell limits converge over successive calls
+        const FanSpeedType speedNew = output (std::clamp (static_cast<FanSpeedType> (map<float> (speed, 0.0f, 100.0f, static_cast<float> (FanSpeedMin), static_cast<float> (FanSpeedMax))), FanSpeedMin, FanSpeedMax));
         if (speedNew != _speed) {
             DEBUG_PRINTF ("FanInterface::setSpeed: %d\n", speedNew);
             bool active = _strategy.setSpeed (_speed = speedNew);
             if (! _active && active)
                 _actives++, _active = active;
             _speedStats += _speed;
+            _changedAt = millis (), _outputCounts.writes++;
         }
     }
     inline FanSpeedType getSpeed () const {
@@ -73,6 +119,9 @@ public:
     inline const Config &getConfig () const {
         return config;
     }    // yuck
+    inline const OpenSmart_QuadMotorDriver &getHardware () const {
+        return _hardware;
+    }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
@@ -80,7 +129,14 @@ protected:
         sub ["speed"] = _speedStats;
         if (_actives)
             sub ["actives"] = _actives;
+        JsonObject output = sub ["output"].to<JsonObject> ();
+        output ["writes"] = _outputCounts.writes;
+        output ["deadband"] = _outputCounts.deadband;
+        output ["dwell"] = _outputCounts.dwell;
+        output ["slew"] = _outputCounts.slew;
         // % duty
+        JsonVariant strategy = sub;
+        _strategy.collectDiagnostics (strategy);
     }
 };
 
@@ -114,10 +170,10 @@ using ProgramInterfaceFanControllersStrategy_default = ProgramInterfaceFanContro
 
 class ProgramInterfaceFanControllersStrategy_motorMap : public ProgramInterfaceFanControllersStrategy {
     OpenSmart_QuadMotorDriver *_hardware = nullptr;
-    OpenSmart_QuadMotorDriver::MotorSpeed _min_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0), _max_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0);
-    std::array<OpenSmart_QuadMotorDriver::MotorSpeed, OpenSmart_QuadMotorDriver::MotorCount> _motorSpeeds;
 
 protected:
+    OpenSmart_QuadMotorDriver::MotorSpeed _min_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0), _max_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0);
+    std::array<OpenSmart_QuadMotorDriver::MotorSpeed, OpenSmart_QuadMotorDriver::MotorCount> _motorSpeeds;
     std::array<int, OpenSmart_QuadMotorDriver::MotorCount> _motorOrder;
 
 public:
@@ -136,7 +192,7 @@ public:
         for (int i = 0, currentThreshold = 0, totalSpeed = speed * OpenSmart_QuadMotorDriver::MotorCount; i < OpenSmart_QuadMotorDriver::MotorCount; i++, currentThreshold += ProgramInterfaceFanControllers::FanSpeedRange) {
             const int motorId = _motorOrder [i];
             OpenSmart_QuadMotorDriver::MotorSpeed motorSpeed = 0;
-            if (totalSpeed >= (currentThreshold + ProgramInterfaceFanControllers::FanSpeedRange))
+            if (totalSpeed >= (currentThreshold + static_cast<int> (ProgramInterfaceFanControllers::FanSpeedRange)))
                 motorSpeed = _max_speed;
             else if (totalSpeed > currentThreshold && totalSpeed < (currentThreshold + static_cast<int> (ProgramInterfaceFanControllers::FanSpeedRange)))
                 motorSpeed = map (totalSpeed - currentThreshold, 0, ProgramInterfaceFanControllers::FanSpeedRange, _min_speed, _max_speed);
@@ -150,27 +206,297 @@ public:
 };
 
 class ProgramInterfaceFanControllersStrategy_motorMapWithRotation : public ProgramInterfaceFanControllersStrategy_motorMap {
-    Intervalable _rotationInterval;
+    struct MotorWear {
+        uint64_t runtime = 0, duty = 0;    // msecs running, and msecs at full speed equivalent
+    };
+    std::array<MotorWear, OpenSmart_QuadMotorDriver::MotorCount> _motorWear;
+    interval_t _accountedAt = 0;
+    bool _accountedChanged = false;
+    Intervalable _rotationInterval, _persistInterval;
+    PersistentData _persistentData;
+    ActivationTracker _rotations;
+
+    static String persistentName (const char *prefix, const int motorId) {
+        return String (prefix) + ArithmeticToString (motorId);
+    }
+    void wearLoad () {
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            uint32_t runtime = 0, duty = 0;
+            _persistentData.get (persistentName ("run", motorId).c_str (), &runtime);
+            _persistentData.get (persistentName ("duty", motorId).c_str (), &duty);
+            _motorWear [motorId].runtime = static_cast<uint64_t> (runtime) * 1000, _motorWear [motorId].duty = static_cast<uint64_t> (duty) * 1000;
+        }
+    }
+    void wearSave () {    // batched, as NVS pages have limited erase cycles
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            _persistentData.set (persistentName ("run", motorId).c_str (), static_cast<uint32_t> (_motorWear [motorId].runtime / 1000));
+            _persistentData.set (persistentName ("duty", motorId).c_str (), static_cast<uint32_t> (_motorWear [motorId].duty / 1000));
+        }
+        _accountedChanged = false;
+    }
+    void wearAccount () {
+        const interval_t now = millis (), elapsed = now - _accountedAt;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++)
+            if (_motorSpeeds [motorId] > 0) {
+                _motorWear [motorId].runtime += elapsed;
+                _motorWear [motorId].duty += (static_cast<uint64_t> (elapsed) * _motorSpeeds [motorId]) / ProgramInterfaceFanControllers::FanSpeedMax;
+                _accountedChanged = true;
+            }
+        _accountedAt = now;
+    }
+    void wearOrder () {
+        const auto motorOrder = _motorOrder;
+        std::stable_sort (_motorOrder.begin (), _motorOrder.end (), [&] (const int a, const int b) {
+            return _motorWear [a].duty < _motorWear [b].duty;
+        });
+        if (_motorOrder != motorOrder) {
+            DEBUG_PRINTF ("FanInterfaceStrategy_motorMapWithRotation:: rotating, order=[%d,%d,%d,%d]\n", _motorOrder [0], _motorOrder [1], _motorOrder [2], _motorOrder [3]);
+            _rotations++;
+        }
+    }
+    bool motorsActive () const {
+        return std::any_of (_motorSpeeds.begin (), _motorSpeeds.end (), [] (const OpenSmart_QuadMotorDriver::MotorSpeed speed) {
+            return speed > 0;
+        });
+    }
 
 public:
+    ProgramInterfaceFanControllersStrategy_motorMapWithRotation () :
+        _persistentData ("fanwear") { }
     String name () const override {
         return "motorMapWithRotation(" + ArithmeticToString (OpenSmart_QuadMotorDriver::MotorCount) + ")";
     }
     void begin (ProgramInterfaceFanControllers &interface, OpenSmart_QuadMotorDriver &hardware) override {
         DEBUG_PRINTF ("FanInterfaceStrategy_motorMapWithRotation:: order=[");
-        for (int i = 0; i < interface.getConfig ().MOTOR_ORDER.size (); i++)
+        for (size_t i = 0; i < interface.getConfig ().MOTOR_ORDER.size (); i++)
             DEBUG_PRINTF ("%s%d", i == 0 ? "" : ",", interface.getConfig ().MOTOR_ORDER [i]);
-        DEBUG_PRINTF ("], period=%lu\n", interface.getConfig ().MOTOR_ROTATE);
+        DEBUG_PRINTF ("], period=%lu, persist=%lu\n", interface.getConfig ().MOTOR_ROTATE, interface.getConfig ().MOTOR_PERSIST);
         _rotationInterval.reset (interface.getConfig ().MOTOR_ROTATE);
+        _persistInterval.reset (interface.getConfig ().MOTOR_PERSIST);
         ProgramInterfaceFanControllersStrategy_motorMap::begin (interface, hardware);
+        wearLoad ();
+        wearOrder ();
+        _accountedAt = millis ();
     }
     bool setSpeed (const OpenSmart_QuadMotorDriver::MotorSpeed speed) override {
-        if (_rotationInterval) {
-            DEBUG_PRINTF ("FanInterfaceStrategy_motorMapWithRotation:: rotating\n");
-            std::rotate (_motorOrder.begin (), _motorOrder.begin () + 1, _motorOrder.end ());
-        }
+        wearAccount ();
+        if (_rotationInterval || ! motorsActive ())    // reorder freely when idle, otherwise only periodically
+            wearOrder ();
         return ProgramInterfaceFanControllersStrategy_motorMap::setSpeed (speed);
     }
+    void process () override {
+        wearAccount ();
+        if (_persistInterval && _accountedChanged)
+            wearSave ();
+    }
+    void collectDiagnostics (JsonVariant &obj) const override {
+        JsonArray motors = obj ["motors"].to<JsonArray> ();
+        for (const auto &wear : _motorWear)
+            motors.add (ArithmeticToString (static_cast<float> (wear.runtime) / (60.0f * 60.0f * 1000.0f), 1) + "," + ArithmeticToString (static_cast<float> (wear.duty) / (60.0f * 60.0f * 1000.0f), 1));    // hours running, hours at full speed equivalent
+        if (_rotations)
+            obj ["rotations"] = _rotations;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+class ProgramInterfaceFanControllersStrategy_motorOptimal : public ProgramInterfaceFanControllersStrategy {
+    // airflow per fan taken as proportional to speed, and power as proportional to speed cubed, so
+    // for a total airflow D spread over n fans the power is n * (D / n)^3 = D^3 / n^2: spread as widely
+    // as the stall limit (MIN_SPEED) allows, and below that use the fewest fans at the stall limit
+    struct Allocation {
+        uint8_t count;
+        OpenSmart_QuadMotorDriver::MotorSpeed speed;
+    };
+    std::array<Allocation, ProgramInterfaceFanControllers::FanSpeedRange> _allocations;
+
+    OpenSmart_QuadMotorDriver *_hardware = nullptr;
+    std::array<OpenSmart_QuadMotorDriver::MotorSpeed, OpenSmart_QuadMotorDriver::MotorCount> _motorSpeeds;
+    std::array<int, OpenSmart_QuadMotorDriver::MotorCount> _motorOrder;
+
+    static Allocation allocate (const float demand, const float fractionMinimum, const float fractionMaximum) {
+        Allocation allocation { .count = 0, .speed = 0 };
+        if (demand > 0.0f) {
+            float powerBest = std::numeric_limits<float>::max ();
+            for (int count = 1; count <= OpenSmart_QuadMotorDriver::MotorCount; count++) {
+                const float fraction = demand / static_cast<float> (count);
+                if (fraction > fractionMaximum + 1e-3f)
+                    continue;
+                const float fractionActual = std::clamp (fraction, fractionMinimum, fractionMaximum), power = static_cast<float> (count) * fractionActual * fractionActual * fractionActual;
+                if (power < powerBest - 1e-6f)
+                    powerBest = power, allocation.count = static_cast<uint8_t> (count), allocation.speed = static_cast<OpenSmart_QuadMotorDriver::MotorSpeed> (std::round (fractionActual * ProgramInterfaceFanControllers::FanSpeedMax));
+            }
+        }
+        return allocation;
+    }
+
+public:
+    String name () const override {
+        return "motorOptimal(" + ArithmeticToString (OpenSmart_QuadMotorDriver::MotorCount) + ")";
+    }
+    void begin (ProgramInterfaceFanControllers &interface, OpenSmart_QuadMotorDriver &hardware) override {
+        _hardware = &hardware;
+        const float fractionMinimum = static_cast<float> (interface.getConfig ().MIN_SPEED) / ProgramInterfaceFanControllers::FanSpeedMax, fractionMaximum = static_cast<float> (interface.getConfig ().MAX_SPEED) / ProgramInterfaceFanControllers::FanSpeedMax;
+        for (size_t speed = 0; speed < ProgramInterfaceFanControllers::FanSpeedRange; speed++)
+            _allocations [speed] = allocate (fractionMaximum * OpenSmart_QuadMotorDriver::MotorCount * static_cast<float> (speed) / ProgramInterfaceFanControllers::FanSpeedMax, fractionMinimum, fractionMaximum);
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++)
+            _motorOrder [motorId] = interface.getConfig ().MOTOR_ORDER [motorId], _motorSpeeds [motorId] = static_cast<OpenSmart_QuadMotorDriver::MotorSpeed> (0);
+    }
+    bool setSpeed (const OpenSmart_QuadMotorDriver::MotorSpeed speed) override {
+        const Allocation &allocation = _allocations [speed];
+        for (int i = 0; i < OpenSmart_QuadMotorDriver::MotorCount; i++) {
+            const int motorId = _motorOrder [i];
+            const OpenSmart_QuadMotorDriver::MotorSpeed motorSpeed = (i < allocation.count) ? allocation.speed : 0;
+            if (motorSpeed != _motorSpeeds [motorId])
+                _hardware->setSpeed (motorSpeed, static_cast<OpenSmart_QuadMotorDriver::MotorID> (motorId)), _motorSpeeds [motorId] = motorSpeed;
+        }
+        return allocation.count > 0;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+template <size_t PROBE_COUNT>
+class ProgramInterfaceFanControllersStrategy_motorZonesTemplate : public ProgramInterfaceFanControllersStrategy {
+public:
+    using TemperatureArray = std::array<float, PROBE_COUNT>;
+    using TemperaturesSet = std::pair<float, TemperatureArray>;    // setpoint, per-probe temperatures
+    using TemperaturesSetFunc = std::function<TemperaturesSet ()>;
+    using ZoneWeights = std::array<std::array<float, PROBE_COUNT>, OpenSmart_QuadMotorDriver::MotorCount>;
+
+    typedef struct {
+        ZoneWeights WEIGHTS;    // [motor][probe], relative airflow of each fan across each probe, unless measured (see factory_fanZonesCalibration)
+        float SHARE_MINIMUM;    // fraction of the hottest zone's demand below which a fan is left off
+        float SHARE_CHANGE;     // movement in any share, while running, that reapplies the speeds
+    } Config;
+
+    static inline constexpr const char *PERSISTENT_SPACE = "fanzones";
+
+private:
+    const Config &config;
+    const TemperaturesSetFunc _temperatureValues;
+
+    ZoneWeights _weights;
+    bool _weightsMeasured = false;
+    OpenSmart_QuadMotorDriver *_hardware = nullptr;
+    OpenSmart_QuadMotorDriver::MotorSpeed _min_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0), _max_speed = OpenSmart_QuadMotorDriver::MotorSpeed (0);
+    OpenSmart_QuadMotorDriver::MotorSpeed _speed = 0;
+    std::array<OpenSmart_QuadMotorDriver::MotorSpeed, OpenSmart_QuadMotorDriver::MotorCount> _motorSpeeds;
+    std::array<float, OpenSmart_QuadMotorDriver::MotorCount> _motorShares;
+    ActivationTracker _reapplies;
+
+    static String persistentName (const int motorId) {
+        return "w" + ArithmeticToString (motorId);
+    }
+    bool weightsLoad () {    // as saved by weightsSave, one comma separated row per motor
+        PersistentData persistentData (PERSISTENT_SPACE);
+        ZoneWeights weights;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            String row;
+            if (! persistentData.get (persistentName (motorId).c_str (), &row))
+                return false;
+            for (size_t probe = 0, offset = 0; probe < PROBE_COUNT; probe++) {
+                const int comma = row.indexOf (',', offset);
+                if (comma < 0 && probe < PROBE_COUNT - 1)
+                    return false;
+                weights [motorId][probe] = row.substring (offset, comma < 0 ? row.length () : comma).toFloat ();
+                offset = comma + 1;
+            }
+        }
+        _weights = weights;
+        return true;
+    }
+
+    std::array<float, OpenSmart_QuadMotorDriver::MotorCount> calculateShares () const {
+        std::array<float, OpenSmart_QuadMotorDriver::MotorCount> shares;
+        const TemperaturesSet temperatures (_temperatureValues ());
+        const float &setpoint = temperatures.first;
+        float heatMaximum = 0.0f;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            float heat = 0.0f, weights = 0.0f;
+            for (size_t probe = 0; probe < PROBE_COUNT; probe++) {
+                heat += _weights [motorId][probe] * std::max (temperatures.second [probe] - setpoint, 0.0f);
+                weights += _weights [motorId][probe];
+            }
+            shares [motorId] = weights > 0.0f ? (heat / weights) : 0.0f;
+            heatMaximum = std::max (heatMaximum, shares [motorId]);
+        }
+        for (auto &share : shares)
+            share = heatMaximum > 0.0f ? (share / heatMaximum) : 1.0f;    // nothing above setpoint, but still demanded, so share evenly
+        return shares;
+    }
+    bool applyShares () {
+        int activated = 0;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            OpenSmart_QuadMotorDriver::MotorSpeed motorSpeed = 0;
+            if (_speed > ProgramInterfaceFanControllers::FanSpeedMin && _motorShares [motorId] >= config.SHARE_MINIMUM) {
+                const int motorDemand = std::max (static_cast<int> (std::round (_speed * _motorShares [motorId])), 1);
+                motorSpeed = map<int> (motorDemand, 1, ProgramInterfaceFanControllers::FanSpeedMax, _min_speed, _max_speed);
+            }
+            if (motorSpeed != _motorSpeeds [motorId])
+                _hardware->setSpeed (motorSpeed, static_cast<OpenSmart_QuadMotorDriver::MotorID> (motorId)), _motorSpeeds [motorId] = motorSpeed;
+            if (motorSpeed > 0)
+                activated++;
+        }
+        DEBUG_PRINTF ("FanInterfaceStrategy_motorZones:: speed=%d, shares=[%.2f,%.2f,%.2f,%.2f]\n", _speed, _motorShares [0], _motorShares [1], _motorShares [2], _motorShares [3]);
+        return activated > 0;
+    }
+
+public:
+    ProgramInterfaceFanControllersStrategy_motorZonesTemplate (const Config &cfg, const TemperaturesSetFunc temperatureValues) :
+        config (cfg),
+        _temperatureValues (temperatureValues),
+        _weights (config.WEIGHTS) { }
+    static bool weightsSave (const ZoneWeights &weights) {
+        PersistentData persistentData (PERSISTENT_SPACE);
+        bool saved = true;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+            String row;
+            for (size_t probe = 0; probe < PROBE_COUNT; probe++)
+                row += (probe > 0 ? "," : "") + ArithmeticToString (weights [motorId][probe], 3);
+            saved &= persistentData.set (persistentName (motorId).c_str (), row);
+        }
+        return saved;
+    }
+    String name () const override {
+        return "motorZones(" + ArithmeticToString (OpenSmart_QuadMotorDriver::MotorCount) + "x" + ArithmeticToString (PROBE_COUNT) + ")";
+    }
+    void begin (ProgramInterfaceFanControllers &interface, OpenSmart_QuadMotorDriver &hardware) override {
+        _hardware = &hardware;
+        _min_speed = interface.getConfig ().MIN_SPEED;
+        _max_speed = interface.getConfig ().MAX_SPEED;
+        _motorSpeeds.fill (static_cast<OpenSmart_QuadMotorDriver::MotorSpeed> (0));
+        _motorShares.fill (0.0f);
+        _weightsMeasured = weightsLoad ();
+        DEBUG_PRINTF ("FanInterfaceStrategy_motorZones:: weights=%s\n", _weightsMeasured ? "measured" : "configured");
+    }
+    bool setSpeed (const OpenSmart_QuadMotorDriver::MotorSpeed speed) override {
+        if ((_speed = speed) > ProgramInterfaceFanControllers::FanSpeedMin)
+            _motorShares = calculateShares ();
+        return applyShares ();
+    }
+    void process () override {    // the zones move under a constant overall speed, which the output stage would not pass on
+        if (_speed == ProgramInterfaceFanControllers::FanSpeedMin)
+            return;
+        const auto shares = calculateShares ();
+        bool moved = false;
+        for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++)
+            moved |= std::abs (shares [motorId] - _motorShares [motorId]) >= config.SHARE_CHANGE;
+        if (moved) {
+            _motorShares = shares;
+            applyShares ();
+            _reapplies++;
+        }
+    }
+    void collectDiagnostics (JsonVariant &obj) const override {
+        JsonObject zones = obj ["zones"].to<JsonObject> ();
+        zones ["weights"] = _weightsMeasured ? "measured" : "configured";
+        JsonArray shares = zones ["shares"].to<JsonArray> ();
+        for (const auto &share : _motorShares)
+            shares.add (ArithmeticToString (share, 2));
+        if (_reapplies)
+            zones ["reapplies"] = _reapplies;
+    }
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -0,0 +1,260 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include "DalyBMSInterface.hpp"
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// pipelined polling over the DalyBMSInterface library, which frames, checks and decodes: here each interface keeps one
+// request in flight, with the rest queued by phase (instant, status, diagnostics), and times it out so that a unit
+// which stops answering doesn't hold up the others; the unit's capabilities (config.daly) decide what it is asked.
+// the library owns the uart, so its receive is driven from a task of our own at RECEIVE_PERIOD rather than from the
+// main loop, which means responses complete, and the next request goes out, at the pace of the unit not the program
+
+class ProgramInterfaceSerialDalyBMS {
+public:
+    enum Category : uint8_t {
+        CategoryInstant = 1 << 0,
+        CategoryStatus = 1 << 1,
+        CategoryDiagnostics = 1 << 2,
+        CategoryAll = CategoryInstant | CategoryStatus | CategoryDiagnostics
+    };
+
+    typedef struct {
+        daly_bms::Interface::Config daly;
+        uint8_t categories;
+        interval_t TIMEOUT;
+    } Config;
+
+    static inline constexpr uint8_t COMMAND_SOC = 0x90, COMMAND_CELL_VOLTAGE_RANGE = 0x91, COMMAND_TEMPERATURE_RANGE = 0x92, COMMAND_MOSFET = 0x93, COMMAND_INFORMATION = 0x94,
+                                     COMMAND_CELL_VOLTAGES = 0x95, COMMAND_TEMPERATURES = 0x96, COMMAND_BALANCES = 0x97, COMMAND_FAILURES = 0x98;
+    static inline constexpr uint8_t COMMAND_FIRST = COMMAND_SOC, COMMAND_COUNT = COMMAND_FAILURES - COMMAND_FIRST + 1;
+    static inline constexpr size_t CELLS_MAXIMUM = 48, SENSORS_MAXIMUM = 16;
+    static inline constexpr interval_t AGE_NEVER = std::numeric_limits<interval_t>::max ();
+    static inline constexpr interval_t RECEIVE_PERIOD = 5;    // ms, well inside a response frame at 9600 baud
+
+    struct Status {
+        float voltage = 0.0f, current = 0.0f, charge = 0.0f;    // V, A (negative is discharge), %
+        uint16_t cellVoltageMaximum = 0, cellVoltageMinimum = 0;    // mV
+        uint8_t cellVoltageMaximumNumber = 0, cellVoltageMinimumNumber = 0;
+        int8_t temperatureMaximum = 0, temperatureMinimum = 0;    // C
+        uint8_t temperatureMaximumNumber = 0, temperatureMinimumNumber = 0;
+        uint8_t state = 0, lifeCycles = 0;    // state: 0 stationary, 1 charging, 2 discharging
+        bool mosfetCharge = false, mosfetDischarge = false;
+        uint32_t capacityResidual = 0;    // mAh
+        uint8_t cells = 0, sensors = 0, dio = 0;
+        bool charger = false, load = false;
+        uint16_t cycles = 0;
+        std::array<uint16_t, CELLS_MAXIMUM> cellVoltages {};    // mV
+        std::array<int8_t, SENSORS_MAXIMUM> temperatures {};    // C
+        std::array<uint8_t, 6> balances {};                      // bit per cell
+        std::array<uint8_t, 8> failures {};                      // bit per failure, last byte is failure code
+        std::array<interval_t, COMMAND_COUNT> updated {};    // per command, as fields arrive together
+
+        interval_t age (const uint8_t command) const {
+            const interval_t time = updated [command - COMMAND_FIRST];
+            return time > 0 ? millis () - time : AGE_NEVER;
+        }
+        bool valid (const uint8_t command, const interval_t ageMaximum) const {
+            return age (command) <= ageMaximum;
+        }
+    };
+
+private:
+    const Config &config;
+
+    daly_bms::Interface _interface;
+    Status _status;
+    SnapshotConcurrentSafe<Status> _snapshot;    // published on each completed response, for readers in any task
+
+    std::deque<daly_bms::RequestResponse *> _pending;
+    struct {
+        daly_bms::RequestResponse *request = nullptr;
+        interval_t sent = 0, previous = 0;    // previous: the request's last response, to tell when this one completes
+    } _inflight;
+
+    mutable std::mutex _mutex;    // the receive task against the main loop's request, balance and diagnostics
+    std::thread _receiver;
+    std::atomic<bool> _receiving { false };
+
+    counter_t _requests = 0, _responses = 0, _timeouts = 0, _unsupported = 0, _writes = 0;
+    Stats<interval_t> _latency;
+
+    void update (const daly_bms::RequestResponse &request) {
+        const uint8_t command = request.getCommand ();
+        switch (command) {
+        case COMMAND_SOC :
+            _status.voltage = _interface.instant.soc.voltage, _status.current = _interface.instant.soc.current, _status.charge = _interface.instant.soc.charge;
+            break;
+        case COMMAND_CELL_VOLTAGE_RANGE :
+            _status.cellVoltageMaximum = _interface.status.voltages.maximumVoltage, _status.cellVoltageMaximumNumber = _interface.status.voltages.maximumCell;
+            _status.cellVoltageMinimum = _interface.status.voltages.minimumVoltage, _status.cellVoltageMinimumNumber = _interface.status.voltages.minimumCell;
+            break;
+        case COMMAND_TEMPERATURE_RANGE :
+            _status.temperatureMaximum = _interface.status.temperatures.maximumTemperature, _status.temperatureMaximumNumber = _interface.status.temperatures.maximumSensor;
+            _status.temperatureMinimum = _interface.status.temperatures.minimumTemperature, _status.temperatureMinimumNumber = _interface.status.temperatures.minimumSensor;
+            break;
+        case COMMAND_MOSFET :
+            _status.state = _interface.status.mosfet.state, _status.mosfetCharge = _interface.status.mosfet.chargeMosfet, _status.mosfetDischarge = _interface.status.mosfet.dischargeMosfet;
+            _status.lifeCycles = _interface.status.mosfet.lifeCycles, _status.capacityResidual = _interface.status.mosfet.residualCapacity;
+            break;
+        case COMMAND_INFORMATION :
+            _status.cells = std::min<uint8_t> (_interface.status.status.cells, CELLS_MAXIMUM), _status.sensors = std::min<uint8_t> (_interface.status.status.sensors, SENSORS_MAXIMUM);
+            _status.charger = _interface.status.status.charger, _status.load = _interface.status.status.load, _status.dio = _interface.status.status.dio, _status.cycles = _interface.status.status.cycles;
+            break;
+        case COMMAND_CELL_VOLTAGES :
+            if (_status.updated [COMMAND_INFORMATION - COMMAND_FIRST] == 0)    // the library sized the response without the cell count
+                return;
+            std::copy_n (_interface.diagnostics.voltages.voltages.begin (), std::min (_interface.diagnostics.voltages.voltages.size (), CELLS_MAXIMUM), _status.cellVoltages.begin ());
+            break;
+        case COMMAND_TEMPERATURES :
+            if (_status.updated [COMMAND_INFORMATION - COMMAND_FIRST] == 0)
+                return;
+            std::copy_n (_interface.diagnostics.temperatures.temperatures.begin (), std::min (_interface.diagnostics.temperatures.temperatures.size (), SENSORS_MAXIMUM), _status.temperatures.begin ());
+            break;
+        case COMMAND_BALANCES :
+            std::copy_n (_interface.diagnostics.balances.balances.begin (), _status.balances.size (), _status.balances.begin ());
+            break;
+        case COMMAND_FAILURES :
+            std::copy_n (_interface.diagnostics.failures.failures.begin (), _status.failures.size (), _status.failures.begin ());
+            break;
+        default :    // commands are acknowledged, not polled
+            return;
+        }
+        _status.updated [command - COMMAND_FIRST] = request.time ();    // when the response completed, not when it was seen here
+        _snapshot.store (_status);    // only whole responses, so multi-frame cells / temperatures are never seen half updated
+    }
+
+    void transmit () {
+        while (_inflight.request == nullptr && ! _pending.empty ()) {
+            daly_bms::RequestResponse *request = _pending.front ();
+            _pending.pop_front ();
+            if (! _interface.issue (*request)) {    // outside the unit's capabilities
+                _unsupported++;
+                continue;
+            }
+            _inflight.request = request, _inflight.sent = millis (), _inflight.previous = request->time ();
+            _requests++;
+        }
+    }
+    void receive () {
+        _interface.process ();
+        if (_inflight.request != nullptr) {
+            if (_inflight.request->time () != _inflight.previous) {
+                update (*_inflight.request);
+                _latency += (millis () - _inflight.sent);
+                _responses++;
+                _inflight.request = nullptr;
+            } else if ((millis () - _inflight.sent) > config.TIMEOUT) {
+                DEBUG_PRINTF ("DalyBMSInterface[%s]::receive: timeout, command=0x%02x\n", config.daly.manager.id.c_str (), _inflight.request->getCommand ());
+                _timeouts++;
+                _inflight.request = nullptr;
+            }
+        }
+        transmit ();
+    }
+    void receiver () {
+        while (_receiving) {
+            {
+                std::lock_guard<std::mutex> guard (_mutex);
+                receive ();
+            }
+            delay (RECEIVE_PERIOD);
+        }
+    }
+    void enqueue (daly_bms::RequestResponse &request) {
+        if (&request != _inflight.request && std::find (_pending.begin (), _pending.end (), &request) == _pending.end ())    // don't pile up behind a slow interface
+            _pending.push_back (&request);
+    }
+
+public:
+    explicit ProgramInterfaceSerialDalyBMS (const Config &cfg) :
+        config (cfg),
+        _interface (config.daly) { }
+    ~ProgramInterfaceSerialDalyBMS () {
+        end ();
+    }
+    bool begin () {
+        if (! _interface.begin ()) {
+            DEBUG_PRINTF ("DalyBMSInterface[%s]::begin: daly begin failed\n", config.daly.manager.id.c_str ());
+            return false;
+        }
+        _receiving = true;
+        _receiver = std::thread (&ProgramInterfaceSerialDalyBMS::receiver, this);
+        DEBUG_PRINTF ("DalyBMSInterface[%s]::begin: serial=%d, rx=%d, tx=%d, en=%d, categories=0x%02x\n", config.daly.manager.id.c_str (), config.daly.serialId, config.daly.serialRxPin, config.daly.serialTxPin, config.daly.enPin, config.categories);
+        return true;
+    }
+    void end () {
+        if (_receiving.exchange (false) && _receiver.joinable ())
+            _receiver.join ();
+        _interface.end ();
+    }
+    void request (const Category category) {
+        if (! (config.categories & category))
+            return;
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (category == CategoryInstant)
+            enqueue (_interface.instant.soc);
+        else if (category == CategoryStatus)
+            enqueue (_interface.status.status), enqueue (_interface.status.voltages), enqueue (_interface.status.temperatures), enqueue (_interface.status.mosfet);
+        else if (category == CategoryDiagnostics)
+            enqueue (_interface.diagnostics.voltages), enqueue (_interface.diagnostics.temperatures), enqueue (_interface.diagnostics.balances), enqueue (_interface.diagnostics.failures);
+        transmit ();
+    }
+    // ahead of any polling; a newer setting replaces one not yet sent
+    void balance (const bool enabled) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _interface.commands.balancing.setEnabled (enabled);
+        if (std::find (_pending.begin (), _pending.end (), &_interface.commands.balancing) == _pending.end ())
+            _pending.push_front (&_interface.commands.balancing);
+        _writes++;
+        transmit ();
+    }
+    bool capable (const daly_bms::Capabilities capability) const {
+        return (static_cast<uint32_t> (config.daly.manager.capabilities) & static_cast<uint32_t> (capability)) != 0;
+    }
+    Status status () const {    // constant time and never waits on serial i/o
+        return _snapshot.load ();
+    }
+    inline const String &id () const {
+        return config.daly.manager.id;
+    }
+
+    void collectDiagnostics (JsonVariant &obj) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        JsonObject sub = obj [config.daly.manager.id].to<JsonObject> ();
+        sub ["req"] = _requests;
+        sub ["rsp"] = _responses;
+        if (_timeouts)
+            sub ["tmo"] = _timeouts;
+        if (_unsupported)
+            sub ["uns"] = _unsupported;
+        if (_writes)
+            sub ["wr"] = _writes;
+        sub ["lat"] = _latency;
+        if (_pending.size () > 0)
+            sub ["que"] = _pending.size ();
+        if (_status.updated [COMMAND_CELL_VOLTAGES - COMMAND_FIRST] > 0) {
+            JsonArray cells = sub ["cells"].to<JsonArray> ();
+            for (size_t cell = 0; cell < _status.cells; cell++)
+                cells.add (_status.cellVoltages [cell]);
+        }
+        if (_status.updated [COMMAND_TEMPERATURES - COMMAND_FIRST] > 0) {
+            JsonArray temps = sub ["temps"].to<JsonArray> ();
+            for (size_t sensor = 0; sensor < _status.sensors; sensor++)
+                temps.add (_status.temperatures [sensor]);
+        }
+        const interval_t updated = *std::max_element (_status.updated.begin (), _status.updated.end ());
+        if (updated > 0)
+            sub ["last"] = (millis () - updated) / 1000;
+        sub ["ver"] = _snapshot.version ();
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
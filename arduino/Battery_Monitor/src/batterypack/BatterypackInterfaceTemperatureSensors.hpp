@@ -27,8 +27,10 @@ private:
     const TemperatureCalculationFunc _calculator;
 
     std::array<StatsWithValue<float>, AdcHardware::CHANNELS> _stats;
+    std::array<interval_t, AdcHardware::CHANNELS> _measured {};
     inline void updateStats (const int channel, const float temperature) {
         _stats [channel] += temperature;
+        _measured [channel] = millis ();
     }
 
 public:
@@ -61,6 +63,9 @@ public:
         const_cast<ProgramInterfaceTemperatureSensors *> (this)->updateStats (channel, *temperature);
         return true;
     }
+    inline interval_t measured (const int channel) const {    // of the latest good read, 0 if none
+        return _measured [channel];
+    }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
@@ -0,0 +1,120 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class ProgramManageBalancing : public Component, public Diagnosticable {
+
+public:
+    typedef struct {
+        BalancingScheduler::Config scheduler;
+        interval_t intervalDecide, PERIOD;    // limited duty is applied as on-then-off within each period
+        float RESISTANCE;                     // ohms, pack, for its own heat until there is an online estimate
+        bool ACTUATE;                         // drive the balance unit, otherwise decisions are advisory only
+    } Config;
+
+    struct Thermal {
+        float temperature, cool, warning;
+        bool fans;
+    };
+    using ThermalFunc = std::function<Thermal ()>;
+
+private:
+    const Config &config;
+
+    ProgramManageSerialDalyBMS &_battery;
+    const ProgramManageInternalResistance &_resistance;
+    const ThermalFunc _thermal;
+    BalancingScheduler _scheduler;
+    Intervalable _intervalDecide;
+    interval_t _periodStart = 0, _switched = 0, _enabledTime = 0;
+    bool _enabled = false, _written = false;
+    counter_t _switches = 0;
+    float _temperature = NAN, _load = NAN;
+
+    // XXX the balancing command is only exercised against the workbench stand-in for the library, so leave ACTUATE off
+    // on a real pack until it has been seen to work there
+    inline bool actuating () const {
+        return config.ACTUATE && _battery.balanceCapable ();
+    }
+
+    BalancingScheduler::Inputs inputs () const {
+        const ProgramInterfaceSerialDalyBMS::Status status = _battery.status ();
+        const Thermal thermal = _thermal ();
+        BalancingScheduler::Inputs inputs = { .temperature = thermal.temperature, .cool = thermal.cool, .warning = thermal.warning, .fans = thermal.fans, .spread = 0, .bleeding = 0, .load = 0.0f };
+        const ProgramManageSerialDalyBMS::Instant instant = _battery.instant ();
+        if (instant.valid) {
+            const float resistance = _resistance.resistancePack () > 0.0f ? _resistance.resistancePack () : config.RESISTANCE;
+            inputs.load = instant.current * instant.current * resistance;
+        }
+        if (status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_TEMPERATURE_RANGE, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryStatus)))
+            inputs.temperature = std::max (inputs.temperature, static_cast<float> (status.temperatureMaximum));
+        if (status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_CELL_VOLTAGES, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryDiagnostics)) && status.cells > 0) {
+            const uint16_t minimum = *std::min_element (status.cellVoltages.begin (), status.cellVoltages.begin () + status.cells);
+            for (size_t cell = 0; cell < status.cells; cell++) {
+                inputs.spread = std::max<uint16_t> (inputs.spread, status.cellVoltages [cell] - minimum);
+                if (status.cellVoltages [cell] - minimum > config.scheduler.SPREAD_STOP)
+                    inputs.bleeding++;
+            }
+        } else if (status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_CELL_VOLTAGE_RANGE, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryStatus)))
+            inputs.spread = status.cellVoltageMaximum - status.cellVoltageMinimum, inputs.bleeding = 1;    // at least the highest
+        return inputs;
+    }
+    void apply (const bool enabled) {
+        if (enabled == _enabled && _written)
+            return;
+        if (_enabled)
+            _enabledTime += millis () - _switched;
+        if (actuating ())
+            _battery.balance (enabled);
+        DEBUG_PRINTF ("ProgramManageBalancing::apply: %s, decision=%s, duty=%.2f, rise=%.2f, headroom=%.2f\n", enabled ? "enable" : "disable", BalancingScheduler::toString (_scheduler.decision ()), _scheduler.duty (), _scheduler.rise (), _scheduler.headroom ());
+        _enabled = enabled, _written = true, _switched = millis ();
+        _switches++;
+    }
+
+public:
+    ProgramManageBalancing (const Config &conf, ProgramManageSerialDalyBMS &battery, const ProgramManageInternalResistance &resistance, const ThermalFunc thermal) :
+        config (conf),
+        _battery (battery),
+        _resistance (resistance),
+        _thermal (thermal),
+        _scheduler (config.scheduler),
+        _intervalDecide (config.intervalDecide) { }
+
+    void process () override {
+        if (_intervalDecide) {
+            const BalancingScheduler::Inputs in = inputs ();
+            _temperature = in.temperature, _load = in.load;
+            const BalancingScheduler::Decision previous = _scheduler.decision ();
+            if (_scheduler.decide (in) == BalancingScheduler::Decision::Limited && previous != BalancingScheduler::Decision::Limited)
+                _periodStart = millis ();
+        }
+        const BalancingScheduler::Decision decision = _scheduler.decision ();
+        apply (decision == BalancingScheduler::Decision::Enabled || (decision == BalancingScheduler::Decision::Limited && ((millis () - _periodStart) % config.PERIOD) < static_cast<interval_t> (_scheduler.duty () * static_cast<float> (config.PERIOD))));
+    }
+
+    inline bool enabled () const {
+        return _enabled;
+    }
+
+protected:
+    void collectDiagnostics (JsonVariant &obj) const override {
+        JsonObject sub = obj ["balancing"].to<JsonObject> ();
+        sub ["state"] = BalancingScheduler::toString (_scheduler.decision ());
+        sub ["on"] = _enabled;
+        if (_scheduler.decision () == BalancingScheduler::Decision::Limited)
+            sub ["duty"] = ArithmeticToString (_scheduler.duty (), 2);
+        if (! std::isnan (_temperature))
+            sub ["temp"] = ArithmeticToString (_temperature, 1);
+        sub ["rise"] = ArithmeticToString (_scheduler.rise (), 2);
+        sub ["head"] = ArithmeticToString (_scheduler.headroom (), 1);
+        sub ["time"] = (_enabledTime + (_enabled ? millis () - _switched : 0)) / 1000;
+        sub ["sw"] = _switches;
+        if (! std::isnan (_load))
+            sub ["load"] = ArithmeticToString (_load, 1);
+        if (! actuating ())
+            sub ["advisory"] = true;    // decisions only, not ACTUATE or the balance unit isn't configured with Capabilities::Balancing
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
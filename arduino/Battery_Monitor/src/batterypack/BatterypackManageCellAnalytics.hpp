@@ -0,0 +1,101 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class ProgramManageCellAnalytics : public Component, public Diagnosticable {
+
+public:
+    static inline constexpr size_t HISTORY_BLOCK_SIZE = 512, HISTORY_BLOCK_COUNT = 32;    // 16 KB, ~3 days of 16 cells at 5 minutes
+    static inline constexpr size_t DRIFT_REPORTED = 3;
+    using Analytics = CellAnalytics<ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM>;
+    using History = CellHistoryCompressed<ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM, HISTORY_BLOCK_SIZE, HISTORY_BLOCK_COUNT>;
+    using SpreadTrend = CellSpreadTrend<HISTORY_BLOCK_COUNT>;
+
+    typedef struct {
+        Analytics::Config analytics;
+    } Config;
+
+private:
+    const Config &config;
+
+    const ProgramManageSerialDalyBMS &_battery;
+    Analytics _analytics;
+    History _history;
+    SpreadTrend _spreadTrend;    // over the retained history
+    interval_t _updated = 0;
+
+public:
+    ProgramManageCellAnalytics (const Config &conf, const ProgramManageSerialDalyBMS &battery) :
+        config (conf),
+        _battery (battery),
+        _analytics (config.analytics) { }
+
+    void process () override {
+        const ProgramInterfaceSerialDalyBMS::Status status = _battery.status ();
+        const interval_t updated = status.updated [ProgramInterfaceSerialDalyBMS::COMMAND_CELL_VOLTAGES - ProgramInterfaceSerialDalyBMS::COMMAND_FIRST];
+        if (updated == 0 || updated == _updated || status.cells == 0)
+            return;
+        _updated = updated;
+        History::Voltages voltages;
+        History::Balances balances {};
+        std::copy (status.cellVoltages.begin (), status.cellVoltages.begin () + voltages.size (), voltages.begin ());
+        const ProgramInterfaceSerialDalyBMS::Status statusBalance = _battery.statusBalance ();    // the balance unit does the bleeding, so knows which cells
+        if (statusBalance.valid (ProgramInterfaceSerialDalyBMS::COMMAND_BALANCES, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryDiagnostics)))
+            std::copy (statusBalance.balances.begin (), statusBalance.balances.begin () + std::min (balances.size (), statusBalance.balances.size ()), balances.begin ());
+        _analytics.update (status.cells, voltages, balances);
+        _history.append (static_cast<uint32_t> (updated / 1000), status.cells, voltages, balances);
+        _spreadTrend.append (_history.block (), static_cast<uint32_t> (updated / 1000), static_cast<float> (_analytics.spread ()));
+    }
+
+    const Analytics &analytics () const {
+        return _analytics;
+    }
+    const History &history () const {
+        return _history;
+    }
+
+protected:
+    void collectDiagnostics (JsonVariant &obj) const override {
+        if (_analytics.samples () == 0)
+            return;
+        JsonObject sub = obj ["cells"].to<JsonObject> ();
+        sub ["n"] = _analytics.cells ();
+        sub ["avg"] = ArithmeticToString (_analytics.mean (), 1);
+        sub ["spr"] = _analytics.spread ();
+        sub ["low"] = String (_analytics.lowest ().cell + 1) + ":" + String (_analytics.lowest ().voltage);
+        sub ["high"] = String (_analytics.highest ().cell + 1) + ":" + String (_analytics.highest ().voltage);
+        sub ["weak"] = _analytics.weakest () + 1;
+        std::array<uint8_t, ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM> order;
+        for (uint8_t cell = 0; cell < _analytics.cells (); cell++)
+            order [cell] = cell;
+        const size_t reported = std::min<size_t> (DRIFT_REPORTED, _analytics.cells ());
+        std::partial_sort (order.begin (), order.begin () + reported, order.begin () + _analytics.cells (), [&] (const uint8_t a, const uint8_t b) {
+            return std::abs (_analytics.drift (a)) > std::abs (_analytics.drift (b));
+        });
+        JsonArray drift = sub ["drift"].to<JsonArray> ();
+        for (size_t i = 0; i < reported; i++)
+            drift.add (String (order [i] + 1) + ":" + ArithmeticToString (_analytics.drift (order [i]), 1));
+        float duty = 0.0f;
+        for (uint8_t cell = 0; cell < _analytics.cells (); cell++)
+            duty += _analytics.duty (cell);
+        JsonObject balance = sub ["bal"].to<JsonObject> ();
+        balance ["duty"] = ArithmeticToString (duty * 100.0f / _analytics.cells (), 1);
+        balance ["corr"] = ArithmeticToString (_analytics.correlation (), 2);
+        JsonObject history = sub ["hist"].to<JsonObject> ();
+        history ["rec"] = _history.records ();
+        history ["bytes"] = _history.bytes ();
+        if (_history.bytes () > 0)
+            history ["ratio"] = ArithmeticToString (static_cast<float> (_history.bytesUncompressed ()) / static_cast<float> (_history.bytes ()), 1);
+        // spread over the retained history: where it started, and its least squares trend
+        const SpreadTrend::Trend trend = _spreadTrend.trend ();
+        if (trend.count > 0) {
+            history ["span"] = (_updated / 1000 - trend.start) / 3600;
+            history ["spr0"] = trend.first;
+            if (trend.count > 2)
+                history ["trend"] = ArithmeticToString (trend.slope, 1);    // mV per day
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -2,9 +2,62 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+class ProgramManageFanControllersAlgorithm : public JsonSerializable {
+public:
+    virtual String name () const = 0;
+    virtual double apply (const double setpoint, const double current) = 0;    // -100 .. 100, see the output mapping in the manager
+    virtual bool smoothed () const { return true; }
+};
+
+class ProgramManageFanControllersAlgorithm_pid : public ProgramManageFanControllersAlgorithm {
+    PidController<double> &_controller;
+
+public:
+    explicit ProgramManageFanControllersAlgorithm_pid (PidController<double> &controller) :
+        _controller (controller) { }
+    String name () const override {
+        return "pid";
+    }
+    double apply (const double setpoint, const double current) override {
+        return _controller.apply (current, setpoint);    // reverse acting, as the fans cool: more output the further above setpoint
+    }
+    void serialize (JsonVariant &obj) const override {
+        obj.set (_controller);
+    }
+};
+
+class ProgramManageFanControllersAlgorithm_mpc : public ProgramManageFanControllersAlgorithm {
+public:
+    using AmbientFunc = std::function<double ()>;
+
+private:
+    MpcController<double> &_controller;
+    const AmbientFunc _ambient;
+
+public:
+    ProgramManageFanControllersAlgorithm_mpc (MpcController<double> &controller, const AmbientFunc ambient) :
+        _controller (controller),
+        _ambient (ambient) { }
+    String name () const override {
+        return "mpc";
+    }
+    double apply (const double setpoint, const double current) override {
+        return _controller.apply (setpoint, current, _ambient ()) * 200.0 - 100.0;
+    }
+    bool smoothed () const override {
+        return false;    // the model assumes the speed it chose is the speed applied
+    }
+    void serialize (JsonVariant &obj) const override {
+        obj.set (_controller);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
 class ProgramManageFanControllers : public Component, public Diagnosticable {
 public:
     typedef struct {
+        float HYSTERESIS;    // degrees below setpoint before turning off
     } Config;
 
     using TargetSet = std::pair<float, float>;
@@ -14,15 +67,16 @@ private:
     const Config &config;
 
     ProgramInterfaceFanControllers &_fan;
-    PidController<double>& _controllerAlgorithm;    // XXX should be an abstract interface
+    ProgramManageFanControllersAlgorithm &_controllerAlgorithm;
     AlphaSmoothing<double>& _smootherAlgorithm;     // XXX should be an abstract interface
 
     const TargetSetFunc _targetValues;
     float _value = 0.0f;
+    bool _running = false;
     Stats<float> _statsValue;
 
 public:
-    ProgramManageFanControllers (const Config &cfg, ProgramInterfaceFanControllers &fan, PidController<double> &controller, AlphaSmoothing<double> &smoother, const TargetSetFunc targetValues) :
+    ProgramManageFanControllers (const Config &cfg, ProgramInterfaceFanControllers &fan, ProgramManageFanControllersAlgorithm &controller, AlphaSmoothing<double> &smoother, const TargetSetFunc targetValues) :
         config (cfg),
         _fan (fan),
         _controllerAlgorithm (controller),
@@ -32,13 +86,14 @@ public:
     void process () override {
         const TargetSet targets (_targetValues ());
         const float &setpoint = targets.first, &current = targets.second;
-        if (current < setpoint) {
+        _running = (current >= setpoint) || (_running && current >= (setpoint - config.HYSTERESIS));
+        if (! _running) {
             DEBUG_PRINTF ("FanManager::process: setpoint=%.2f, current=%.2f\n", setpoint, current);
             _fan.setSpeed (0.0f);
         } else {
             const double speedCalculated = _controllerAlgorithm.apply (setpoint, current);
             const double speedConstrained = std::clamp (map<double> (speedCalculated, -100.0, 100.0, 0.0, 100.0), 0.0, 100.0);    // XXX is this correct?
-            const double speedSmoothed = _smootherAlgorithm.apply (speedConstrained);
+            const double speedSmoothed = _controllerAlgorithm.smoothed () ? _smootherAlgorithm.apply (speedConstrained) : speedConstrained;
             DEBUG_PRINTF ("FanManager::process: setpoint=%.2f, current=%.2f --> calculated=%.2e, constrained=%.2e, smoothed=%.2e\n", setpoint, current, speedCalculated, speedConstrained, speedSmoothed);
             _value = static_cast<float> (speedSmoothed);
             _fan.setSpeed (_value);    // percentage: 0% -> 100%
@@ -48,8 +103,8 @@ public:
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
-        JsonObject sub = obj ["fan"].to<JsonObject> ();
-        sub ["pid"] = _controllerAlgorithm;
+        JsonObject sub = obj ["fan"]["control"].to<JsonObject> ();    // alongside the interface's "fan" diagnostics
+        sub [_controllerAlgorithm.name ()] = _controllerAlgorithm;
         sub ["speed"] = _statsValue;
     }
 };
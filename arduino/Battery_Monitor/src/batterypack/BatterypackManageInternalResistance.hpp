@@ -0,0 +1,145 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+class ProgramManageInternalResistance : public Component, public Diagnosticable {
+
+public:
+    typedef struct {
+        ResistanceEstimatorRLS::Config pack, cell;
+        float CELL_CURRENT_DRIFT;    // A, the most the current may move between the instant polls either side of a cell poll for them to be paired
+    } Config;
+
+private:
+    const Config &config;
+
+    using Cells = std::array<ResistanceEstimatorRLS, ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM>;
+    template <size_t... I>
+    static Cells cellsCreate (const ResistanceEstimatorRLS::Config &config, std::index_sequence<I...>) {
+        return { { ((void) I, ResistanceEstimatorRLS (config))... } };
+    }
+
+    const ProgramManageSerialDalyBMS &_battery;
+    ResistanceEstimatorRLS _pack;
+    Cells _cells;
+    interval_t _updatedPack = 0, _updatedCells = 0;
+    float _currentPrevious = 0.0f;    // as of _updatedPack
+    struct {    // cell voltages waiting for the instant poll after them, so a current can be paired with them
+        bool waiting = false;
+        interval_t time = 0;
+        uint8_t cells = 0;
+        std::array<uint16_t, ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM> voltages {};
+    } _cellsPending;
+    float _temperature = NAN;
+    uint32_t _untempered = 0, _unpaired = 0;
+
+    // cells are polled on the slower diagnostics cadence, between instant polls: the current at the time of the cell
+    // voltages is interpolated from the polls either side, and only trusted if it barely moved across them. XXX over a
+    // step that long (STEP_SECONDS, minutes) polarisation and OCV drift add to the ohmic drop, so the per cell figures
+    // are biased upward: they are indicative, good for comparing cells, not as absolute resistances like the pack's
+    void cellsPair (const interval_t updatedPack, const float current) {
+        if (! _cellsPending.waiting || _updatedPack == 0)
+            return;
+        if ((_cellsPending.time - _updatedPack) > (updatedPack - _updatedPack)) {    // not between the two polls
+            if (static_cast<int32_t> (_cellsPending.time - updatedPack) > 0)
+                return;    // after both, so pair with the next
+            _unpaired++, _cellsPending.waiting = false;    // before both, the poll before it was missed
+            return;
+        }
+        if (std::abs (current - _currentPrevious) > config.CELL_CURRENT_DRIFT)
+            _unpaired++;
+        else {
+            const float fraction = static_cast<float> (_cellsPending.time - _updatedPack) / static_cast<float> (std::max<interval_t> (updatedPack - _updatedPack, 1));
+            const float currentAligned = _currentPrevious + (current - _currentPrevious) * fraction;
+            for (size_t cell = 0; cell < _cellsPending.cells; cell++)
+                _cells [cell].update (_cellsPending.time / 1000.0f, currentAligned, _cellsPending.voltages [cell] / 1000.0f, _temperature);
+        }
+        _cellsPending.waiting = false;
+    }
+
+    float temperature (const ProgramInterfaceSerialDalyBMS::Status &status) const {
+        if (status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_TEMPERATURES, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryDiagnostics)) && status.sensors > 0) {
+            float sum = 0.0f;
+            for (size_t sensor = 0; sensor < status.sensors; sensor++)
+                sum += status.temperatures [sensor];
+            return sum / static_cast<float> (status.sensors);
+        }
+        if (status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_TEMPERATURE_RANGE, _battery.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryStatus)))
+            return (static_cast<float> (status.temperatureMaximum) + static_cast<float> (status.temperatureMinimum)) / 2.0f;
+        return NAN;
+    }
+
+public:
+    ProgramManageInternalResistance (const Config &conf, const ProgramManageSerialDalyBMS &battery) :
+        config (conf),
+        _battery (battery),
+        _pack (config.pack),
+        _cells (cellsCreate (config.cell, std::make_index_sequence<ProgramInterfaceSerialDalyBMS::CELLS_MAXIMUM> ())) { }
+
+    void process () override {
+        const ProgramInterfaceSerialDalyBMS::Status status = _battery.status ();
+        const interval_t updatedPack = status.updated [ProgramInterfaceSerialDalyBMS::COMMAND_SOC - ProgramInterfaceSerialDalyBMS::COMMAND_FIRST],
+                         updatedCells = status.updated [ProgramInterfaceSerialDalyBMS::COMMAND_CELL_VOLTAGES - ProgramInterfaceSerialDalyBMS::COMMAND_FIRST];
+        if ((updatedPack == 0 || updatedPack == _updatedPack) && (updatedCells == 0 || updatedCells == _updatedCells))
+            return;
+        _temperature = temperature (status);
+        if (std::isnan (_temperature)) {
+            _updatedPack = updatedPack, _updatedCells = updatedCells, _untempered++;
+            return;
+        }
+        if (updatedCells != 0 && updatedCells != _updatedCells) {
+            if (_cellsPending.waiting)
+                _unpaired++;
+            _cellsPending.waiting = true, _cellsPending.time = updatedCells, _cellsPending.cells = status.cells, _cellsPending.voltages = status.cellVoltages;
+            _updatedCells = updatedCells;
+        }
+        if (updatedPack != 0 && updatedPack != _updatedPack) {
+            _pack.update (updatedPack / 1000.0f, status.current, status.voltage, _temperature);
+            cellsPair (updatedPack, status.current);
+            _updatedPack = updatedPack, _currentPrevious = status.current;
+        }
+    }
+
+    float resistancePack () const {    // ohms, at 25C
+        return _pack.resistance ();
+    }
+    float resistanceCell (const size_t cell) const {    // ohms, at 25C, indicative only (see cellsPair)
+        return _cells [cell].resistance ();
+    }
+
+protected:
+    void collectDiagnostics (JsonVariant &obj) const override {
+        JsonObject sub = obj ["resistance"].to<JsonObject> ();
+        if (! std::isnan (_temperature))
+            sub ["temp"] = ArithmeticToString (_temperature, 1);
+        if (_untempered > 0)
+            sub ["untemp"] = _untempered;
+        JsonObject pack = sub ["pack"].to<JsonObject> ();
+        if (_pack.accepted () > 0)
+            pack ["mohm"] = ArithmeticToString (_pack.resistance () * 1000.0f, 2);
+        pack ["steps"] = _pack.accepted ();
+        pack ["rej"] = _pack.rejected ();
+        const size_t cells = _battery.status ().cells;
+        size_t estimated = 0, worst = 0;
+        uint32_t steps = 0;
+        float sum = 0.0f;
+        for (size_t cell = 0; cell < cells; cell++)
+            if (_cells [cell].accepted () > 0) {
+                sum += _cells [cell].resistance (), estimated++, steps += _cells [cell].accepted ();
+                if (_cells [cell].resistance () > _cells [worst].resistance ())
+                    worst = cell;
+            }
+        if (estimated > 0) {
+            JsonObject cell = sub ["cell"].to<JsonObject> ();
+            cell ["avg"] = ArithmeticToString (sum * 1000.0f / static_cast<float> (estimated), 2);
+            cell ["worst"] = String (worst + 1) + ":" + ArithmeticToString (_cells [worst].resistance () * 1000.0f, 2);
+            cell ["steps"] = steps;    // over all cells
+            cell ["ind"] = true;      // indicative: biased upward by the slow cell polls, compare cells not absolutes
+        }
+        if (_unpaired > 0)
+            sub ["unpaired"] = _unpaired;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
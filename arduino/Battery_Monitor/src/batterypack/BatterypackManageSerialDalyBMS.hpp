@@ -2,71 +2,175 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-#include "DalyBMSInterface.hpp"
+using ProgramChargeEstimator = ChargeEstimatorKalman<11>;
 
-// -----------------------------------------------------------------------------------------------
-// -----------------------------------------------------------------------------------------------
-
-#include <tuple>
+// retained over soft resets / panics / watchdogs (but not power loss), so needs its own validation
+struct ProgramChargeEstimatorRetained {
+    static inline constexpr uint32_t MAGIC = 0x534f4331;
+    uint32_t magic;
+    ProgramChargeEstimator::State state;
+    uint32_t check;
+    uint32_t checksum () const {
+        uint32_t bits [2];
+        std::memcpy (&bits [0], &state.charge, sizeof (uint32_t)), std::memcpy (&bits [1], &state.variance, sizeof (uint32_t));
+        return (magic ^ bits [0] ^ (bits [1] << 7 | bits [1] >> 25)) * 2654435761u;
+    }
+};
+RTC_NOINIT_ATTR static ProgramChargeEstimatorRetained __chargeEstimatorRetained;
 
 class ProgramManageSerialDalyBMS : public Component, public Diagnosticable {
 
 public:
     struct Config {
-        daly_bms::Interface::Config manager, balance;
+        ProgramInterfaceSerialDalyBMS::Config manager, balance;
         interval_t intervalInstant, intervalStatus, intervalDiagnostics;
+        ProgramChargeEstimator::Config charge;
+        interval_t intervalChargePersist;
     };
 
 private:
     const Config &config;
 
-    daly_bms::Interfaces dalyInterfaces;
-    Intervalable intervalInstant, intervalStatus, intervalDiagnostics;
-    Enableable enabled;
+    struct Poller {
+        ProgramInterfaceSerialDalyBMS interface;
+        Intervalable intervalInstant, intervalStatus, intervalDiagnostics;
+        Poller (const ProgramInterfaceSerialDalyBMS::Config &conf, const Config &config) :
+            interface (conf),
+            intervalInstant (config.intervalInstant),
+            intervalStatus (config.intervalStatus),
+            intervalDiagnostics (config.intervalDiagnostics) { }
+        void begin (const Config &config) {
+            interface.begin ();
+            // randomise phases to prevent synchronicity, both between the categories and between the interfaces
+            intervalInstant.setat (RandomNumber::get<interval_t> (config.intervalInstant));
+            intervalStatus.setat (RandomNumber::get<interval_t> (config.intervalStatus));
+            intervalDiagnostics.setat (RandomNumber::get<interval_t> (config.intervalDiagnostics));
+            interface.request (ProgramInterfaceSerialDalyBMS::CategoryStatus);    // learn the cell and sensor counts early
+        }
+        void process () {
+            if (intervalInstant)
+                interface.request (ProgramInterfaceSerialDalyBMS::CategoryInstant);
+            if (intervalStatus)
+                interface.request (ProgramInterfaceSerialDalyBMS::CategoryStatus);
+            if (intervalDiagnostics)
+                interface.request (ProgramInterfaceSerialDalyBMS::CategoryDiagnostics);
+        }
+    };
+    Poller _pollerManager, _pollerBalance;
+
+    ProgramChargeEstimator _chargeEstimator;
+    PersistentData _chargePersist;
+    Intervalable _chargePersistInterval;
+    interval_t _chargeUpdated = 0;
+    const char *_chargeSource = "none";
+
+    void chargeRestore () {
+        uint32_t charge, variance;
+        if (__chargeEstimatorRetained.magic == ProgramChargeEstimatorRetained::MAGIC && __chargeEstimatorRetained.check == __chargeEstimatorRetained.checksum ()) {
+            _chargeEstimator.restore (__chargeEstimatorRetained.state);
+            _chargeSource = "rtc";
+        } else if (_chargePersist.get ("charge", &charge) && _chargePersist.get ("variance", &variance)) {
+            ProgramChargeEstimator::State state;
+            std::memcpy (&state.charge, &charge, sizeof (float)), std::memcpy (&state.variance, &variance, sizeof (float));
+            state.variance += config.charge.NOISE_PROCESS * (config.intervalChargePersist / 1000.0f);    // up to an interval of samples was lost
+            _chargeEstimator.restore (state);
+            _chargeSource = "nvs";
+        }
+    }
+    void chargeRetain () {
+        __chargeEstimatorRetained.magic = ProgramChargeEstimatorRetained::MAGIC;
+        __chargeEstimatorRetained.state = _chargeEstimator.state ();
+        __chargeEstimatorRetained.check = __chargeEstimatorRetained.checksum ();
+    }
+    void chargePersist () {    // batched, as flash wear rules out every sample
+        uint32_t charge, variance;
+        std::memcpy (&charge, &_chargeEstimator.state ().charge, sizeof (uint32_t)), std::memcpy (&variance, &_chargeEstimator.state ().variance, sizeof (uint32_t));
+        _chargePersist.set ("charge", charge), _chargePersist.set ("variance", variance);
+    }
+    void chargeProcess () {
+        const ProgramInterfaceSerialDalyBMS::Status status = _pollerManager.interface.status ();
+        const interval_t updated = status.updated [ProgramInterfaceSerialDalyBMS::COMMAND_SOC - ProgramInterfaceSerialDalyBMS::COMMAND_FIRST];
+        if (updated == 0 || updated == _chargeUpdated)
+            return;
+        if (_chargeUpdated == 0) {
+            if (! _chargeEstimator.initialised ()) {    // nothing retained: start from the bms's own counting, as the flat OCV curve under load is a worse guess
+                _chargeEstimator.restore ({ status.charge / 100.0f, config.charge.VARIANCE_INITIAL });
+                _chargeSource = "bms";
+            }
+        } else {
+            const interval_t elapsed = updated - _chargeUpdated;
+            if (elapsed > staleAfter (ProgramInterfaceSerialDalyBMS::CategoryInstant))
+                _chargeEstimator.skip (elapsed / 1000.0f);    // integrating a single current over the gap would be guesswork
+            else
+                _chargeEstimator.update (status.current, status.voltage, elapsed / 1000.0f);
+        }
+        _chargeUpdated = updated;
+        chargeRetain ();
+    }
 
 public:
     explicit ProgramManageSerialDalyBMS (const Config &conf) :
         config (conf),
-        dalyInterfaces ({
-            .interfaces = { config.manager, config.balance }
-    }),
-        intervalInstant (config.intervalInstant), intervalStatus (config.intervalStatus), intervalDiagnostics (config.intervalDiagnostics) { }    // XXX need to randomise to prevent synchronicity
+        _pollerManager (config.manager, config),
+        _pollerBalance (config.balance, config),
+        _chargeEstimator (config.charge),
+        _chargePersist ("charge"),
+        _chargePersistInterval (config.intervalChargePersist) { }
 
     void begin () override {
-        // if (dalyInterfaces.begin())
-        //     DEBUG_PRINTF("DalyBMSManager::begin: daly begin failed\n");
-        // else {
-        //     enabled ++;
-        //     intervalStatus.setat(RandomNumber::get<interval_t>(config.intervalStatus));
-        //     intervalDiagnostics.setat(RandomNumber::get<interval_t>(config.intervalDiagnostics));
-        // }
+        chargeRestore ();
+        _pollerManager.begin (config), _pollerBalance.begin (config);
     }
     void process () override {
-        // if (enabled) {
-        //     if (intervalInstant) dalyInterfaces.requestInstant();
-        //     if (intervalStatus) dalyInterfaces.requestStatus();
-        //     if (intervalDiagnostics) dalyInterfaces.requestDiagnostics(), dalyInterfaces.updateInitial();
-        //     dalyInterfaces.process();
-        // }
+        _pollerManager.process (), _pollerBalance.process ();    // neither blocks, so both interfaces are busy in parallel
+        chargeProcess ();
+        if (_chargePersistInterval && _chargeEstimator.initialised ())
+            chargePersist ();
     }
 
+    static inline constexpr interval_t STALE_INTERVALS = 3;    // missed polls before data is considered stale
+
     struct Instant {
-        float voltage, current, charge;
+        float voltage, current, charge, chargeReported;    // charge is estimated, chargeReported is as per the bms
+        interval_t age;    // ProgramInterfaceSerialDalyBMS::AGE_NEVER if never received
+        bool valid;
     };
     Instant instant () const {
-        // dalyInterfaces ["name"].status.status;
-        return { .voltage = 0.0f, .current = 0.0f, .charge = 0.0f };
+        const ProgramInterfaceSerialDalyBMS::Status status = _pollerManager.interface.status ();
+        return { .voltage = status.voltage, .current = status.current, .charge = _chargeEstimator.initialised () ? _chargeEstimator.charge () : status.charge, .chargeReported = status.charge, .age = status.age (ProgramInterfaceSerialDalyBMS::COMMAND_SOC), .valid = status.valid (ProgramInterfaceSerialDalyBMS::COMMAND_SOC, STALE_INTERVALS * config.intervalInstant + config.manager.TIMEOUT) };
+    }
+    interval_t staleAfter (const ProgramInterfaceSerialDalyBMS::Category category) const {
+        return STALE_INTERVALS * (category == ProgramInterfaceSerialDalyBMS::CategoryInstant ? config.intervalInstant : category == ProgramInterfaceSerialDalyBMS::CategoryStatus ? config.intervalStatus : config.intervalDiagnostics) + config.manager.TIMEOUT;
+    }
+    ProgramInterfaceSerialDalyBMS::Status status () const {
+        return _pollerManager.interface.status ();
+    }
+    ProgramInterfaceSerialDalyBMS::Status statusBalance () const {
+        return _pollerBalance.interface.status ();
+    }
+    void balance (const bool enabled) {
+        _pollerBalance.interface.balance (enabled);
+    }
+    bool balanceCapable () const {
+        return _pollerBalance.interface.capable (daly_bms::Capabilities::Balancing);
     }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
-        // last spoke
-        // total comms
-        // diags of each (but not deep diags!)
-        // alarms
-        // failure details
-        // soc empty, low, nearlycharged, charged
-        //
+        JsonVariant sub = obj ["bms"].to<JsonObject> ();
+        _pollerManager.interface.collectDiagnostics (sub);
+        _pollerBalance.interface.collectDiagnostics (sub);
+        if (_chargeEstimator.initialised ()) {
+            JsonObject charge = sub ["charge"].to<JsonObject> ();
+            charge ["est"] = ArithmeticToString (_chargeEstimator.charge (), 1);
+            charge ["dev"] = ArithmeticToString (_chargeEstimator.deviation (), 1);
+            charge ["bms"] = _pollerManager.interface.status ().charge;
+            charge ["inn"] = ArithmeticToString (_chargeEstimator.innovation (), 3);
+            charge ["upd"] = _chargeEstimator.predictions ();
+            charge ["cor"] = _chargeEstimator.corrections ();
+            charge ["src"] = _chargeSource;
+        }
+        // XXX alarms, failure details, soc empty/low/nearlycharged/charged
     }
 };
 
@@ -23,6 +23,7 @@ private:
     // std::array <Stats <float>, PROBE_COUNT> _statsValues;
     Stats<float> _statsValueAvg, _statsValueMin, _statsValueMax;
     ActivationTracker _valueBad;
+    interval_t _measured = 0;
 
 public:
     ProgramManageTemperatureBatterypackTemplate (const Config &cfg, ProgramInterfaceTemperatureSensors &interface) :
@@ -48,6 +49,8 @@ public:
                 float val = (_values [cnt] = tmp);
                 //_statsValues [cnt] += val;
                 _value += val;
+                if (_value.cnt () == 1 || static_cast<int32_t> (_interface.measured (channel) - _measured) > 0)
+                    _measured = _interface.measured (channel);
                 DEBUG_PRINTF ("%s%.2f<%.2f", (cnt > 0) ? ", " : "", val, tmp);
             } else {
                 DEBUG_PRINTF ("BAD<BAD", (cnt > 0) ? ", " : "");
@@ -73,6 +76,8 @@ public:
         return result;
     }
     inline float setpoint () const { return config.SETPOINT; }
+    inline float warning () const { return config.WARNING; }
+    inline interval_t measured () const { return _measured; }    // latest good probe read, unchanged by a sweep with none
     inline float current () const { return _value.max (); }    // XXX think about this ... max, average, etc
 
 protected:
@@ -109,6 +114,7 @@ private:
     MovingAverage<float, 16> _value;
     Stats<float> _statsValue;
     ActivationTracker _valueBad;
+    interval_t _measured = 0;
 
 public:
     ProgramManageTemperatureEnvironmentTemplate (const Config &cfg, ProgramInterfaceTemperatureSensors &interface) :
@@ -120,6 +126,7 @@ public:
         float tmp;
         if (_interface.getTemperature (config.channel, &tmp)) {
             _statsValue += (_value = tmp);
+            _measured = _interface.measured (config.channel);
             DEBUG_PRINTF ("TemperatureManagerEnvironment::process: temp=%.2f\n", static_cast<float> (_value));
         } else {
             DEBUG_PRINTF ("TemperatureManagerEnvironment::process: BAD READ\n");
@@ -127,6 +134,7 @@ public:
         }
     }
     inline float getTemperature () const { return _value; }
+    inline interval_t measured () const { return _measured; }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
@@ -0,0 +1,95 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+
+// when to let the balancer bleed: the heat it adds (power per bleeding cell), on top of the heat the pack already
+// makes under load (I^2 R, which the pack may not have risen to yet), raises the pack by roughly power / coupling at
+// steady state, with coupling much higher while the fans run; balancing runs fully when that rise fits under the
+// warning threshold (less a margin) and the pack is cool or the fans are running anyway, is duty limited when it only
+// partly fits or the pack is warm and still, and is deferred when there is no headroom at all
+
+class BalancingScheduler {
+public:
+    typedef struct {
+        float SPREAD_START, SPREAD_STOP;          // mV, hysteresis on the cell spread
+        float BLEED_POWER;                        // W per bleeding cell
+        float COUPLING_STILL, COUPLING_FAN;       // W/K, pack to ambient, fans off / running
+        float MARGIN;                             // K, below warning
+        float PREFERENCE;                         // duty cap when warm and still, to leave the work for better windows
+    } Config;
+
+    enum class Decision : uint8_t {
+        Idle,        // nothing to balance
+        Enabled,
+        Limited,     // duty cycled
+        Deferred     // no thermal headroom
+    };
+    static const char *toString (const Decision decision) {
+        switch (decision) {
+        case Decision::Enabled :
+            return "enabled";
+        case Decision::Limited :
+            return "limited";
+        case Decision::Deferred :
+            return "deferred";
+        case Decision::Idle :
+        default :
+            return "idle";
+        }
+    }
+
+    struct Inputs {
+        float temperature, cool, warning;    // C: pack maximum, below which is cool, warning threshold
+        bool fans;                           // running
+        uint16_t spread;                     // mV
+        uint8_t bleeding;                    // cells that would bleed
+        float load;                          // W, the pack's own heat
+    };
+
+private:
+    const Config &config;
+
+    Decision _decision = Decision::Idle;
+    float _duty = 0.0f, _rise = 0.0f, _headroom = 0.0f;
+
+public:
+    explicit BalancingScheduler (const Config &cfg) :
+        config (cfg) { }
+
+    Decision decide (const Inputs &inputs) {
+        const bool active = _decision == Decision::Enabled || _decision == Decision::Limited || _decision == Decision::Deferred;
+        const float coupling = inputs.fans ? config.COUPLING_FAN : config.COUPLING_STILL, bleed = static_cast<float> (inputs.bleeding) * config.BLEED_POWER, load = std::max (inputs.load, 0.0f);
+        _rise = (load + bleed) / coupling;
+        _headroom = inputs.warning - config.MARGIN - inputs.temperature;
+        if (static_cast<float> (inputs.spread) < (active ? config.SPREAD_STOP : config.SPREAD_START))
+            _decision = Decision::Idle, _duty = 0.0f;
+        else if (_headroom <= 0.0f || _headroom * coupling <= load)    // none left once the load's own heat is allowed for
+            _decision = Decision::Deferred, _duty = 0.0f;
+        else {
+            _duty = bleed > 0.0f ? std::min ((_headroom * coupling - load) / bleed, 1.0f) : 1.0f;
+            if (! inputs.fans && inputs.temperature > inputs.cool)
+                _duty = std::min (_duty, config.PREFERENCE);
+            _decision = _duty >= 1.0f ? Decision::Enabled : Decision::Limited;
+        }
+        return _decision;
+    }
+
+    inline Decision decision () const {
+        return _decision;
+    }
+    inline float duty () const {
+        return _duty;
+    }
+    inline float rise () const {    // K, predicted
+        return _rise;
+    }
+    inline float headroom () const {    // K
+        return _headroom;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,320 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+// cell voltage history in a fixed number of fixed size blocks, each starting with a keyframe of absolute values then
+// holding per-cell deltas as zigzag varints (cells mostly move by a few mV between samples, so a byte per cell); the
+// oldest block is dropped whole when a new one is needed, so every retained block is independently decodable
+
+template <size_t CELLS_MAXIMUM, size_t BLOCK_SIZE, size_t BLOCK_COUNT>
+class CellHistoryCompressed {
+public:
+    static inline constexpr size_t balancesSize (const size_t cells) {
+        return (cells + 7) / 8;
+    }
+    static inline constexpr size_t BALANCES_SIZE = balancesSize (CELLS_MAXIMUM);
+    using Voltages = std::array<uint16_t, CELLS_MAXIMUM>;
+    using Balances = std::array<uint8_t, BALANCES_SIZE>;
+
+private:
+    static inline constexpr size_t RECORD_MAXIMUM = 1 + 5 + CELLS_MAXIMUM * 3 + 1 + BALANCES_SIZE;
+    static_assert (BLOCK_SIZE >= RECORD_MAXIMUM, "CellHistoryCompressed BLOCK_SIZE too small for a keyframe");
+    static_assert (BLOCK_COUNT >= 2, "CellHistoryCompressed BLOCK_COUNT too small");
+
+    struct Block {
+        std::array<uint8_t, BLOCK_SIZE> data;
+        uint16_t size = 0, records = 0;
+    };
+    std::array<Block, BLOCK_COUNT> _blocks;
+    size_t _head = 0;
+    uint8_t _cells = 0;
+    uint32_t _time = 0;
+    Voltages _voltages {};
+    Balances _balances {};
+    uint32_t _records = 0, _dropped = 0;
+
+    static size_t putVarint (uint8_t *p, uint32_t v) {
+        size_t n = 0;
+        while (v >= 0x80)
+            p [n++] = static_cast<uint8_t> (v | 0x80), v >>= 7;
+        p [n++] = static_cast<uint8_t> (v);
+        return n;
+    }
+    static uint32_t getVarint (const uint8_t *&p) {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            const uint8_t b = *p++;
+            v |= static_cast<uint32_t> (b & 0x7F) << shift;
+            if (! (b & 0x80))
+                break;
+        }
+        return v;
+    }
+    static inline uint32_t zigzag (const int32_t v) {
+        return (static_cast<uint32_t> (v) << 1) ^ static_cast<uint32_t> (v >> 31);
+    }
+    static inline int32_t unzigzag (const uint32_t v) {
+        return static_cast<int32_t> (v >> 1) ^ -static_cast<int32_t> (v & 1);
+    }
+
+    size_t encode (uint8_t *p, const bool keyframe, const uint32_t time, const uint8_t cells, const Voltages &voltages, const Balances &balances) const {
+        size_t n = 0;
+        if (keyframe) {
+            p [n++] = cells;
+            n += putVarint (p + n, time);
+            for (size_t cell = 0; cell < cells; cell++)
+                n += putVarint (p + n, voltages [cell]);
+            for (size_t i = 0; i < balancesSize (cells); i++)
+                p [n++] = balances [i];
+        } else {
+            n += putVarint (p + n, time - _time);
+            for (size_t cell = 0; cell < cells; cell++)
+                n += putVarint (p + n, zigzag (static_cast<int32_t> (voltages [cell]) - static_cast<int32_t> (_voltages [cell])));
+            const bool changed = ! std::equal (balances.begin (), balances.begin () + balancesSize (cells), _balances.begin ());
+            p [n++] = changed ? 1 : 0;
+            if (changed)
+                for (size_t i = 0; i < balancesSize (cells); i++)
+                    p [n++] = balances [i];
+        }
+        return n;
+    }
+
+public:
+    void append (const uint32_t time, const uint8_t cells, const Voltages &voltages, const Balances &balances) {
+        std::array<uint8_t, RECORD_MAXIMUM> record;
+        Block *block = &_blocks [_head];
+        const bool continuing = block->records > 0 && cells == _cells && time >= _time;
+        size_t size = encode (record.data (), ! continuing, time, cells, voltages, balances);
+        if (! continuing || block->size + size > BLOCK_SIZE) {
+            if (block->records > 0) {
+                _head = (_head + 1) % BLOCK_COUNT, block = &_blocks [_head];
+                if (block->records > 0)
+                    _dropped += block->records;
+            }
+            block->size = 0, block->records = 0;
+            if (continuing)
+                size = encode (record.data (), true, time, cells, voltages, balances);
+        }
+        std::copy (record.begin (), record.begin () + size, block->data.begin () + block->size);
+        block->size += size, block->records++;
+        _cells = cells, _time = time, _voltages = voltages, _balances = balances;
+        _records++;
+    }
+
+    // oldest first: function (time, cells, voltages, balances)
+    template <typename F>
+    void forEach (F function) const {
+        for (size_t i = 1; i <= BLOCK_COUNT; i++) {
+            const Block &block = _blocks [(_head + i) % BLOCK_COUNT];
+            if (block.records == 0)
+                continue;
+            const uint8_t *p = block.data.data ();
+            const uint8_t cells = *p++;
+            uint32_t time = getVarint (p);
+            Voltages voltages {};
+            Balances balances {};
+            for (size_t cell = 0; cell < cells; cell++)
+                voltages [cell] = static_cast<uint16_t> (getVarint (p));
+            for (size_t b = 0; b < balancesSize (cells); b++)
+                balances [b] = *p++;
+            function (time, cells, voltages, balances);
+            for (size_t record = 1; record < block.records; record++) {
+                time += getVarint (p);
+                for (size_t cell = 0; cell < cells; cell++)
+                    voltages [cell] = static_cast<uint16_t> (static_cast<int32_t> (voltages [cell]) + unzigzag (getVarint (p)));
+                if (*p++)
+                    for (size_t b = 0; b < balancesSize (cells); b++)
+                        balances [b] = *p++;
+                function (time, cells, voltages, balances);
+            }
+        }
+    }
+    size_t records () const {    // retained
+        size_t count = 0;
+        for (const auto &block : _blocks)
+            count += block.records;
+        return count;
+    }
+    size_t bytes () const {
+        size_t count = 0;
+        for (const auto &block : _blocks)
+            count += block.size;
+        return count;
+    }
+    size_t bytesUncompressed () const {    // as if time, voltages and balances were stored flat
+        return records () * (sizeof (uint32_t) + _cells * sizeof (uint16_t) + balancesSize (_cells));
+    }
+    inline size_t block () const {    // where the latest record went: blocks are reused in turn, so a change means the one now here was dropped
+        return _head;
+    }
+    inline uint32_t appended () const {
+        return _records;
+    }
+    inline uint32_t dropped () const {
+        return _dropped;
+    }
+    static inline constexpr size_t capacity () {
+        return BLOCK_SIZE * BLOCK_COUNT;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+// least squares trend of the cell spread over a CellHistoryCompressed, kept as it is appended rather than decoded: sums
+// are per history block, relative to the block's first record, so a dropped block is simply reset and the retained ones
+// are combined (shifted to the oldest) only when asked
+
+template <size_t BLOCK_COUNT>
+class CellSpreadTrend {
+    struct Sums {
+        uint32_t start = 0, count = 0;
+        float first = 0.0f, su = 0.0f, ss = 0.0f, suu = 0.0f, sus = 0.0f;    // u: days since start
+    };
+    std::array<Sums, BLOCK_COUNT> _blocks;
+    size_t _block = BLOCK_COUNT;
+
+public:
+    static inline constexpr float SECONDS_PER_DAY = 24.0f * 3600.0f;
+
+    struct Trend {
+        uint32_t start, count;
+        float first, slope;    // slope: per day, only when count > 2
+    };
+
+    void append (const size_t block, const uint32_t time, const float spread) {
+        Sums &sums = _blocks [block];
+        if (block != _block)
+            sums = Sums { .start = time, .first = spread }, _block = block;
+        const float u = static_cast<float> (time - sums.start) / SECONDS_PER_DAY;
+        sums.count++, sums.su += u, sums.ss += spread, sums.suu += u * u, sums.sus += u * spread;
+    }
+    Trend trend () const {
+        Trend trend { 0, 0, 0.0f, 0.0f };
+        if (_block == BLOCK_COUNT)
+            return trend;
+        float st = 0.0f, ss = 0.0f, stt = 0.0f, sts = 0.0f;
+        for (size_t i = 1; i <= BLOCK_COUNT; i++) {    // oldest first
+            const Sums &sums = _blocks [(_block + i) % BLOCK_COUNT];
+            if (sums.count == 0)
+                continue;
+            if (trend.count == 0)
+                trend.start = sums.start, trend.first = sums.first;
+            const float d = static_cast<float> (sums.start - trend.start) / SECONDS_PER_DAY, n = static_cast<float> (sums.count);
+            st += n * d + sums.su, ss += sums.ss, stt += n * d * d + 2.0f * d * sums.su + sums.suu, sts += d * sums.ss + sums.sus;
+            trend.count += sums.count;
+        }
+        const float n = static_cast<float> (trend.count), denominator = n * stt - st * st;
+        if (trend.count > 2 && denominator > 0.0f)
+            trend.slope = (n * sts - st * ss) / denominator;
+        return trend;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+// per sample: spread and extremes; over time: per cell drift from the pack mean (ewma), which cell is most often
+// the lowest, how often each cell is being balanced, and whether balancing tracks drift (correlation across cells
+// of drift and balancing duty, which should be positive; a cell drifting low that is never balanced is suspect)
+
+template <size_t CELLS_MAXIMUM>
+class CellAnalytics {
+public:
+    typedef struct {
+        float DRIFT_ALPHA;
+    } Config;
+
+    struct Extreme {
+        uint8_t cell;    // 0 based
+        uint16_t voltage;
+    };
+
+private:
+    const Config &config;
+
+    uint8_t _cells = 0;
+    uint32_t _samples = 0;
+    float _mean = 0.0f;
+    Extreme _lowest { 0, 0 }, _highest { 0, 0 };
+    std::array<float, CELLS_MAXIMUM> _drift {};    // mV, ewma of (cell - mean)
+    std::array<uint32_t, CELLS_MAXIMUM> _balancing {}, _lowestCount {};
+
+public:
+    explicit CellAnalytics (const Config &cfg) :
+        config (cfg) { }
+
+    template <typename Voltages, typename Balances>
+    void update (const uint8_t cells, const Voltages &voltages, const Balances &balances) {
+        if (cells == 0 || cells > CELLS_MAXIMUM)
+            return;
+        if (cells != _cells)
+            _cells = cells, _samples = 0, _drift.fill (0.0f), _balancing.fill (0), _lowestCount.fill (0);
+        uint32_t sum = 0;
+        _lowest = { 0, voltages [0] }, _highest = { 0, voltages [0] };
+        for (uint8_t cell = 0; cell < cells; cell++) {
+            sum += voltages [cell];
+            if (voltages [cell] < _lowest.voltage)
+                _lowest = { cell, voltages [cell] };
+            if (voltages [cell] > _highest.voltage)
+                _highest = { cell, voltages [cell] };
+        }
+        _mean = static_cast<float> (sum) / static_cast<float> (cells);
+        const float alpha = _samples == 0 ? 1.0f : config.DRIFT_ALPHA;
+        for (uint8_t cell = 0; cell < cells; cell++) {
+            _drift [cell] += alpha * ((static_cast<float> (voltages [cell]) - _mean) - _drift [cell]);
+            if (balances [cell / 8] & (1 << (cell % 8)))
+                _balancing [cell]++;
+        }
+        _lowestCount [_lowest.cell]++;
+        _samples++;
+    }
+
+    inline uint8_t cells () const {
+        return _cells;
+    }
+    inline uint32_t samples () const {
+        return _samples;
+    }
+    inline float mean () const {
+        return _mean;
+    }
+    inline uint16_t spread () const {
+        return _highest.voltage - _lowest.voltage;
+    }
+    inline Extreme lowest () const {
+        return _lowest;
+    }
+    inline Extreme highest () const {
+        return _highest;
+    }
+    inline float drift (const uint8_t cell) const {
+        return _drift [cell];
+    }
+    uint8_t weakest () const {    // most often the lowest
+        return static_cast<uint8_t> (std::max_element (_lowestCount.begin (), _lowestCount.begin () + std::max<uint8_t> (_cells, 1)) - _lowestCount.begin ());
+    }
+    float duty (const uint8_t cell) const {    // fraction of samples being balanced
+        return _samples > 0 ? static_cast<float> (_balancing [cell]) / static_cast<float> (_samples) : 0.0f;
+    }
+    float correlation () const {    // pearson, across cells, of drift against balancing duty
+        if (_cells < 2 || _samples == 0)
+            return 0.0f;
+        float mx = 0.0f, my = 0.0f;
+        for (uint8_t cell = 0; cell < _cells; cell++)
+            mx += _drift [cell], my += duty (cell);
+        mx /= _cells, my /= _cells;
+        float sxy = 0.0f, sxx = 0.0f, syy = 0.0f;
+        for (uint8_t cell = 0; cell < _cells; cell++) {
+            const float dx = _drift [cell] - mx, dy = duty (cell) - my;
+            sxy += dx * dy, sxx += dx * dx, syy += dy * dy;
+        }
+        return (sxx > 0.0f && syy > 0.0f) ? sxy / std::sqrt (sxx * syy) : 0.0f;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+// single state extended kalman filter: coulomb counting as the process, pack open circuit voltage as the
+// measurement but only once the pack has rested, as under load the voltage mostly reflects the current;
+// the OCV curve is a piecewise linear table, so everything per sample is constant time
+
+template <size_t OCV_SIZE>
+class ChargeEstimatorKalman {
+public:
+    using OcvTable = std::array<std::pair<float, float>, OCV_SIZE>;    // (state of charge 0..1, cell volts), ascending
+
+    typedef struct {
+        float CAPACITY;                                        // Ah
+        float EFFICIENCY;                                      // coulombic, applied when charging
+        int CELLS;                                             // in series
+        float RESISTANCE;                                      // ohms, pack
+        OcvTable OCV;
+        float NOISE_PROCESS, NOISE_MEASUREMENT;                // variance per second (of charge 0..1), variance (volts^2)
+        float REST_CURRENT, REST_SECONDS;                      // below which, for at least which, the voltage is trusted
+        float VARIANCE_INITIAL;
+    } Config;
+
+    struct State {    // kept small and flat, for persistence
+        float charge, variance;
+    };
+
+private:
+    const Config &config;
+
+    State _state = { 0.5f, 1.0f };
+    bool _initialised = false;
+    float _rested = 0.0f, _innovation = 0.0f;
+    uint32_t _predictions = 0, _corrections = 0;
+
+    float ocvAt (const float charge, float *slope) const {
+        const auto &table = config.OCV;
+        size_t i = 1;
+        while (i < OCV_SIZE - 1 && charge > table [i].first)
+            i++;
+        const float s = (table [i].second - table [i - 1].second) / std::max (table [i].first - table [i - 1].first, 1e-6f);
+        if (slope != nullptr)
+            *slope = s * static_cast<float> (config.CELLS);
+        return (table [i - 1].second + s * (std::clamp (charge, 0.0f, 1.0f) - table [i - 1].first)) * static_cast<float> (config.CELLS);
+    }
+    float chargeAt (const float voltage) const {    // inverse, for initialisation
+        const auto &table = config.OCV;
+        const float cell = voltage / static_cast<float> (config.CELLS);
+        if (cell <= table [0].second)
+            return table [0].first;
+        for (size_t i = 1; i < OCV_SIZE; i++)
+            if (cell <= table [i].second)
+                return table [i - 1].first + (cell - table [i - 1].second) * (table [i].first - table [i - 1].first) / std::max (table [i].second - table [i - 1].second, 1e-6f);
+        return table [OCV_SIZE - 1].first;
+    }
+
+public:
+    explicit ChargeEstimatorKalman (const Config &cfg) :
+        config (cfg) { }
+
+    void restore (const State &state) {
+        _state = { std::clamp (state.charge, 0.0f, 1.0f), std::clamp (state.variance, 0.0f, 1.0f) }, _initialised = true;
+    }
+    void initialise (const float voltage) {
+        _state = { chargeAt (voltage), config.VARIANCE_INITIAL }, _initialised = true;
+    }
+    // current positive is charging
+    void update (const float current, const float voltage, const float seconds) {
+        if (! _initialised)
+            initialise (voltage - current * config.RESISTANCE);
+        if (seconds <= 0.0f)
+            return;
+        // predict
+        const float efficiency = current > 0.0f ? config.EFFICIENCY : 1.0f;
+        _state.charge = std::clamp (_state.charge + efficiency * current * seconds / (3600.0f * config.CAPACITY), 0.0f, 1.0f);
+        _state.variance += config.NOISE_PROCESS * seconds;
+        _predictions++;
+        // correct, at rest
+        _rested = (std::abs (current) < config.REST_CURRENT) ? _rested + seconds : 0.0f;
+        if (_rested >= config.REST_SECONDS) {
+            float slope;
+            const float expected = ocvAt (_state.charge, &slope) + current * config.RESISTANCE;
+            const float innovationVariance = slope * _state.variance * slope + config.NOISE_MEASUREMENT;
+            const float gain = _state.variance * slope / innovationVariance;
+            _innovation = voltage - expected;
+            _state.charge = std::clamp (_state.charge + gain * _innovation, 0.0f, 1.0f);
+            _state.variance = std::max ((1.0f - gain * slope) * _state.variance, 0.0f);
+            _corrections++;
+        }
+    }
+
+    // no usable samples for a while (e.g. bms unreachable), so only the uncertainty grows
+    void skip (const float seconds) {
+        _state.variance = std::min (_state.variance + config.NOISE_PROCESS * seconds, 1.0f), _rested = 0.0f;
+    }
+
+    inline bool initialised () const {
+        return _initialised;
+    }
+    inline const State &state () const {
+        return _state;
+    }
+    inline float charge () const {    // percent
+        return _state.charge * 100.0f;
+    }
+    inline float deviation () const {    // percent
+        return std::sqrt (_state.variance) * 100.0f;
+    }
+    inline float innovation () const {
+        return _innovation;
+    }
+    inline uint32_t predictions () const {
+        return _predictions;
+    }
+    inline uint32_t corrections () const {
+        return _corrections;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,75 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// internal resistance from steps: across a quick enough change in current, the open circuit voltage barely
+// moves, so dV = R dI; scalar recursive least squares with forgetting over qualifying steps, each normalised to
+// 25C first (arrhenius, R(T) = R25 exp (B (1/T - 1/T25))), so the estimate tracks ageing rather than weather
+
+class ResistanceEstimatorRLS {
+public:
+    typedef struct {
+        float STEP_CURRENT;                               // A, minimum |dI| to qualify
+        float STEP_SECONDS;                               // maximum time between the two sides of the step
+        float RESISTANCE_MAXIMUM;                         // ohms, beyond which a step is an outlier (e.g. not a step at all)
+        float FORGETTING;                                 // lambda, 0..1
+        float ACTIVATION;                                 // B, kelvin
+        float VARIANCE_INITIAL;                           // of the estimate, before any steps
+    } Config;
+
+    static inline constexpr float KELVIN = 273.15f, REFERENCE = 25.0f;
+
+private:
+    const Config &config;
+
+    float _resistance = 0.0f, _variance;
+    float _current = 0.0f, _voltage = 0.0f, _seconds = 0.0f;
+    bool _primed = false;
+    uint32_t _accepted = 0, _rejected = 0;
+
+public:
+    explicit ResistanceEstimatorRLS (const Config &cfg) :
+        config (cfg),
+        _variance (cfg.VARIANCE_INITIAL) { }
+
+    inline float compensation (const float temperature) const {    // multiplier from R(T) to R(25)
+        return std::exp (-config.ACTIVATION * (1.0f / (temperature + KELVIN) - 1.0f / (REFERENCE + KELVIN)));
+    }
+    // seconds is a monotonic time of the sample; returns true if the sample completed a qualifying step
+    bool update (const float seconds, const float current, const float voltage, const float temperature) {
+        const bool step = _primed && (seconds - _seconds) <= config.STEP_SECONDS && std::abs (current - _current) >= config.STEP_CURRENT;
+        const float dI = current - _current, dV = voltage - _voltage;
+        _current = current, _voltage = voltage, _seconds = seconds, _primed = true;
+        if (! step)
+            return false;
+        const float measured = dV / dI;
+        if (measured <= 0.0f || measured > config.RESISTANCE_MAXIMUM) {
+            _rejected++;
+            return false;
+        }
+        // regress the compensated dV on dI, so larger steps (better signal to noise) weigh more
+        const float x = dI, y = dV * compensation (temperature);
+        const float gain = _variance * x / (config.FORGETTING + x * _variance * x);
+        _resistance += gain * (y - x * _resistance);
+        _variance = (_variance - gain * x * _variance) / config.FORGETTING;
+        _accepted++;
+        return true;
+    }
+
+    inline float resistance () const {    // ohms, at 25C
+        return _resistance;
+    }
+    inline uint32_t accepted () const {
+        return _accepted;
+    }
+    inline uint32_t rejected () const {
+        return _rejected;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// tyre pressure moves with temperature as well as with air lost, so readings are first normalised to a reference
+// temperature (ideal gas, on absolute pressure: p_ref = p (T_ref / T)); a slow leak is then the slope of the
+// normalised pressure over time, from a least squares line with exponential forgetting, kept as running sums that
+// are re-centred on the latest sample so they stay well conditioned over days; a step up (inflation) restarts it;
+// the sums are the whole of the state, so they can be saved and restored across a restart, aged for the time away
+
+class TyrePressureTrend {
+public:
+    typedef struct {
+        float ATMOSPHERIC;                  // kPa, added to readings to make them absolute (0 if the sensor is absolute)
+        float REFERENCE;                    // C, temperature the pressure is normalised to
+        uint32_t INTERVAL_RECORD;           // msec, minimum between recorded samples
+        float WINDOW;                       // seconds, time constant of the forgetting
+        float SPAN_MINIMUM;                 // seconds, of data before the rate is reported
+        float INFLATION;                    // kPa, step up that restarts the trend
+        float LEAK_RATE;                    // kPa/day, loss beyond which there is a leak
+    } Config;
+
+    static inline constexpr float KELVIN = 273.15f, SECONDS_PER_DAY = 24.0f * 60.0f * 60.0f;
+    static inline constexpr float AWAY_WINDOWS = 4.0f;                                     // beyond which the sums are all but forgotten (2%)
+    static inline constexpr float SPAN_MAXIMUM = static_cast<float> (INT32_MAX / 1000);    // seconds, that the msec times can hold
+
+    struct State {
+        double s0, st, stt, sp, stp;
+        float span, pressure;    // seconds, kPa
+        uint32_t restarts, records;
+    };
+
+private:
+    const Config &config;
+
+    double _s0 = 0.0, _st = 0.0, _stt = 0.0, _sp = 0.0, _stp = 0.0;    // weighted sums, t in days relative to the latest sample
+    uint32_t _latest = 0, _start = 0;
+    float _pressure = NAN;
+    bool _primed = false;
+    uint32_t _restarts = 0, _records = 0;
+
+    void restart (const uint32_t time) {
+        _s0 = _st = _stt = _sp = _stp = 0.0;
+        _start = time;
+    }
+    void advance (const double seconds) {    // shift the origin forward, then forget
+        const double dt = seconds / SECONDS_PER_DAY, decay = std::exp (-seconds / config.WINDOW);
+        _stp = (_stp - dt * _sp) * decay;
+        _stt = (_stt - 2.0 * dt * _st + dt * dt * _s0) * decay;
+        _st = (_st - dt * _s0) * decay;
+        _sp *= decay;
+        _s0 *= decay;
+    }
+
+public:
+    explicit TyrePressureTrend (const Config &cfg) :
+        config (cfg) { }
+
+    inline float normalise (const float pressure, const float temperature) const {    // kPa, gauge if the input is
+        return (pressure + config.ATMOSPHERIC) * (config.REFERENCE + KELVIN) / (temperature + KELVIN) - config.ATMOSPHERIC;
+    }
+
+    // time in msec (wrapping); returns true if the sample was recorded
+    bool update (const uint32_t time, const float pressure, const float temperature) {
+        if (_primed && (time - _latest) < config.INTERVAL_RECORD)
+            return false;
+        const float normalised = normalise (pressure, temperature);
+        if (! _primed || normalised - _pressure > config.INFLATION) {
+            if (_primed)
+                _restarts++;
+            restart (time);
+        } else
+            advance (static_cast<double> (time - _latest) / 1000.0);
+        _s0 += 1.0, _sp += normalised;    // at t = 0, so no contribution to st, stt or stp
+        _latest = time, _pressure = normalised, _primed = true;
+        _records++;
+        return true;
+    }
+
+    State state () const {
+        return { .s0 = _s0, .st = _st, .stt = _stt, .sp = _sp, .stp = _stp, .span = span (), .pressure = _pressure, .restarts = _restarts, .records = _records };
+    }
+    // as at time (msec, now), with the state saved seconds ago; a sample already taken is not replaced, and after
+    // a long time away (storage) there is nothing worth keeping, so it starts afresh; returns true if restored
+    bool restore (const State &state, const uint32_t time, const float away) {
+        if (_primed || state.s0 <= 0.0 || away < 0.0f || away > AWAY_WINDOWS * config.WINDOW)
+            return false;
+        _s0 = state.s0, _st = state.st, _stt = state.stt, _sp = state.sp, _stp = state.stp;
+        advance (away);
+        _latest = time, _start = time - static_cast<uint32_t> (std::min (state.span + away, SPAN_MAXIMUM) * 1000.0f);
+        _pressure = state.pressure, _restarts = state.restarts, _records = state.records, _primed = true;
+        return true;
+    }
+
+    inline float span () const {    // seconds, since the trend (re)started
+        return _primed ? static_cast<float> (_latest - _start) / 1000.0f : 0.0f;
+    }
+    inline bool available () const {
+        return _primed && span () >= config.SPAN_MINIMUM;
+    }
+    float rate () const {    // kPa/day, negative for loss
+        const double denominator = _s0 * _stt - _st * _st;
+        return (available () && denominator > 0.0) ? static_cast<float> ((_s0 * _stp - _st * _sp) / denominator) : 0.0f;
+    }
+    float fitted () const {    // kPa, normalised, on the line at the latest sample
+        const double denominator = _s0 * _stt - _st * _st;
+        if (! _primed)
+            return NAN;
+        if (denominator <= 0.0)
+            return static_cast<float> (_sp / _s0);
+        return static_cast<float> ((_stt * _sp - _st * _stp) / denominator);
+    }
+    inline bool leaking () const {
+        return available () && rate () < -config.LEAK_RATE;
+    }
+    inline float pressure () const {    // kPa, latest normalised
+        return _pressure;
+    }
+    inline uint32_t restarts () const {
+        return _restarts;
+    }
+
+    inline uint32_t records () const {
+        return _records;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -2,113 +2,265 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-#include "BluetoothTPMS.hpp"
-
-#include <BLEDevice.h>
-#include <BLEScan.h>
+#include <esp_gap_ble_api.h>
 
 #include <array>
+#include <cstring>
 
 // -----------------------------------------------------------------------------------------------
-// -----------------------------------------------------------------------------------------------
 
-class ProgramManageBluetoothTPMS : private Singleton<ProgramManageBluetoothTPMS>, public Component, public Diagnosticable, protected BLEAdvertisedDeviceCallbacks {
+// the common 18 byte manufacturer data of these sensors: [company x 2, address x 6, pressure (Pa, u32 le),
+// temperature (0.01C, i32 le), battery (%), alarms (bit per alarm)], decoded in place from the raw advertisement,
+// along with the name and tx power when the sensor advertises them
+struct TpmsReading {
+    enum Alarm : uint8_t {
+        AlarmPressureHigh = 1 << 0,
+        AlarmPressureLow = 1 << 1,
+        AlarmTemperatureHigh = 1 << 2,
+        AlarmLeakRapid = 1 << 3,
+        AlarmBatteryLow = 1 << 4,
+        AlarmSensorFault = 1 << 5,
+    };    // XXX as per the vendor's sheet, not all seen on these units; others are reported by bit
+    static inline constexpr std::array<const char *, 8> ALARM_NAMES = { "pressure high", "pressure low", "temperature high", "leak rapid", "battery low", "sensor fault", "alarm 6", "alarm 7" };
+
+    float pressure = 0.0f, temperature = 0.0f;    // kPa, C
+    uint8_t battery = 0;
+    uint8_t alarms = 0;
+    int8_t rssi = 0;
+    bool txpowerPresent = false;
+    int8_t txpower = 0;
+    char name [16] = {};    // as advertised, truncated, empty if not
+    interval_t received = 0;    // when it was seen, not when it was recorded
+
+    inline bool alarm (const Alarm which) const { return (alarms & which) != 0; }
 
-    static constexpr int SCAN_TIME = 5;                                // seconds
-    static constexpr uint16_t SCAN_INTERVAL = 75, SCAN_WINDOW = 50;    // scan for 75 msec, window for 50 msec
+    static inline constexpr size_t MANUFACTURER_DATA_SIZE = 18;
+    static bool decode (const uint8_t *data, const size_t length, const int8_t rssi, TpmsReading *reading) {
+        if (data == nullptr || length != MANUFACTURER_DATA_SIZE)
+            return false;
+        const auto u32 = [] (const uint8_t *p) { return static_cast<uint32_t> (p [0]) | (static_cast<uint32_t> (p [1]) << 8) | (static_cast<uint32_t> (p [2]) << 16) | (static_cast<uint32_t> (p [3]) << 24); };
+        reading->pressure = static_cast<float> (u32 (&data [8])) / 1000.0f;
+        reading->temperature = static_cast<float> (static_cast<int32_t> (u32 (&data [12]))) / 100.0f;
+        reading->battery = data [16];
+        reading->alarms = data [17];
+        reading->rssi = rssi;
+        return true;
+    }
+    void decodeAdvertised (uint8_t *advertisement) {
+        uint8_t length = 0;
+        const uint8_t *data = esp_ble_resolve_adv_data (advertisement, ESP_BLE_AD_TYPE_NAME_CMPL, &length);
+        if (data == nullptr)
+            data = esp_ble_resolve_adv_data (advertisement, ESP_BLE_AD_TYPE_NAME_SHORT, &length);
+        if (data != nullptr)
+            std::memcpy (name, data, std::min<size_t> (length, sizeof (name) - 1));
+        if ((data = esp_ble_resolve_adv_data (advertisement, ESP_BLE_AD_TYPE_TX_PWR, &length)) != nullptr && length == 1)
+            txpowerPresent = true, txpower = static_cast<int8_t> (data [0]);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+class ProgramManageBluetoothTPMS : public Component, public Alarmable, public Diagnosticable {
 
 public:
     using Address = String;
+    using Trend = TyrePressureTrend;
     struct Config {
         Address front, rear;
+        Trend::Config trend;
+        interval_t intervalTrendPersist, intervalTrendRestoreWait;    // wait: for the network time, before starting afresh
     };
+    using BooleanFunc = std::function<bool ()>;
 
 private:
+    using AddressKey = std::array<uint8_t, 6>;
+    static bool addressParse (const Address &address, AddressKey *key) {
+        unsigned int bytes [6];
+        if (sscanf (address.c_str (), "%x:%x:%x:%x:%x:%x", &bytes [0], &bytes [1], &bytes [2], &bytes [3], &bytes [4], &bytes [5]) != 6)
+            return false;
+        for (size_t i = 0; i < key->size (); i++)
+            (*key) [i] = static_cast<uint8_t> (bytes [i]);
+        return true;
+    }
+
     const Config &config;
+    ProgramTimeline &timeline;
+    BluetoothRadio &radio;
+    const BooleanFunc _timeIsFetched;
     struct Tyre {
+        const char *name;
+        AddressKey key;
+        bool configured;
         ActivationTracker updated;
-        TpmsDataBluetooth details;
+        SnapshotConcurrentSafe<TpmsReading> details;    // written from the bluetooth task
+        ProgramTimelineChannel pressure, temperature;
+        Trend trend;
+        uint32_t recorded;
     };
-    Tyre front, rear;
-    BLEScan *scanner = nullptr;
-    bool scanning = false;
+    Tyre front { .name = "front", .key = {}, .configured = false, .updated = {}, .details = {}, .pressure = ProgramTimelineChannel::TyreFrontPressure, .temperature = ProgramTimelineChannel::TyreFrontTemperature, .trend = Trend (config.trend), .recorded = 0 },
+        rear { .name = "rear", .key = {}, .configured = false, .updated = {}, .details = {}, .pressure = ProgramTimelineChannel::TyreRearPressure, .temperature = ProgramTimelineChannel::TyreRearTemperature, .trend = Trend (config.trend), .recorded = 0 };
+    counter_t _seen = 0, _accepted = 0, _malformed = 0;
+    PersistentData _trendPersist;
+    Intervalable _trendPersistInterval;
+    bool _trendResolved = false;    // restored, or given up on
+    interval_t _trendBegun = 0;
+    const char *_trendSource = "none";
 
 public:
-    explicit ProgramManageBluetoothTPMS (const Config &conf) :
-        Singleton<ProgramManageBluetoothTPMS> (this),
-        config (conf) { }
+    ProgramManageBluetoothTPMS (const Config &conf, ProgramTimeline &timeline, BluetoothRadio &radio, const BooleanFunc timeIsFetched) :
+        Alarmable ({ AlarmCondition (ALARM_TYRE_LEAK, [this] () { return front.trend.leaking () || rear.trend.leaking (); }) }),
+        config (conf),
+        timeline (timeline),
+        radio (radio),
+        _timeIsFetched (timeIsFetched),
+        _trendPersist ("tyres"),
+        _trendPersistInterval (config.intervalTrendPersist) {
+        front.configured = addressParse (config.front, &front.key);
+        rear.configured = addressParse (config.rear, &rear.key);
+    }
 
     void begin () override {
-        BLEDevice::init ("");
-        scanner = BLEDevice::getScan ();
-        scanner->setAdvertisedDeviceCallbacks (this);
-        scanner->setActiveScan (false);
-        scanner->setInterval (SCAN_INTERVAL);
-        scanStart ();
+        _trendBegun = millis ();
+        radio.begin ();
+        radio.scan ([this] (const struct ble_scan_result_evt_param &result) { onScanResult (result); });    // raw scan results, so nothing is built for the advertisements we ignore
     }
     void process () override {
-        if (! scanning)
-            scanStart ();
+        if (! _trendResolved && ! trendResolve ())
+            return;    // readings are held back, as a trend started from them couldn't then be restored
+        record (front);
+        record (rear);
+        if (_trendPersistInterval) {
+            trendPersist (front);
+            trendPersist (rear);
+        }
     }
 
 protected:
-    Tyre *getTyre (const String &address) {
-        if (address == config.front)
+    // batched, as flash wear rules out every sample; stored with the wall time so the sums can be aged on restore
+    void trendPersist (const Tyre &tyre) {
+        const time_t now = time (nullptr);
+        if (! tyre.configured || tyre.trend.records () == 0 || now <= 0)
+            return;
+        const Trend::State state = tyre.trend.state ();
+        char buffer [192];
+        snprintf (buffer, sizeof (buffer), "%.10g,%.10g,%.10g,%.10g,%.10g,%.1f,%.3f,%lu,%lu,%lu", state.s0, state.st, state.stt, state.sp, state.stp, state.span, state.pressure, static_cast<unsigned long> (state.restarts), static_cast<unsigned long> (state.records), static_cast<unsigned long> (now));
+        _trendPersist.set (tyre.name, String (buffer));
+    }
+    // the clock is only as of its last persisted time until the network time is fetched, so the time away (and so
+    // the ageing of the sums) is unknown until then
+    bool trendResolve () {
+        if (_timeIsFetched ()) {
+            trendRestore (front);
+            trendRestore (rear);
+        } else if (millis () - _trendBegun < config.intervalTrendRestoreWait)
+            return false;
+        _trendResolved = true;
+        return true;
+    }
+    void trendRestore (Tyre &tyre) {
+        String row;
+        const time_t now = time (nullptr);
+        if (! tyre.configured || ! _trendPersist.get (tyre.name, &row))
+            return;
+        Trend::State state;
+        unsigned long restarts, records, saved;
+        if (sscanf (row.c_str (), "%lf,%lf,%lf,%lf,%lf,%f,%f,%lu,%lu,%lu", &state.s0, &state.st, &state.stt, &state.sp, &state.stp, &state.span, &state.pressure, &restarts, &records, &saved) != 10 || now <= 0 || static_cast<unsigned long> (now) < saved)
+            return;    // without a clock that has moved on, the time away is unknown, so start afresh
+        state.restarts = static_cast<uint32_t> (restarts), state.records = static_cast<uint32_t> (records);
+        if (tyre.trend.restore (state, millis (), static_cast<float> (static_cast<unsigned long> (now) - saved)))
+            _trendSource = "nvs";
+    }
+
+    // advertisements arrive unfiltered and many times a second, so only those the trend records, at most one per
+    // INTERVAL_RECORD, go on the timeline, which is shared and would otherwise be filled with tyres
+    void record (Tyre &tyre) {
+        if (tyre.details.version () == tyre.recorded)
+            return;
+        tyre.recorded = tyre.details.version ();
+        const TpmsReading reading = tyre.details.load ();
+        if (tyre.trend.update (reading.received, reading.pressure, reading.temperature)) {
+            timeline.push (tyre.pressure, reading.pressure, reading.received);
+            timeline.push (tyre.temperature, reading.temperature, reading.received);
+        }
+    }
+    Tyre *getTyre (const uint8_t *address) {
+        if (front.configured && std::memcmp (address, front.key.data (), front.key.size ()) == 0)
             return &front;
-        else if (address == config.rear)
+        else if (rear.configured && std::memcmp (address, rear.key.data (), rear.key.size ()) == 0)
             return &rear;
         return nullptr;
     }
-    void onResult (BLEAdvertisedDevice device) {
-        Tyre *tyre = getTyre (device.getAddress ().toString ());
-        if (tyre) {
-            tyre->updated++;
-            tyre->details = TpmsDataBluetooth::fromAdvertisedDevice (device);
+    // from the bluetooth task
+    void onScanResult (const struct ble_scan_result_evt_param &result) {
+        _seen++;
+        Tyre *tyre = getTyre (result.bda);
+        if (tyre == nullptr)
+            return;
+        uint8_t length = 0;
+        uint8_t *advertisement = const_cast<uint8_t *> (result.ble_adv);
+        const uint8_t *data = esp_ble_resolve_adv_data (advertisement, ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, &length);
+        TpmsReading reading;
+        if (! TpmsReading::decode (data, length, static_cast<int8_t> (result.rssi), &reading)) {
+            _malformed++;
+            return;
         }
-    }
-    static void __endOfScan (BLEScanResults) {
-        auto instance = Singleton<ProgramManageBluetoothTPMS>::instance ();
-        if (instance != nullptr)
-            instance->scanStart ();
-    }
-    void scanStart () {
-        DEBUG_PRINTF ("BluetoothTPMSManager: scanStart\n");
-        scanning = scanner->start (SCAN_TIME, __endOfScan);
+        reading.decodeAdvertised (advertisement);
+        reading.received = millis ();
+        tyre->updated++;
+        tyre->details.store (reading);
+        _accepted++;
     }
 
+    static void collectDiagnostics (JsonObject &obj, const Tyre &tyre) {
+        obj ["updated"] = tyre.updated;
+        if (tyre.details.version () > 0)
+            obj ["details"] = tyre.details.load ();
+        if (tyre.trend.records () > 0) {
+            JsonObject trend = obj ["trend"].to<JsonObject> ();
+            trend ["kpa"] = ArithmeticToString (tyre.trend.fitted (), 1);
+            if (tyre.trend.available ())
+                trend ["rate"] = ArithmeticToString (tyre.trend.rate (), 2);    // kPa/day
+            trend ["hrs"] = ArithmeticToString (tyre.trend.span () / 3600.0f, 1);
+            trend ["n"] = tyre.trend.records ();
+            if (tyre.trend.restarts () > 0)
+                trend ["inf"] = tyre.trend.restarts ();
+            if (tyre.trend.leaking ())
+                trend ["leak"] = true;
+        }
+    }
     void collectDiagnostics (JsonVariant &obj) const override {
         JsonObject f = obj ["front"].to<JsonObject> ();
-        f ["updated"] = front.updated;
-        f ["details"] = front.details;
+        collectDiagnostics (f, front);
         JsonObject r = obj ["rear"].to<JsonObject> ();
-        r ["updated"] = rear.updated;
-        r ["details"] = rear.details;
+        collectDiagnostics (r, rear);
+        obj ["trend"] = _trendSource;
+        JsonObject s = obj ["scan"].to<JsonObject> ();
+        s ["seen"] = _seen;
+        s ["accepted"] = _accepted;
+        if (_malformed)
+            s ["malformed"] = _malformed;
     }
 };
 
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
-bool convertToJson (const TpmsData &src, JsonVariant dst) {
-    dst ["pressure"]= src.pressure;
-    dst ["temperature"]= src.temperature;
-    dst ["battery"]= src.battery;
-    auto alarmStrings = src.alarmStrings ();
-    if (alarmStrings.size () > 0) {
+bool convertToJson (const TpmsReading &src, JsonVariant dst) {    // as the BluetoothTPMS library's TpmsDataBluetooth was
+    dst ["pressure"] = src.pressure;
+    dst ["temperature"] = src.temperature;
+    dst ["battery"] = src.battery;
+    if (src.alarms) {
         JsonArray alarms = dst ["alarms"].to<JsonArray> ();
-        for (const auto& alarmString : alarmStrings)
-            alarms.add (alarmString);
+        for (size_t bit = 0; bit < TpmsReading::ALARM_NAMES.size (); bit++)
+            if (src.alarms & (1 << bit))
+                alarms.add (TpmsReading::ALARM_NAMES [bit]);
     }
-    return true;
-}
-bool convertToJson (const TpmsDataBluetooth &src, JsonVariant dst) {
-    dst.set ((TpmsData)src);
-    JsonObject bluetooth;
-    if (src.name.has_value ()) bluetooth ["name"] = src.name.value ();
-    if (src.rssi.has_value ()) bluetooth ["rssi"] = src.rssi.value ();
-    if (src.txpower.has_value ()) bluetooth ["txpower"] = src.txpower.value ();
-    if (bluetooth.size () > 0)
-        dst ["bluetooth"] = bluetooth;
+    JsonObject bluetooth = dst ["bluetooth"].to<JsonObject> ();
+    if (src.name [0] != '\0')
+        bluetooth ["name"] = src.name;
+    bluetooth ["rssi"] = src.rssi;
+    if (src.txpowerPresent)
+        bluetooth ["txpower"] = src.txpower;
     return true;
 }
 
@@ -0,0 +1,215 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <BLEDevice.h>
+
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
+
+#include <atomic>
+
+// -----------------------------------------------------------------------------------------------
+
+// sole owner of the bluetooth stack: initialises it once, takes the one GAP and GATTS callbacks and fans them out, and runs the
+// scanner in bursts whose duty follows the GATT side: full when nobody is connected, light when a client is
+// connected, and lighter still while it is being streamed to, with the scan window kept below the connection
+// interval so the controller can fit the connection events around it (bluedroid does not expose their timing)
+
+class BluetoothRadio : private Singleton<BluetoothRadio>, public JsonSerializable {
+public:
+    typedef struct {
+        String name;
+        uint32_t scanSeconds;    // per burst
+        struct Duty {
+            uint16_t interval, window;    // msec
+            interval_t rest;              // msec, between bursts
+        } idle, connected, streaming;
+        interval_t streamingHold;    // msec since the last transmit that still counts as streaming
+    } Config;
+
+    enum class Mode : uint8_t {
+        Idle,
+        Connected,
+        Streaming
+    };
+    static const char *toString (const Mode mode) {
+        switch (mode) {
+        case Mode::Connected :
+            return "connected";
+        case Mode::Streaming :
+            return "streaming";
+        case Mode::Idle :
+        default :
+            return "idle";
+        }
+    }
+
+    using GapListener = std::function<void (esp_gap_ble_cb_event_t, esp_ble_gap_cb_param_t *)>;
+    using ScanListener = std::function<void (const struct ble_scan_result_evt_param &)>;
+    using ServerListener = std::function<void (esp_gatts_cb_event_t, esp_gatt_if_t, esp_ble_gatts_cb_param_t *)>;
+
+private:
+    const Config &config;
+
+    bool _initialised = false;
+    std::vector<GapListener> _listeners;    // registered at setup, before any events
+    std::vector<ServerListener> _serverListeners;
+    ScanListener _scanner;
+
+    enum class ScanState : uint8_t {
+        Stopped,
+        Configuring,    // params set, awaiting start
+        Scanning,
+        Resting
+    };
+    // shared with the bluetooth task
+    std::atomic<ScanState> _scanState { ScanState::Stopped };
+    Mode _scanMode = Mode::Idle;
+    std::atomic<interval_t> _scanStarted { 0 }, _scanEnded { 0 };
+    std::atomic<interval_t> _scanTime { 0 }, _scanAirtime { 0 };    // msec, in bursts / estimated listening (window / interval)
+    std::atomic<counter_t> _scanBursts { 0 }, _scanFailures { 0 }, _scanResults { 0 }, _events { 0 };
+
+    bool _connected = false;
+    interval_t _connectedSince = 0, _connectedTime = 0, _transmitted = 0, _streamingTime = 0, _streamingChecked = 0;
+    counter_t _transmits = 0;
+
+    const Config::Duty &duty (const Mode mode) const {
+        return mode == Mode::Streaming ? config.streaming : (mode == Mode::Connected ? config.connected : config.idle);
+    }
+    void scanConfigure () {
+        _scanMode = mode ();
+        const Config::Duty &d = duty (_scanMode);
+        static esp_ble_scan_params_t params = {
+            .scan_type = BLE_SCAN_TYPE_PASSIVE,
+            .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+            .scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+            .scan_interval = 0,
+            .scan_window = 0,
+            .scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE
+        };
+        params.scan_interval = static_cast<uint16_t> (d.interval * 1000 / 625);    // in 0.625 ms units
+        params.scan_window = static_cast<uint16_t> (d.window * 1000 / 625);
+        _scanState = ScanState::Configuring;
+        if (esp_ble_gap_set_scan_params (&params) != ESP_OK)    // burst starts on completion
+            _scanFailed ();
+    }
+    void _scanFailed () {
+        _scanFailures++;
+        _scanEnded = millis ();
+        _scanState = ScanState::Resting;
+    }
+    void _scanCompleted () {
+        const interval_t elapsed = millis () - _scanStarted.load ();
+        const Config::Duty &d = duty (_scanMode);
+        _scanTime += elapsed;
+        _scanAirtime += elapsed * d.window / d.interval;
+        _scanEnded = millis ();
+        _scanState = ScanState::Resting;
+    }
+
+    // from the bluetooth task
+    void events (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+        _events++;
+        if (_scanner) {
+            if (event == ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT && _scanState == ScanState::Configuring) {
+                if (param->scan_param_cmpl.status != ESP_BT_STATUS_SUCCESS || esp_ble_gap_start_scanning (config.scanSeconds) != ESP_OK)
+                    _scanFailed ();
+            } else if (event == ESP_GAP_BLE_SCAN_START_COMPLETE_EVT && _scanState == ScanState::Configuring) {
+                if (param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS)
+                    _scanStarted = millis (), _scanBursts++, _scanState = ScanState::Scanning;
+                else
+                    _scanFailed ();
+            } else if (event == ESP_GAP_BLE_SCAN_RESULT_EVT) {
+                if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT)
+                    _scanResults++, _scanner (param->scan_rst);
+                else if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT && _scanState == ScanState::Scanning)
+                    _scanCompleted ();    // next burst from process ()
+            }
+        }
+        for (const auto &listener : _listeners)
+            listener (event, param);
+    }
+    static void __gapEventHandler (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+        auto instance = Singleton<BluetoothRadio>::instance ();
+        if (instance != nullptr)
+            instance->events (event, param);
+    }
+    static void __gattsEventHandler (esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+        auto instance = Singleton<BluetoothRadio>::instance ();
+        if (instance != nullptr)
+            for (const auto &listener : instance->_serverListeners)
+                listener (event, gatts_if, param);
+    }
+
+public:
+    explicit BluetoothRadio (const Config &cfg) :
+        Singleton<BluetoothRadio> (this),
+        config (cfg) { }
+
+    void begin () {    // idempotent, so users need not be ordered
+        if (! _initialised) {
+            BLEDevice::init (config.name);
+            BLEDevice::setCustomGapHandler (__gapEventHandler);    // chained from BLEDevice's own handler, so the library still sees every event
+            BLEDevice::setCustomGattsHandler (__gattsEventHandler);
+            _initialised = true;
+        }
+    }
+    void process () {
+        if (_initialised && _scanner && (_scanState == ScanState::Stopped || (_scanState == ScanState::Resting && (millis () - _scanEnded) >= duty (mode ()).rest)))
+            scanConfigure ();
+        if (mode () == Mode::Streaming)
+            _streamingTime += millis () - _streamingChecked;
+        _streamingChecked = millis ();
+    }
+
+    void listen (const GapListener listener) {
+        _listeners.push_back (listener);
+    }
+    void listen (const ServerListener listener) {
+        _serverListeners.push_back (listener);
+    }
+    void scan (const ScanListener listener) {    // continuous, in bursts, from the next process ()
+        _scanner = listener;
+    }
+
+    // from the GATT side
+    void connected (const bool connected) {
+        if (connected && ! _connected)
+            _connectedSince = millis ();
+        else if (! connected && _connected)
+            _connectedTime += millis () - _connectedSince;
+        _connected = connected;
+    }
+    void transmitted () {
+        _transmitted = millis ();
+        _transmits++;
+    }
+    Mode mode () const {
+        if (! _connected)
+            return Mode::Idle;
+        return (_transmits > 0 && (millis () - _transmitted) < config.streamingHold) ? Mode::Streaming : Mode::Connected;
+    }
+
+    void serialize (JsonVariant &obj) const override {
+        obj ["mode"] = toString (mode ());
+        JsonObject scan = obj ["scan"].to<JsonObject> ();
+        scan ["mode"] = toString (_scanMode);
+        scan ["bursts"] = _scanBursts.load ();
+        scan ["results"] = _scanResults.load ();
+        if (_scanFailures)
+            scan ["failures"] = _scanFailures.load ();
+        scan ["time"] = _scanTime / 1000;
+        scan ["air"] = _scanAirtime / 1000;    // seconds, estimated
+        if (_scanTime > 0)
+            scan ["duty"] = ArithmeticToString (100.0f * static_cast<float> (_scanAirtime.load ()) / static_cast<float> (millis ()), 1);    // % of uptime
+        JsonObject conn = obj ["conn"].to<JsonObject> ();
+        conn ["time"] = (_connectedTime + (_connected ? millis () - _connectedSince : 0)) / 1000;
+        conn ["stream"] = _streamingTime / 1000;
+        conn ["tx"] = _transmits;
+        obj ["events"] = _events.load ();
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
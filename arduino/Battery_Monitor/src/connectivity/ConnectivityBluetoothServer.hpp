@@ -8,19 +8,201 @@
 #include <BLE2902.h>
 
 #include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// -----------------------------------------------------------------------------------------------
+
+// notifications wait in a bounded queue and go to the stack one at a time: the next when the stack confirms the
+// last (ESP_GATTS_CONF_EVT, which for a notification means it was taken, not acknowledged), none while the link is
+// congested (ESP_GATTS_CONGEST_EVT); a frame is only admitted if all of its parts fit, so the peer never sees part
+// of one, and the queue goes with the connection; each notification is for its characteristic's handle, so the
+// characteristics share the one queue in order; filled from the main loop, drained from there and the bluetooth task
+
+class BluetoothNotifier : public JsonSerializable {
+public:
+    static inline constexpr size_t PAYLOAD_MAX = ESP_GATT_MAX_ATTR_LEN;    // not MAX_MTU - 3, as no attribute value is longer
+
+    typedef struct {
+        size_t depth;          // notifications
+        interval_t timeout;    // msec, for a confirm, before giving up on it
+        counter_t retries;
+    } Config;
+
+    using Sender = std::function<bool (const uint16_t, const uint8_t *, const size_t)>;    // handle, to the stack, true if taken
+
+private:
+    const Config &config;
+    const Sender _sender;
+
+    struct Slot {
+        uint16_t handle, size;
+        uint8_t data [PAYLOAD_MAX];
+    };
+    std::vector<Slot> _slots;
+    mutable std::mutex _mutex;
+    size_t _head = 0, _count = 0, _peak = 0;
+    bool _active = false, _inflight = false, _congested = false;
+    interval_t _inflightSince = 0, _busySince = 0, _busyTime = 0;    // busy: from the first queued to the queue emptied
+    uint64_t _bytes = 0;
+    counter_t _inflightRetries = 0;
+    counter_t _queued = 0, _sent = 0, _dropped = 0, _failed = 0, _congestions = 0, _stalls = 0;
+
+    void _release () {
+        _head = (_head + 1) % _slots.size ();
+        if (--_count == 0)
+            _busyTime += millis () - _busySince;
+        _inflightRetries = 0;
+    }
+    void _retry () {
+        if (++_inflightRetries > config.retries)
+            _release (), _failed++;
+    }
+    void _drain () {
+        if (_active && ! _inflight && ! _congested && _count > 0) {
+            if (_sender (_slots [_head].handle, _slots [_head].data, _slots [_head].size))
+                _inflight = true, _inflightSince = millis ();
+            else
+                _retry ();
+        }
+    }
+
+public:
+    explicit BluetoothNotifier (const Config &cfg, const Sender sender) :
+        config (cfg),
+        _sender (sender),
+        _slots (config.depth) { }
+
+    void reset (const bool active) {    // per connection
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_count > 0)
+            _busyTime += millis () - _busySince;
+        _head = 0, _count = 0;
+        _inflight = false, _congested = false, _inflightRetries = 0;
+        _active = active;
+    }
+    bool admit (const size_t parts) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_active && parts <= _slots.size () - _count)
+            return true;
+        _dropped++;
+        return false;
+    }
+    void push (const uint16_t handle, const uint8_t *data, const size_t size) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (! _active || _count == _slots.size () || size > PAYLOAD_MAX)
+            return;
+        Slot &slot = _slots [(_head + _count) % _slots.size ()];
+        memcpy (slot.data, data, size);
+        slot.handle = handle;
+        slot.size = static_cast<uint16_t> (size);
+        if (_count == 0)
+            _busySince = millis ();
+        _peak = std::max (_peak, ++_count);
+        _queued++;
+        _drain ();
+    }
+    void process () {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_inflight && (millis () - _inflightSince) > config.timeout)
+            _inflight = false, _stalls++, _retry ();
+        _drain ();
+    }
+
+    // from the bluetooth task
+    void confirmed (const uint16_t handle, const bool success) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_inflight && _slots [_head].handle == handle) {
+            _inflight = false;
+            if (success)
+                _bytes += _slots [_head].size, _release (), _sent++;
+            else
+                _retry ();
+        }
+        _drain ();
+    }
+    void congested (const bool congested) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (congested && ! _congested)
+            _congestions++;
+        _congested = congested;
+        _drain ();
+    }
+
+    void serialize (JsonVariant &obj) const override {
+        std::lock_guard<std::mutex> guard (_mutex);
+        obj ["depth"] = _count;
+        obj ["peak"] = _peak;
+        obj ["size"] = _slots.size ();
+        obj ["queued"] = _queued;
+        obj ["sent"] = _sent;
+        obj ["bytes"] = _bytes;
+        const interval_t busy = _busyTime + (_count > 0 ? millis () - _busySince : 0);
+        if (busy > 0)
+            obj ["rate"] = static_cast<uint32_t> (_bytes * 1000 / busy);    // bytes/sec, while there was something to send
+        if (_dropped)
+            obj ["dropped"] = _dropped;    // frames, not admitted
+        if (_failed)
+            obj ["failed"] = _failed;    // notifications, given up on
+        if (_congestions)
+            obj ["congestions"] = _congestions;
+        if (_stalls)
+            obj ["stalls"] = _stalls;
+    }
+};
 
 // -----------------------------------------------------------------------------------------------
 
-class BluetoothServer : private Singleton<BluetoothServer>, public ConnectionReceiver<BluetoothServer>::Insertable, protected BLEServerCallbacks, protected BLECharacteristicCallbacks, public JsonSerializable {
+class BluetoothServer : public ConnectionReceiver<BluetoothServer>::Insertable, public ConnectionSession, protected BLEServerCallbacks, protected BLECharacteristicCallbacks, public JsonSerializable {
 public:
     static inline constexpr uint16_t MIN_MTU = 32, MAX_MTU = 517;
 
     typedef struct {
-        String name, serviceUUID, characteristicUUID;
+        String name, serviceUUID;
+        struct Characteristics {
+            String data, diag, alarms, control;
+        } characteristicUUIDs;
         uint32_t pin;
         interval_t intervalConnectionCheck;
+        BluetoothNotifier::Config notify;
+        struct Link {
+            bool phy2M;
+            uint16_t dataLength;    // octets per PDU, 27 to 251
+            struct Interval {
+                uint16_t min, max;    // msec
+                uint16_t latency;     // connection events
+                uint16_t timeout;     // msec
+            } streaming, relaxed;
+        } link;
     } Config;
 
+    // the peer subscribes to what it wants: data is notified as it is delivered, diag only when the peer asks for it
+    // (it is large), alarms when they change; each can be read, served from the latest frame as last serialised, and
+    // control takes the peer's writes (as does data, for older peers)
+    enum class Characteristic : uint8_t {
+        Data,
+        Diag,
+        Alarms,
+        Control
+    };
+    static inline constexpr size_t CHARACTERISTICS = 4;
+    static const char *toString (const Characteristic characteristic) {
+        switch (characteristic) {
+        case Characteristic::Diag :
+            return "diag";
+        case Characteristic::Alarms :
+            return "alarms";
+        case Characteristic::Control :
+            return "control";
+        case Characteristic::Data :
+        default :
+            return "data";
+        }
+    }
+
 private:
     //
 
@@ -30,6 +212,7 @@ private:
                       param->connect.conn_id,
                       _linkrole_to_string (param->connect.link_role).c_str ());
         _connected (param->connect.conn_id, param->connect.remote_bda);
+        _connected_linkParams (param->connect.conn_params.interval, param->connect.conn_params.latency, param->connect.conn_params.timeout);
     }
     void onMtuChanged (BLEServer *, esp_ble_gatts_cb_param_t *param) override {
         DEBUG_PRINTF ("BluetoothDevice::events: BLE_MTU_CHANGED, (conn_id=%d, mtu=%u)\n", param->mtu.conn_id, param->mtu.mtu);
@@ -38,10 +221,7 @@ private:
     void onRead (BLECharacteristic *characteristic, esp_ble_gatts_cb_param_t *param) override {
         // param->offset, param->is_long
         DEBUG_PRINTF ("BluetoothDevice::events: BLE_CHARACTERISTIC_READ, (uuid=%s, offset=%d, is_long=%d)\n", characteristic->getUUID ().toString ().c_str (), param->read.offset, param->read.is_long);
-        String str;
-        _connected_readRequested (str);    // XXX uuid
-        if (! str.isEmpty ())
-            characteristic->setValue (str.c_str ());
+        _connected_readRequested (characteristic);    // long reads continue from the value set on the first
     }
     void onWrite (BLECharacteristic *characteristic, esp_ble_gatts_cb_param_t *) override {
         // param->write.offset, param->write.len, param->write.value
@@ -63,38 +243,100 @@ private:
                       reason.c_str ());
         _disconnected (param->disconnect.conn_id, param->disconnect.remote_bda, reason);
     }
+    void events (const esp_gatts_cb_event_t event, const esp_ble_gatts_cb_param_t *param) {
+        if (event == ESP_GATTS_CONF_EVT) {
+            _notifier.confirmed (param->conf.handle, param->conf.status == ESP_GATT_OK);
+        } else if (event == ESP_GATTS_CONGEST_EVT)
+            _notifier.congested (param->congest.congested);
+    }
     void events (const esp_gap_ble_cb_event_t event, const esp_ble_gap_cb_param_t *param) {
         if (event == ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT) {
             if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
                 DEBUG_PRINTF ("BluetoothDevice::events: BLE_READ_RSSI_COMPLETE, (rssi=%d, quality=%s)\n", param->read_rssi_cmpl.rssi, ConnectionSignal::toString (ConnectionSignal::signalQuality (param->read_rssi_cmpl.rssi)).c_str ());
                 _connected_rssiResponse (param->read_rssi_cmpl.rssi);
             }
+        } else if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+            DEBUG_PRINTF ("BluetoothDevice::events: BLE_UPDATE_CONN_PARAMS, (status=%d, interval=%u, latency=%u, timeout=%u)\n", param->update_conn_params.status, param->update_conn_params.conn_int, param->update_conn_params.latency, param->update_conn_params.timeout);
+            if (_connectionActive && memcmp (param->update_conn_params.bda, _peerAddress, sizeof (esp_bd_addr_t)) == 0) {
+                if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS)
+                    _connected_linkParams (param->update_conn_params.conn_int, param->update_conn_params.latency, param->update_conn_params.timeout);
+                else
+                    _linkFailures++;
+            }
+        } else if (event == ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT) {
+            DEBUG_PRINTF ("BluetoothDevice::events: BLE_SET_PKT_LENGTH_COMPLETE, (status=%d, tx=%u, rx=%u)\n", param->pkt_data_length_cmpl.status, param->pkt_data_length_cmpl.params.tx_len, param->pkt_data_length_cmpl.params.rx_len);
+            if (_connectionActive) {
+                if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS)
+                    _link.txLength = param->pkt_data_length_cmpl.params.tx_len, _link.rxLength = param->pkt_data_length_cmpl.params.rx_len;
+                else
+                    _linkFailures++;
+            }
         }
-    }
-    static void __gapEventHandler (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
-        auto instance = Singleton<BluetoothServer>::instance ();
-        if (instance != nullptr)
-            instance->events (event, param);
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+        else if (event == ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT) {
+            DEBUG_PRINTF ("BluetoothDevice::events: BLE_PHY_UPDATE_COMPLETE, (status=%d, tx=%u, rx=%u)\n", param->phy_update.status, param->phy_update.tx_phy, param->phy_update.rx_phy);
+            if (_connectionActive && memcmp (param->phy_update.bda, _peerAddress, sizeof (esp_bd_addr_t)) == 0) {
+                if (param->phy_update.status == ESP_BT_STATUS_SUCCESS)
+                    _link.txPhy = param->phy_update.tx_phy, _link.rxPhy = param->phy_update.rx_phy;
+                else
+                    _linkFailures++;
+            }
+        }
+#endif
     }
 
     //
 
     const Config &config;
+    BluetoothRadio &_radio;
 
     BLEServer *_server = nullptr;
-    BLECharacteristic *_characteristic = nullptr;
+    struct Channel {
+        BLECharacteristic *characteristic = nullptr;
+        BLE2902 *notifications = nullptr;
+        std::vector<uint8_t> snapshot;    // written from the main loop, read from the bluetooth task
+        counter_t updates = 0, reads = 0, oversized = 0;
+        bool requested = false;    // by the peer, to be collected afresh
+    };
+    std::array<Channel, CHARACTERISTICS> _channels;
+    std::mutex _snapshotMutex;
+    Channel &_channel (const Characteristic characteristic) {
+        return _channels [static_cast<size_t> (characteristic)];
+    }
+    const Channel &_channel (const Characteristic characteristic) const {
+        return _channels [static_cast<size_t> (characteristic)];
+    }
+    bool _subscribed (const Characteristic characteristic) const {
+        const Channel &channel = _channel (characteristic);
+        return channel.notifications != nullptr && channel.notifications->getNotifications ();
+    }
+    bool _subscribed (const uint16_t handle) const {
+        for (const auto &channel : _channels)
+            if (channel.characteristic != nullptr && channel.characteristic->getHandle () == handle)
+                return channel.notifications != nullptr && channel.notifications->getNotifications ();
+        return false;
+    }
+    void _channelCreate (BLEService *service, const Characteristic characteristic, const String &uuid, const uint32_t properties) {
+        Channel &channel = _channel (characteristic);
+        channel.characteristic = service->createCharacteristic (uuid, properties);
+        channel.characteristic->setCallbacks (this);
+        if (properties & BLECharacteristic::PROPERTY_NOTIFY)
+            channel.characteristic->addDescriptor (channel.notifications = new BLE2902 ());
+        // channel.characteristic->setAccessPermissions (ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_WRITE_ENCRYPTED); // must enable BLEDevice::setEncryptionLevel (ESP_BLE_SEC_ENCRYPT)
+        channel.characteristic->setAccessPermissions (((properties & BLECharacteristic::PROPERTY_READ) ? ESP_GATT_PERM_READ : 0) | ((properties & (BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR)) ? ESP_GATT_PERM_WRITE : 0));    // no need for encryption
+    }
     void _serverInitAndStartService () {
-        BLEDevice::init (config.name);
+        _radio.begin ();
         _server = BLEDevice::createServer ();
         // BLEDevice::setEncryptionLevel (ESP_BLE_SEC_ENCRYPT);
-        esp_ble_gap_register_callback (__gapEventHandler);
+        _radio.listen ([this] (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) { events (event, param); });
+        _radio.listen ([this] (esp_gatts_cb_event_t event, esp_gatt_if_t, esp_ble_gatts_cb_param_t *param) { events (event, param); });
         _server->setCallbacks (this);
-        BLEService *service = _server->createService (config.serviceUUID);
-        _characteristic = service->createCharacteristic (config.characteristicUUID, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY);
-        _characteristic->setCallbacks (this);
-        _characteristic->addDescriptor (new BLE2902 ());
-        // _characteristic->setAccessPermissions (ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_WRITE_ENCRYPTED); // must enable BLEDevice::setEncryptionLevel (ESP_BLE_SEC_ENCRYPT)
-        _characteristic->setAccessPermissions (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE);    // no need for encryption
+        BLEService *service = _server->createService (BLEUUID (config.serviceUUID), 16);    // 1 + 4 characteristics of 2 + 3 descriptors
+        _channelCreate (service, Characteristic::Data, config.characteristicUUIDs.data, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_NOTIFY);
+        _channelCreate (service, Characteristic::Diag, config.characteristicUUIDs.diag, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+        _channelCreate (service, Characteristic::Alarms, config.characteristicUUIDs.alarms, BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+        _channelCreate (service, Characteristic::Control, config.characteristicUUIDs.control, BLECharacteristic::PROPERTY_WRITE | BLECharacteristic::PROPERTY_WRITE_NR);
         service->start ();
         BLESecurity *security = new BLESecurity ();
         security->setStaticPIN (config.pin);
@@ -130,8 +372,17 @@ private:
     esp_bd_addr_t _peerAddress;
     uint16_t _peerConnId = 0;
     uint16_t _peerMtu = 0;
+    JsonEncoding _peerEncoding = JsonEncoding::Text;
     ConnectionReceiver<BluetoothServer> _connectionReceiver;
-    ConnectionSender<BluetoothServer> _connectionSender;
+    BluetoothNotifier _notifier;
+    ConnectionSender<BluetoothServer> _senderData, _senderDiag, _senderAlarms;    // each chunks into its own characteristic
+    static_assert (ConnectionSender<BluetoothServer>::PAYLOAD_MAX == BluetoothNotifier::PAYLOAD_MAX, "a chunk must fit a notification");
+    ConnectionSender<BluetoothServer> &_sender (const Characteristic characteristic) {
+        return characteristic == Characteristic::Diag ? _senderDiag : (characteristic == Characteristic::Alarms ? _senderAlarms : _senderData);
+    }
+    ConnectionSender<BluetoothServer> _senderTo (const Characteristic characteristic) {
+        return ConnectionSender<BluetoothServer> ([this, characteristic] (const uint8_t *data, const size_t size) { _notifier.push (_channel (characteristic).characteristic->getHandle (), data, size); }, [this] (const size_t parts) { return _notifier.admit (parts); });
+    }
     ActivationTracker _connections;
     ActivationTrackerWithDetail _disconnections;
     Intervalable _connectionActiveChecker;
@@ -140,17 +391,68 @@ private:
     void _connect () {
         _advertisingEnable ();
     }
+    // what the link ended up as, after asking for 2M PHY, long PDUs, and an interval to suit the traffic: short
+    // while streaming, relaxed otherwise (the peer has the last word on all of them)
+    struct Link {
+        uint8_t txPhy = 1, rxPhy = 1;                   // 1M, 2M, coded
+        uint16_t txLength = 27, rxLength = 27;          // octets per PDU
+        uint16_t interval = 0, latency = 0, timeout = 0;    // as negotiated: 1.25 msec units, events, 10 msec units
+    } _link;
+    enum class LinkProfile : uint8_t {
+        None,
+        Relaxed,
+        Streaming
+    } _linkProfile = LinkProfile::None;
+    counter_t _linkUpdates = 0, _linkFailures = 0;
+    void _linkNegotiate () {
+        _link = Link ();
+        _linkProfile = LinkProfile::None;
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+        if (config.link.phy2M && esp_ble_gap_set_preferred_phy (_peerAddress, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF) != ESP_OK)
+            _linkFailures++;
+#endif
+        if (config.link.dataLength > 27 && esp_ble_gap_set_pkt_data_len (_peerAddress, config.link.dataLength) != ESP_OK)
+            _linkFailures++;
+    }
+    void _linkInterval (const LinkProfile profile) {
+        const Config::Link::Interval &interval = (profile == LinkProfile::Streaming) ? config.link.streaming : config.link.relaxed;
+        esp_ble_conn_update_params_t params = {
+            .min_int = static_cast<uint16_t> (interval.min * 4 / 5),    // in 1.25 msec units
+            .max_int = static_cast<uint16_t> (interval.max * 4 / 5),
+            .latency = interval.latency,
+            .timeout = static_cast<uint16_t> (interval.timeout / 10)    // in 10 msec units
+        };
+        memcpy (params.bda, _peerAddress, sizeof (esp_bd_addr_t));
+        if (esp_ble_gap_update_conn_params (&params) == ESP_OK)
+            _linkUpdates++;
+        else
+            _linkFailures++;
+        _linkProfile = profile;
+    }
+    void _connected_linkParams (const uint16_t interval, const uint16_t latency, const uint16_t timeout) {
+        if (_connectionActive)
+            _link.interval = interval, _link.latency = latency, _link.timeout = timeout;
+    }
     void _connected (const uint16_t conn_id, const esp_bd_addr_t &addr) {
         if (! _connectionActive) {
             _advertisingDisable ();
             _peerMtu = 0;
+            _peerEncoding = JsonEncoding::Text;
             _peerConnId = conn_id;
             memcpy (_peerAddress, addr, sizeof (esp_bd_addr_t));
             _connectionSignalTracker.reset ();
             _connectionActiveChecker.reset ();
+            for (auto &channel : _channels) {
+                if (channel.notifications != nullptr)
+                    channel.notifications->setNotifications (false);    // until this peer subscribes
+                channel.requested = false;
+            }
             _connections++;
             _connectionActive = true;
+            _notifier.reset (true);
+            _radio.connected (true);
             _server->updatePeerMTU (_peerConnId, MAX_MTU);
+            _linkNegotiate ();
             esp_ble_gap_read_rssi (_peerAddress);
         }
     }
@@ -169,12 +471,19 @@ private:
             _connectionReceiver.insert (str);
         }
     }
-    void _connected_readRequested (String &str) {
+    void _connected_readRequested (BLECharacteristic *characteristic) {
         if (_connectionActive) {
-            //
+            for (auto &channel : _channels)
+                if (channel.characteristic == characteristic) {
+                    std::lock_guard<std::mutex> guard (_snapshotMutex);
+                    if (channel.snapshot.size () <= ESP_GATT_MAX_ATTR_LEN)
+                        characteristic->setValue (channel.snapshot.data (), channel.snapshot.size ()), channel.reads++;
+                    else
+                        characteristic->setValue (""), channel.oversized++;    // XXX too large for an attribute, so ask for it to be notified
+                }
         }
     }
-    bool _connected_send (const String &data) {
+    bool _connected_sendWith (const std::function<bool (const size_t)> &send) {
         if (_connectionActive) {
             if (! _peerMtu) {
                 DEBUG_PRINTF ("BluetoothDevice::send: awaiting peer MTU negotiation, sliently discarding");
@@ -183,18 +492,45 @@ private:
                 DEBUG_PRINTF ("BluetoothDevice::send: peer MTU size (%u) is below minimum (%u)", _peerMtu, MIN_MTU);
                 return false;
             }
-            return _connectionSender.send (data, _peerMtu - 3);
+            if (! send (std::min<size_t> (_peerMtu - 3, ESP_GATT_MAX_ATTR_LEN)))
+                return false;
+            _radio.transmitted ();
+            return true;
         } else {
             DEBUG_PRINTF ("BluetoothDevice::send: not connected");
             return false;
         }
     }
+    bool _connected_send (const String &data) {
+        if (! _subscribed (Characteristic::Data))
+            return false;
+        return _connected_sendWith ([&] (const size_t payload) {
+            return _senderData.send (data, payload);
+        });
+    }
+    bool _connected_send (const JsonCollector &frame) {    // serialised straight into notifications, in chunks if larger
+        if (! _subscribed (Characteristic::Data))
+            return false;
+        return _connected_sendWith ([&] (const size_t payload) {
+            return _senderData.send (frame.document (), _peerEncoding, payload);
+        });
+    }
+    bool _connected_notify (const Characteristic characteristic) {    // the snapshot, as it is
+        const std::vector<uint8_t> &snapshot = _channel (characteristic).snapshot;    // only written from here, the main loop
+        if (! _subscribed (characteristic) || snapshot.empty ())
+            return false;
+        return _connected_sendWith ([&] (const size_t payload) {
+            return _sender (characteristic).send (snapshot.data (), snapshot.size (), payload);
+        });
+    }
     void _disconnect (const bool forced = false) {    // in case of weird situation
         if (_connectionActive || forced) {
             if (! _connectionActive && forced)
                 _advertisingDisable ();
             _server->disconnect (_peerConnId);
             _connectionActive = false;
+            _notifier.reset (false);
+            _radio.connected (false);
             _disconnections += String ("Locally initiated");
             if (forced)
                 delay (500);
@@ -205,6 +541,8 @@ private:
     void _disconnected (const uint16_t conn_id, const esp_bd_addr_t &addr, const String &reason) {
         if (_connectionActive) {
             _connectionActive = false;
+            _notifier.reset (false);
+            _radio.connected (false);
             _disconnections += reason;
             _connectionReceiver.drain ();
             _connect ();
@@ -223,6 +561,12 @@ private:
                     esp_ble_gap_read_rssi (_peerAddress);
                 }
             }
+            if (_peerMtu) {    // after the MTU exchange, so as not to collide with it
+                const LinkProfile profile = _radio.mode () == BluetoothRadio::Mode::Streaming ? LinkProfile::Streaming : LinkProfile::Relaxed;
+                if (profile != _linkProfile)
+                    _linkInterval (profile);
+            }
+            _notifier.process ();
             _connectionReceiver.process ();
         }
     }
@@ -230,15 +574,20 @@ private:
     //
 
 public:
-    explicit BluetoothServer (const Config &cfg, const ConnectionSignal::Callback connectionSignalCallback = nullptr) :
-        Singleton<BluetoothServer> (this),
+    explicit BluetoothServer (const Config &cfg, BluetoothRadio &radio, const ConnectionSignal::Callback connectionSignalCallback = nullptr) :
         ConnectionReceiver<BluetoothServer>::Insertable (&_connectionReceiver),
+        ConnectionSession (_connections),
         config (cfg),
+        _radio (radio),
         _connectionReceiver (this),
-        _connectionSender ([&] (const String &str) {
-            _characteristic->setValue (str.c_str ());
-            _characteristic->notify ();
+        _notifier (config.notify, [&] (const uint16_t handle, const uint8_t *data, const size_t size) {    // not BLECharacteristic::notify (), which blocks until confirmed
+            if (! _subscribed (handle))
+                return false;
+            return esp_ble_gatts_send_indicate (_server->getGattsIf (), _peerConnId, handle, size, const_cast<uint8_t *> (data), false) == ESP_OK;
         }),
+        _senderData (_senderTo (Characteristic::Data)),
+        _senderDiag (_senderTo (Characteristic::Diag)),
+        _senderAlarms (_senderTo (Characteristic::Alarms)),
         _connectionActiveChecker (config.intervalConnectionCheck),
         _connectionSignalTracker (connectionSignalCallback) { }
 
@@ -263,8 +612,45 @@ public:
     bool send (const String &data) {
         return _connected_send (data);
     }
+    bool send (const JsonCollector &frame) {
+        return _connected_send (frame);
+    }
+    bool subscribed (const Characteristic characteristic) const {
+        return _connectionActive && _subscribed (characteristic);
+    }
+    void snapshot (const Characteristic characteristic, const JsonCollector &frame) {    // the latest, for reads and notify (), in the peer's encoding
+        std::vector<uint8_t> value;
+        if (_peerEncoding == JsonEncoding::MsgPack)
+            value = frame.packed ();
+        else
+            value.assign (frame.text ().c_str (), frame.text ().c_str () + frame.text ().length ());
+        Channel &channel = _channel (characteristic);
+        std::lock_guard<std::mutex> guard (_snapshotMutex);
+        channel.snapshot.swap (value);
+        channel.updates++;
+    }
+    bool notify (const Characteristic characteristic) {
+        return _connected_notify (characteristic);
+    }
+    void request (const Characteristic characteristic) {    // the peer wants it fresh, not the snapshot it can read
+        if (_connectionActive)
+            _channel (characteristic).requested = true;
+    }
+    bool requested (const Characteristic characteristic) {
+        Channel &channel = _channel (characteristic);
+        const bool requested = channel.requested;
+        channel.requested = false;
+        return requested;
+    }
+    void encoding (const JsonEncoding encoding) {    // negotiated by the peer, for this connection
+        if (_connectionActive)
+            _peerEncoding = encoding;
+    }
+    JsonEncoding encoding () const {
+        return _peerEncoding;
+    }
     bool payloadExceeded () const {
-        return _connectionSender._payloadExceeded;
+        return _senderData._payloadExceeded || _senderDiag._payloadExceeded || _senderAlarms._payloadExceeded;
     }
     //
     void serialize (JsonVariant &obj) const override {
@@ -272,10 +658,46 @@ public:
         if ((obj ["connected"] = _connectionActive)) {
             obj ["address"] = _address_to_string (_peerAddress);
             obj ["mtu"] = _peerMtu;
+            obj ["format"] = JsonEncodingToString (_peerEncoding);
             obj ["signal"] = _connectionSignalTracker;
+            JsonObject link = obj ["link"].to<JsonObject> ();
+            link ["phy"] = _phy_to_string (_link.txPhy) + "/" + _phy_to_string (_link.rxPhy);
+            link ["pdu"] = ArithmeticToString (_link.txLength) + "/" + ArithmeticToString (_link.rxLength);
+            link ["interval"] = ArithmeticToString (_link.interval * 1.25f, 2);    // msec
+            link ["latency"] = _link.latency;
+            link ["timeout"] = _link.timeout * 10;    // msec
+            link ["profile"] = _linkProfile == LinkProfile::Streaming ? "streaming" : "relaxed";
+        }
+        if (_linkUpdates)
+            obj ["linkUpdates"] = _linkUpdates;
+        if (_linkFailures)
+            obj ["linkFailures"] = _linkFailures;
+        obj ["notify"] = _notifier;
+        JsonObject characteristics = obj ["characteristics"].to<JsonObject> ();
+        for (size_t index = 0; index < CHARACTERISTICS; index++) {
+            const Characteristic characteristic = static_cast<Characteristic> (index);
+            const Channel &channel = _channel (characteristic);
+            JsonObject sub = characteristics [toString (characteristic)].to<JsonObject> ();
+            if (channel.notifications != nullptr)
+                sub ["subscribed"] = subscribed (characteristic);
+            if (channel.updates) {
+                sub ["size"] = channel.snapshot.size ();
+                sub ["updates"] = channel.updates;
+            }
+            if (channel.reads)
+                sub ["reads"] = channel.reads;
+            if (channel.oversized)
+                sub ["oversized"] = channel.oversized;
+        }
+        if (payloadExceeded ()) {
+            JsonObject exceeded = obj ["payloadExceeded"].to<JsonObject> ();
+            if (_senderData._payloadExceeded)
+                exceeded ["data"] = _senderData._payloadExceeded;
+            if (_senderDiag._payloadExceeded)
+                exceeded ["diag"] = _senderDiag._payloadExceeded;
+            if (_senderAlarms._payloadExceeded)
+                exceeded ["alarms"] = _senderAlarms._payloadExceeded;
         }
-        if (_connectionSender._payloadExceeded)
-            obj ["payloadExceeded"] = _connectionSender._payloadExceeded;
         if (_connectionReceiver._failures)
             obj ["receiveFailures"] = _connectionReceiver._failures;
         if (_connections)
@@ -312,6 +734,9 @@ private:
     static String _address_to_string (const esp_bd_addr_t bleaddr) {
         return BytesToHexString<6> (bleaddr);
     }
+    static String _phy_to_string (const uint8_t phy) {
+        return phy == 2 ? "2M" : (phy == 3 ? "coded" : "1M");
+    }
     static String _linkrole_to_string (const int linkrole) {
         return linkrole == 0 ? "master" : "slave";
     }
@@ -31,6 +31,7 @@ private:
     WiFiClient _wifiClient;
     PubSubClient _mqttClient;
     ActivationTrackerWithDetail _bufferExceeded;
+    counter_t _connections = 0;
 
     bool connect () {
         const Peer peer = _peers.select ();
@@ -38,6 +39,8 @@ private:
         const bool result = _mqttClient.connect (config.client.c_str (), peer.user.c_str (), peer.pass.c_str ());
         DEBUG_PRINTF ("MQTTPublisher::connect: host=%s, port=%u, client=%s, user=%s, pass=%s, bufferSize=%u, result=%d\n", peer.name.c_str (), peer.port, config.client.c_str (), peer.user.c_str (), peer.pass.c_str (), config.bufferSize, result);
         _peers.update (result);
+        if (result)
+            _connections++;
         return result;
     }
 
@@ -72,6 +75,9 @@ public:
     inline bool available () {
         return _mqttClient.connected ();
     }
+    counter_t session () const {    // changes with each connection
+        return _connections;
+    }
     __implementation_t &__implementation () {
         return _mqttClient;
     }
@@ -86,6 +92,16 @@ public:
         DEBUG_PRINTF ("MQTTPublisher::publish: length=%u, result=%d\n", data.length (), result);
         return result;
     }
+    bool publish (const String &topic, const uint8_t *data, const size_t size) {    // binary
+        if (size > config.bufferSize) {
+            _bufferExceeded += ArithmeticToString (size);
+            DEBUG_PRINTF ("MQTTPublisher::publish: failed, length %u would exceed buffer size %u\n", size, config.bufferSize);
+            return false;
+        }
+        const bool result = _mqttClient.publish (topic.c_str (), data, size);
+        DEBUG_PRINTF ("MQTTPublisher::publish: length=%u (binary), result=%d\n", size, result);
+        return result;
+    }
     void publish__native (const char *topic, const char *data) {    // no logging, silent dropping
         if (_mqttClient.connected ())
             _mqttClient.publish (topic, data);
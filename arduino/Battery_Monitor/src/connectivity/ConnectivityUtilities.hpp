@@ -4,6 +4,7 @@
 
 #include <map>
 #include <memory>
+#include <utility>
 
 template <typename C>
 class ConnectionReceiver {
@@ -25,11 +26,14 @@ public:
         }
     };
 
+    using Source = uint32_t;    // which of the device's peers it came from, if it has more than one
+
 private:
-    using Queue = QueueSimpleConcurrentSafe<String>;
+    using Queue = QueueSimpleConcurrentSafe<std::pair<Source, String>>;
     C *const _c;
     Queue _queue;
     Handlers _handlers;
+    Source _source = 0;
 
     void processJson (const String &str) {
         JsonDocument doc;
@@ -59,12 +63,17 @@ public:
         _handlers.insert (handlers.begin (), handlers.end ());
         return *this;
     }
-    void insert (const String &str) {
-        _queue.push (str);
+    void insert (const String &str, const Source source = 0) {
+        _queue.push (std::make_pair (source, str));
+    }
+    Source source () const {    // of the one being processed, for the handlers
+        return _source;
     }
     void process () {
-        String str;
-        while (_queue.pull (str)) {
+        std::pair<Source, String> item;
+        while (_queue.pull (item)) {
+            _source = item.first;
+            const String &str = item.second;
             DEBUG_PRINTF ("Receiver::process: content=<<<%s>>>\n", str.c_str ());
             if (str.startsWith ("{\"type\""))
                 processJson (str);
@@ -79,32 +88,153 @@ public:
 
 // -----------------------------------------------------------------------------------------------
 
+// a frame larger than the link's payload goes as chunks of [ MARKER, frame, index, total ] followed by the next
+// (payload - HEADER) bytes of it, serialised straight into one fixed buffer and emitted each time that fills; the
+// marker cannot start a json ('{') or MessagePack (0x8n, 0xde) frame, so frames that fit still go bare
+
+class ConnectionChunker : public Print {
+public:
+    static inline constexpr uint8_t MARKER = 0x1E;    // ascii record separator
+    static inline constexpr size_t HEADER = 4, CHUNKS_MAX = 255;
+    using Function = std::function<void (const uint8_t *, const size_t)>;
+
+private:
+    const Function &_func;
+    uint8_t *const _buffer;
+    const size_t _size;
+    size_t _used = HEADER;
+
+    void emit () {
+        _func (_buffer, _used);
+        _buffer [2]++;
+        _used = HEADER;
+    }
+
+public:
+    static size_t chunks (const size_t length, const size_t size) {
+        return (length + (size - HEADER) - 1) / (size - HEADER);
+    }
+    explicit ConnectionChunker (const Function &func, uint8_t *buffer, const size_t size, const uint8_t frame, const size_t length) :
+        _func (func),
+        _buffer (buffer),
+        _size (size) {
+        _buffer [0] = MARKER, _buffer [1] = frame, _buffer [2] = 0, _buffer [3] = static_cast<uint8_t> (chunks (length, size));
+    }
+    size_t write (const uint8_t c) override {
+        _buffer [_used++] = c;
+        if (_used == _size)
+            emit ();
+        return 1;
+    }
+    size_t write (const uint8_t *data, const size_t length) override {
+        for (size_t offset = 0; offset < length;) {
+            const size_t count = std::min (length - offset, _size - _used);
+            memcpy (_buffer + _used, data + offset, count);
+            _used += count, offset += count;
+            if (_used == _size)
+                emit ();
+        }
+        return length;
+    }
+    size_t finish () {    // chunks emitted
+        if (_used > HEADER)
+            emit ();
+        return _buffer [2];
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
 template <typename C>
 class ConnectionSender {
-    using Function = std::function<void (const String &)>;
+public:
+    static inline constexpr size_t PAYLOAD_MAX = 512;    // ATT maximum, as ESP_GATT_MAX_ATTR_LEN
+    using Function = ConnectionChunker::Function;
+    using Admit = std::function<bool (const size_t)>;    // room for a frame of this many parts, or drop it whole
+
+private:
     const Function _func;
+    const Admit _admit;
+    uint8_t _buffer [PAYLOAD_MAX];
+    uint8_t _frame = 0;
+
+    bool admit (const size_t parts) const {
+        return ! _admit || _admit (parts);
+    }
+    bool chunked (const size_t length, const size_t maxPayloadSize, const std::function<void (Print &)> &writer) {
+        if (maxPayloadSize <= ConnectionChunker::HEADER || maxPayloadSize > PAYLOAD_MAX || ConnectionChunker::chunks (length, maxPayloadSize) > ConnectionChunker::CHUNKS_MAX) {
+            _payloadExceeded += ArithmeticToString (length);
+            return false;
+        }
+        if (! admit (ConnectionChunker::chunks (length, maxPayloadSize)))
+            return false;
+        ConnectionChunker chunker (_func, _buffer, maxPayloadSize, _frame++, length);
+        writer (chunker);
+        const size_t chunks = chunker.finish ();
+        DEBUG_PRINTF ("Sender::send: length=%u, chunks=%u, payload=%u\n", length, chunks, maxPayloadSize);
+        return true;
+    }
 
 public:
     ActivationTrackerWithDetail _payloadExceeded;
-    explicit ConnectionSender (Function func) :
-        _func (func) { }
+    explicit ConnectionSender (Function func, Admit admit = nullptr) :
+        _func (func),
+        _admit (admit) { }
+    bool send (const uint8_t *data, const size_t length, const int maxPayloadSize = -1) {
+        if (maxPayloadSize == -1 || length <= maxPayloadSize) {
+            if (! admit (1))
+                return false;
+            _func (data, length);
+            DEBUG_PRINTF ("Sender::send: length=%u\n", length);
+            return true;
+        }
+        return chunked (length, maxPayloadSize, [&] (Print &print) {
+            print.write (data, length);
+        });
+    }
     bool send (const String &data, const int maxPayloadSize = -1) {
-        bool result = true;
-        if (maxPayloadSize == -1 || data.length () <= maxPayloadSize) {
-            _func (data);
-            DEBUG_PRINTF ("Sender::send: length=%u\n", data.length ());
-        } else {
-            JsonSplitter splitter (maxPayloadSize, { "type", "time", "addr" });
-            splitter.splitJson (data, [&] (const String &part, const int elements) {
-                const size_t length = part.length ();
-                _func (part);
-                DEBUG_PRINTF ("Sender::send: data=%u, part=%u, elements=%d\n", data.length (), length, elements);
-                if (length > maxPayloadSize)
-                    _payloadExceeded += ArithmeticToString (length), result = false;
-                delay (20);
-            });
+        return send (reinterpret_cast<const uint8_t *> (data.c_str ()), data.length (), maxPayloadSize);
+    }
+    bool send (const JsonDocument &doc, const JsonEncoding encoding, const size_t maxPayloadSize) {    // serialised into the buffer, whole or in chunks
+        const size_t length = encoding == JsonEncoding::MsgPack ? measureMsgPack (doc) : measureJson (doc);
+        if (length <= maxPayloadSize && length < PAYLOAD_MAX) {    // room for the terminator that serializeJson adds
+            if (! admit (1))
+                return false;
+            _func (_buffer, encoding == JsonEncoding::MsgPack ? serializeMsgPack (doc, _buffer, sizeof (_buffer)) : serializeJson (doc, reinterpret_cast<char *> (_buffer), sizeof (_buffer)));
+            DEBUG_PRINTF ("Sender::send: length=%u\n", length);
+            return true;
         }
-        return result;
+        return chunked (length, maxPayloadSize, [&] (Print &print) {
+            if (encoding == JsonEncoding::MsgPack)
+                serializeMsgPack (doc, print);
+            else
+                serializeJson (doc, print);
+        });
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// the "data" deltas over a connection: the session changes with each connection, so they restart with a keyframe that
+// the newcomer can use, and a peer that lost track of them asks for a keyframe
+class ConnectionSession {
+    const ActivationTracker &_connections;
+    bool _resynchronise = false;
+
+public:
+    explicit ConnectionSession (const ActivationTracker &connections) :
+        _connections (connections) { }
+    counter_t session () const {
+        return _connections.count ();
+    }
+    void resynchronise () {
+        _resynchronise = true;
+    }
+    bool resynchroniseRequested () {
+        const bool requested = _resynchronise;
+        _resynchronise = false;
+        return requested;
     }
 };
 
@@ -5,12 +5,24 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 
-class WebSocket : private Singleton<WebSocket>, public ConnectionReceiver<WebSocket>::Insertable, public JsonSerializable {
+#include <map>
+#include <mutex>
+#include <vector>
+
+// any number of clients, each frame serialised once per encoding into a buffer the clients share (the library
+// counts its references, and frees it when the last has sent it); a client whose queue is full is skipped, and
+// one skipped for too many frames in a row is closed, rather than let it hold the memory; the clients come and
+// go from the async task, and are sent to from the main loop
+
+class WebSocket : private Singleton<WebSocket>, public ConnectionReceiver<WebSocket>::Insertable, public ConnectionSession, public JsonSerializable {
 public:
     typedef struct {
         bool enabled;
         uint16_t port;
         String root;
+        size_t clients;          // at most, the oldest are closed beyond
+        size_t queueLimit;       // messages waiting for a client, beyond which it is skipped
+        counter_t evictAfter;    // frames skipped in a row, before the client is closed
     } Config;
 
 private:
@@ -22,7 +34,7 @@ private:
             _connected (client);
         } else if (type == WS_EVT_DISCONNECT) {
             DEBUG_PRINTF ("WebSocket[%u]::events: DISCONNECT\n", client->id ());
-            _disconnected ();
+            _disconnected (client->id ());
         } else if (type == WS_EVT_ERROR) {
             DEBUG_PRINTF ("WebSocket[%u]::events: ERROR: (%u) %s\n", client->id (), *reinterpret_cast<const uint16_t *> (arg), reinterpret_cast<const char *> (data));
             _connected_error (reinterpret_cast<const char *> (data));
@@ -32,8 +44,7 @@ private:
             const AwsFrameInfo *info = reinterpret_cast<const AwsFrameInfo *> (arg);
             if (info->opcode == WS_TEXT && info->final && info->index == 0 && info->len == len) {
                 DEBUG_PRINTF ("WebSocket[%u]::events: message [%lu]: %.*s\n", client->id (), len, len, reinterpret_cast<const char *> (data));
-                _connected_writeReceived (String (data, len));
-                // client->text ("I got your text message");
+                _connected_writeReceived (client->id (), String (data, len));
             }
         }
     }
@@ -51,56 +62,90 @@ private:
     AsyncWebSocket _socket;
     Initialisable _started;
 
+    using Buffer = AsyncWebSocketSharedBuffer;    // what an AsyncWebSocketMessageBuffer holds, but one of those goes to one client only
+    struct Client {
+        String address;
+        JsonEncoding encoding = JsonEncoding::Text;
+        interval_t since = 0;
+        counter_t sent = 0, dropped = 0, skipped = 0;    // skipped: in a row
+        uint64_t bytes = 0;
+    };
+    std::map<uint32_t, Client> _clients;    // by id
+    mutable std::mutex _mutex;
+
     ConnectionReceiver<WebSocket> _connectionReceiver;
-    ConnectionSender<WebSocket> _connectionSender;
-    ActivationTracker _connections, _disconnections;
+    ActivationTracker _connections, _disconnections, _evictions;
     ActivationTrackerWithDetail _errors;
-    bool _connectionActive = false;
-    AsyncWebSocketClient *_connectionClient = nullptr;
 
     void _connected (AsyncWebSocketClient *client) {
-        _disconnect ();    // only one connection
-        if (! _connectionActive) {
-            _connectionClient = client;
-            _connections++;
-            _connectionActive = true;
-        }
+        std::lock_guard<std::mutex> guard (_mutex);
+        Client &connected = _clients [client->id ()];
+        connected.address = client->remoteIP ().toString ();
+        connected.since = millis ();
+        _connections++;
     }
     void _connected_error (const String &error) {
-        if (_connectionActive) {
-            _errors += error;
-        }
+        _errors += error;
     }
-    bool _connected_send (const String &data) {
-        if (_connectionActive) {
-            return _connectionSender.send (data);
-        } else {
-            DEBUG_PRINTF ("WebSocket::send: not connected");
-            return false;
-        }
+    void _connected_writeReceived (const uint32_t id, const String &str) {
+        _connectionReceiver.insert (str, id);
     }
-    void _connected_writeReceived (const String &str) {
-        if (_connectionActive) {
-            _connectionReceiver.insert (str);
+    bool _connected_broadcast (const std::function<Buffer ()> &text, const std::function<Buffer ()> &binary) {    // each built on first use
+        std::vector<std::pair<uint32_t, JsonEncoding>> targets;
+        {
+            std::lock_guard<std::mutex> guard (_mutex);
+            for (const auto &[id, client] : _clients)
+                targets.push_back (std::make_pair (id, client.encoding));
         }
-    }
-    void _disconnect () {
-        if (_connectionActive) {
-            _connectionActive = false;
-            _disconnections++;
-            if (_connectionClient) {
-                _connectionClient->close ();
-                _connectionClient = nullptr;
+        Buffer textBuffer, binaryBuffer;
+        size_t queued = 0;
+        for (const auto &[id, encoding] : targets) {
+            AsyncWebSocketClient *client = _socket.client (id);    // not held, the library frees them
+            if (client == nullptr)
+                continue;
+            Buffer buffer;
+            bool sent = false;
+            if (client->queueLen () < config.queueLimit && ! client->queueIsFull ()) {
+                if (encoding == JsonEncoding::MsgPack && binary) {
+                    buffer = binaryBuffer ? binaryBuffer : (binaryBuffer = binary ());
+                    sent = client->binary (buffer);
+                } else {
+                    buffer = textBuffer ? textBuffer : (textBuffer = text ());
+                    sent = client->text (buffer);
+                }
+            }
+            bool evict = false;
+            {
+                std::lock_guard<std::mutex> guard (_mutex);
+                const auto it = _clients.find (id);
+                if (it == _clients.end ())
+                    continue;
+                if (sent)
+                    it->second.sent++, it->second.bytes += buffer->size (), it->second.skipped = 0, queued++;
+                else
+                    it->second.dropped++, evict = (++it->second.skipped == config.evictAfter);
+            }
+            if (evict) {
+                DEBUG_PRINTF ("WebSocket[%u]::send: client too slow, closing\n", id);
+                client->close ();
+                _evictions++;
             }
-            _connectionReceiver.drain ();
         }
+        return queued > 0;
     }
-    void _disconnected () {
-        if (_connectionActive) {
-            _connectionActive = false;
+    bool _connected_send (const String &data) {
+        return _connected_broadcast ([&] () { return _buffer (reinterpret_cast<const uint8_t *> (data.c_str ()), data.length ()); }, nullptr);
+    }
+    bool _connected_send (const JsonCollector &frame) {
+        return _connected_broadcast ([&] () { return _buffer (reinterpret_cast<const uint8_t *> (frame.text ().c_str ()), frame.text ().length ()); },
+                                     [&] () { return _buffer (frame.packed ().data (), frame.packed ().size ()); });
+    }
+    void _disconnected (const uint32_t id) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_clients.erase (id) > 0) {
             _disconnections++;
-            _connectionClient = nullptr;
-            _connectionReceiver.drain ();
+            if (_clients.empty ())
+                _connectionReceiver.drain ();
         }
     }
     void _connection_init () {
@@ -110,23 +155,23 @@ private:
         DEBUG_PRINTF ("WebSocket::start: active, port=%u, root=%s\n", config.port, config.root.c_str ());
     }
     void _connection_process () {
-        if (_connectionActive) {
-            _connectionReceiver.process ();
-        }
+        _socket.cleanupClients (config.clients);    // also frees the ones gone
+        _connectionReceiver.process ();
+    }
+
+    static Buffer _buffer (const uint8_t *data, const size_t size) {
+        return std::make_shared<std::vector<uint8_t>> (data, data + size);
     }
 
 public:
     explicit WebSocket (const Config &cfg) :
         Singleton<WebSocket> (this),
         ConnectionReceiver<WebSocket>::Insertable (&_connectionReceiver),
+        ConnectionSession (_connections),    // a keyframe asked for by one peer goes to them all
         config (cfg),
         _server (config.port),
         _socket (config.root),
-        _connectionReceiver (this),
-        _connectionSender ([&] (const String &str) {
-            if (_connectionClient)
-                _connectionClient->text (str);    // XXX a bit worried about this
-        }) { }
+        _connectionReceiver (this) { }
 
     void begin () {
     }
@@ -136,18 +181,49 @@ public:
         _connection_process ();
     }
     bool available () const {
-        return _connectionActive;
+        std::lock_guard<std::mutex> guard (_mutex);
+        return ! _clients.empty ();
     }
     //
     // json only
     bool send (const String &data) {
         return _connected_send (data);
     }
+    bool send (const JsonCollector &frame) {
+        return _connected_send (frame);
+    }
+    void encoding (const JsonEncoding encoding) {    // negotiated by the peer whose message is being processed, for its connection
+        std::lock_guard<std::mutex> guard (_mutex);
+        const auto it = _clients.find (_connectionReceiver.source ());
+        if (it != _clients.end ())
+            it->second.encoding = encoding;
+    }
+    JsonEncoding encoding () const {    // MsgPack only if all of them are
+        std::lock_guard<std::mutex> guard (_mutex);
+        for (const auto &[id, client] : _clients)
+            if (client.encoding != JsonEncoding::MsgPack)
+                return JsonEncoding::Text;
+        return _clients.empty () ? JsonEncoding::Text : JsonEncoding::MsgPack;
+    }
     //
     void serialize (JsonVariant &obj) const override {
-        if ((obj ["connected"] = _connectionActive)) {
-            obj ["address"] = _connectionClient->remoteIP ();
+        std::lock_guard<std::mutex> guard (_mutex);
+        if ((obj ["connected"] = _clients.size ())) {
+            JsonArray clients = obj ["clients"].to<JsonArray> ();
+            for (const auto &[id, client] : _clients) {
+                JsonObject sub = clients.add<JsonObject> ();
+                sub ["id"] = id;
+                sub ["address"] = client.address;
+                sub ["format"] = JsonEncodingToString (client.encoding);
+                sub ["time"] = (millis () - client.since) / 1000;
+                sub ["sent"] = client.sent;
+                sub ["bytes"] = client.bytes;
+                if (client.dropped)
+                    sub ["dropped"] = client.dropped;
+            }
         }
+        if (_evictions)
+            obj ["evictions"] = _evictions;
         if (_connectionReceiver._failures)
             obj ["receiveFailures"] = _connectionReceiver._failures;
         if (_errors)
@@ -38,6 +38,19 @@ private:
         bool process (WebSocket &device, const String &time, JsonDocument &doc) override {
             String content = doc ["info"] | "(not provided)";
             DEBUG_PRINTF ("WebSocketReceiver_TypeInfo:: type=info, time=%s, info='%s'\n", time.c_str (), content.c_str ());
+            device.encoding (JsonEncodingFromString (doc ["format"]));    // what the peer can decode, text if not said
+            return true;
+        }
+    };
+    class WebSocketReceiver_TypeCtrl : public ConnectionReceiver_TypeSpecific<WebSocket> {
+    public:
+        WebSocketReceiver_TypeCtrl () :
+            ConnectionReceiver_TypeSpecific<WebSocket> ("ctrl") {};
+        bool process (WebSocket &device, const String &time, JsonDocument &doc) override {
+            String content = doc ["ctrl"] | "(not provided)";
+            DEBUG_PRINTF ("WebSocketReceiver_TypeCtrl:: type=ctrl, time=%s, ctrl='%s'\n", time.c_str (), content.c_str ());
+            if (content == "keyframe")
+                device.resynchronise ();
             return true;
         }
     };
@@ -49,6 +62,7 @@ private:
         bool process (BluetoothServer &device, const String &time, JsonDocument &doc) override {
             String content = doc ["info"] | "(not provided)";
             DEBUG_PRINTF ("BluetoothReceiver_TypeInfo:: type=info, time=%s, info='%s'\n", time.c_str (), content.c_str ());
+            device.encoding (JsonEncodingFromString (doc ["format"]));    // what the peer can decode, text if not said
             return true;
         }
     };
@@ -59,6 +73,10 @@ private:
         bool process (BluetoothServer &device, const String &time, JsonDocument &doc) override {
             String content = doc ["ctrl"] | "(not provided)";
             DEBUG_PRINTF ("BluetoothReceiver_TypeCtrl:: type=ctrl, time=%s, ctrl='%s'\n", time.c_str (), content.c_str ());
+            if (content == "keyframe")    // peer lost track of the deltas
+                device.resynchronise ();
+            else if (content == "diag")    // collected afresh, on its own characteristic
+                device.request (BluetoothServer::Characteristic::Diag);
             // XXX
             // request controllables
             // process controllables
@@ -90,6 +108,7 @@ public:
             { String ("info"), std::make_shared<BluetoothReceiver_TypeInfo> () }
         });
         _components.websocket ().insertReceivers ({
+            { String ("ctrl"), std::make_shared<WebSocketReceiver_TypeCtrl> () },
             { String ("info"), std::make_shared<WebSocketReceiver_TypeInfo> () }
         });
 
@@ -6,9 +6,15 @@
 
 class ProgramDataDeliver : public Component, public Alarmable, public Diagnosticable {
 public:
+    typedef struct {
+        interval_t interval;    // msec, between "data" frames
+        JsonProfile::Config profile;
+    } Sink;
     typedef struct {
         String topic;
         counter_t failureLimit;
+        JsonDelta::Config delta;    // "data" to the bluetooth and websocket peers
+        Sink blue, webs, mqtt;      // "data" to each at its own rate and profile, mqtt only when neither peer is there and it is not publishing
     } Config;
 
 private:
@@ -20,6 +26,27 @@ private:
     WebSocket &_webs;
     ActivationTrackerWithDetail _delivers;
     ActivationTracker _failures;
+    String _alarms;
+    counter_t _sessionAlarms = 0;
+
+    // one sink's "data": what it gets of the frame, its deltas, and when it is due
+    struct Feed {
+        const Sink &sink;
+        JsonProfile profile;
+        JsonDelta delta;
+        counter_t session = 0;
+        interval_t last = 0;
+        explicit Feed (const Sink &s, const JsonDelta::Config &d) :
+            sink (s),
+            profile (s.profile),
+            delta (d) { }
+        bool due () const {
+            return last == 0 || (millis () - last) >= sink.interval;
+        }
+    } _feedBlue, _feedWebs, _feedMqtt;
+    bool fallbackToMqtt (const bool willPublishToMqtt) {
+        return ! _blue.available () && ! _webs.available () && ! willPublishToMqtt && _mqtt.available ();
+    }
 
 public:
     explicit ProgramDataDeliver (const Config &cfg, const String &id, BluetoothServer &blue, MQTTClient &mqtt, WebSocket &webs) :
@@ -29,21 +56,91 @@ public:
         _id (id),
         _blue (blue),
         _mqtt (mqtt),
-        _webs (webs) { }
+        _webs (webs),
+        _feedBlue (config.blue, config.delta),
+        _feedWebs (config.webs, config.delta),
+        _feedMqtt (config.mqtt, config.delta) { }
 
     bool available () {
         return _blue.available () || _webs.available () || _mqtt.available ();
     }
+    bool availablePushed () {    // for other than "data", which bluetooth gets on request
+        return _webs.available () || _mqtt.available ();
+    }
+    bool due (const bool willPublishToMqtt) {    // a "data" frame, for a sink that is there
+        return (_blue.available () && _feedBlue.due ()) || (_webs.available () && _feedWebs.due ()) || (fallbackToMqtt (willPublishToMqtt) && _feedMqtt.due ());
+    }
     //
-    bool deliver (const String &data, const String &type, bool willPublishToMqtt) {
-        if ((_blue.available () && _blue.send (data)) || (_webs.available () && _webs.send (data)) || (willPublishToMqtt || (_mqtt.available () && _mqtt.publish (config.topic + "/" + _id + "/" + type, data)))) {
-            _delivers += ArithmeticToString (data.length ());
-            _failures = 0;
-            return true;
-        } else
+    bool deliver (const JsonCollector &frame, const String &type, bool willPublishToMqtt) {
+        if (type == "data")
+            return deliverData (frame, willPublishToMqtt);
+        if (_webs.available () && _webs.send (frame))
+            return delivered (frame.size (_webs.encoding ()));
+        if (willPublishToMqtt || (_mqtt.available () && _mqtt.publish (config.topic + "/" + _id + "/" + type, frame.text ())))
+            return delivered (frame.text ().length ());
+        if (availablePushed ())    // bluetooth alone isn't a failure, it gets "diag" on request by diagnostics ()
             _failures++;
         return false;
     }
+    void alarms (const String &alarms, const std::function<JsonCollector ()> &collect) {    // bluetooth only, when they change
+        if (! _blue.available () || (alarms == _alarms && _sessionAlarms == _blue.session ()))
+            return;
+        _alarms = alarms;
+        _sessionAlarms = _blue.session ();
+        _blue.snapshot (BluetoothServer::Characteristic::Alarms, collect ());
+        _blue.notify (BluetoothServer::Characteristic::Alarms);
+    }
+    void diagnostics (const std::function<JsonCollector ()> &collect) {    // bluetooth only, when the peer asks
+        if (! _blue.available () || ! _blue.requested (BluetoothServer::Characteristic::Diag))
+            return;
+        _blue.snapshot (BluetoothServer::Characteristic::Diag, collect ());
+        _blue.notify (BluetoothServer::Characteristic::Diag);
+    }
+
+private:
+    bool deliverData (const JsonCollector &frame, const bool willPublishToMqtt) {
+        bool attempted = false, sent = false;
+        if (_blue.available () && _feedBlue.due ()) {
+            _blue.snapshot (BluetoothServer::Characteristic::Data, frame);    // reads get all of it
+            if (_blue.subscribed (BluetoothServer::Characteristic::Data))    // a peer may only want alarms or diag
+                attempted = true, sent |= deliver (_blue, frame, _feedBlue);
+            else
+                _feedBlue.last = millis ();
+        }
+        if (_webs.available () && _feedWebs.due ())
+            attempted = true, sent |= deliver (_webs, frame, _feedWebs);
+        if (fallbackToMqtt (willPublishToMqtt) && _feedMqtt.due ()) {
+            _feedMqtt.last = millis ();
+            const JsonCollector profiled (_feedMqtt.profile.apply (frame.document ()));
+            attempted = true, sent |= _mqtt.publish (config.topic + "/" + _id + "/data", profiled.text ()) && delivered (profiled.text ().length ());
+        }
+        if (attempted && ! sent)
+            _failures++;
+        return sent;
+    }
+    template <typename Peer>
+    bool deliver (Peer &peer, const JsonCollector &frame, Feed &feed) {
+        feed.last = millis ();
+        JsonDocument profiled = feed.profile.apply (frame.document ());
+        if (! config.delta.enabled) {
+            const JsonCollector whole (std::move (profiled));
+            return peer.send (whole) && delivered (whole.size (peer.encoding ()));
+        }
+        if (feed.session != peer.session ())
+            feed.session = peer.session (), feed.delta.reset ();
+        if (peer.resynchroniseRequested ())
+            feed.delta.request ();
+        const JsonCollector encoded (feed.delta.encode (profiled));
+        if (! peer.send (encoded))
+            return false;
+        feed.delta.commit ();
+        return delivered (encoded.size (peer.encoding ()));
+    }
+    bool delivered (const size_t size) {
+        _delivers += ArithmeticToString (size);
+        _failures = 0;
+        return true;
+    }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
@@ -55,6 +152,17 @@ protected:
             JsonObject failures = sub ["failures"].as<JsonObject> ();
             failures ["limit"] = config.failureLimit;
         }
+        JsonObject feeds = sub ["feeds"].to<JsonObject> ();
+        const auto collect = [&] (const char *name, const Feed &feed, const bool deltas) {
+            JsonObject obj = feeds [name].to<JsonObject> ();
+            obj ["interval"] = feed.sink.interval;
+            obj ["profile"] = feed.profile;
+            if (deltas && config.delta.enabled)
+                obj ["delta"] = feed.delta;
+        };
+        collect ("blue", _feedBlue, true);
+        collect ("webs", _feedWebs, true);
+        collect ("mqtt", _feedMqtt, false);
     }
 };
 
@@ -66,6 +174,9 @@ public:
     typedef struct {
         String topic;
         counter_t failureLimit;
+        JsonEncoding encoding;          // binary goes to <topic>/<id>/<type>/msgpack
+        JsonDelta::Config delta;        // "data" only, to <topic>/<id>/data/delta in place of whole frames to <topic>/<id>/data; subscribers wait for the next keyframe
+        JsonProfile::Config profile;    // "data" only, at the capture interval
     } Config;
 
     using BooleanFunc = std::function<bool ()>;
@@ -77,6 +188,22 @@ private:
     MQTTClient &_mqtt;
     ActivationTrackerWithDetail _publishes;
     ActivationTracker _failures;
+    JsonDelta _delta;
+    JsonProfile _profile;
+    counter_t _session = 0;
+
+    bool publishFrame (const JsonCollector &frame, const String &type) {
+        if (config.encoding != JsonEncoding::MsgPack)
+            return publish (frame.text (), type);
+        const std::vector<uint8_t> &packed = frame.packed ();
+        if (_mqtt.publish (config.topic + "/" + _id + "/" + type + "/msgpack", packed.data (), packed.size ())) {
+            _publishes += ArithmeticToString (packed.size ());
+            _failures = 0;
+            return true;
+        } else
+            _failures++;
+        return false;
+    }
 
 public:
     explicit ProgramDataPublish (const Config &cfg, const String &id, MQTTClient &mqtt) :
@@ -84,7 +211,9 @@ public:
                      AlarmCondition (ALARM_PUBLISH_SIZE, [this] () { return _mqtt.bufferExceeded (); }) }),
         config (cfg),
         _id (id),
-        _mqtt (mqtt) { }
+        _mqtt (mqtt),
+        _delta (config.delta),
+        _profile (config.profile) { }
 
     bool available () {
         return _mqtt.available ();
@@ -99,10 +228,25 @@ public:
             _failures++;
         return false;
     }
+    bool publish (const JsonCollector &frame, const String &type) {
+        if (type != "data")
+            return publishFrame (frame, type);
+        JsonDocument profiled = _profile.apply (frame.document ());
+        if (! config.delta.enabled)
+            return publishFrame (JsonCollector (std::move (profiled)), type);
+        if (_session != _mqtt.session ())
+            _session = _mqtt.session (), _delta.reset ();
+        const JsonCollector encoded (_delta.encode (profiled));
+        if (! publishFrame (encoded, type + "/delta"))    // apart, so that subscribers to whole frames never see a delta
+            return false;
+        _delta.commit ();
+        return true;
+    }
 
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
         JsonObject sub = obj ["publish"].to<JsonObject> ();
+        sub ["format"] = JsonEncodingToString (config.encoding);
         if (_publishes)
             sub ["publishes"] = _publishes;
         if (_failures) {
@@ -110,6 +254,9 @@ protected:
             JsonObject failures = sub ["failures"].as<JsonObject> ();
             failures ["limit"] = config.failureLimit;
         }
+        sub ["profile"] = _profile;
+        if (config.delta.enabled)
+            sub ["delta"] = _delta;
     }
 };
 
@@ -0,0 +1,68 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// measures the [motor][probe] weights for the zones strategy: with the pack warm (under load, or charging), runs each fan
+// alone and takes each probe's fall against the fall with all of them off, normalised per fan; saved only if every fan
+// cooled something, and used by the strategy from the next boot in place of the configured weights
+
+void factory_fanZonesCalibration () {
+    static constexpr interval_t SETTLE = 10 * 60 * 1000, RUN = 10 * 60 * 1000, SWEEP = 5 * 1000;
+    static constexpr float COOLING_MINIMUM = 0.2f;    // degrees, for a fan to count as cooling anything
+    using Weights = ProgramInterfaceFanControllersStrategy_motorZones::ZoneWeights;
+    using Temperatures = ProgramManageTemperatureSensorsBatterypack::TemperatureArray;
+
+    const Config config;
+
+    ProgramManageTemperatureSensorsCalibration calibrator (config.moduleBatterypack.temperatureSensorsCalibrator);
+    ProgramInterfaceTemperatureSensors interface (config.moduleBatterypack.temperatureSensorsInterface, [&] (const int channel, const uint16_t resistance) {
+        return calibrator.calculateTemperature (channel, resistance);
+    });
+    ProgramManageTemperatureSensorsBatterypack temperatures (config.moduleBatterypack.temperatureSensorsManagerBatterypack, interface);
+    OpenSmart_QuadMotorDriver hardware (config.moduleBatterypack.fanControllersInterface.hardware);
+    calibrator.begin ();
+    interface.begin ();
+    hardware.setDirection (config.moduleBatterypack.fanControllersInterface.DIRECTION);
+
+    const auto wait = [&] (const interval_t period) {    // keeps the probe averages current
+        for (const interval_t started = millis (); (millis () - started) < period; delay (SWEEP))
+            temperatures.process ();
+        return temperatures.getTemperatures ();
+    };
+    const auto fall = [&] (const int motorId) {
+        hardware.setSpeed (0, OpenSmart_QuadMotorDriver::MOTOR_ALL);
+        const Temperatures before = wait (SETTLE);
+        if (motorId != OpenSmart_QuadMotorDriver::MOTOR_ALL)
+            hardware.setSpeed (config.moduleBatterypack.fanControllersInterface.MAX_SPEED, motorId);
+        const Temperatures after = wait (RUN);
+        hardware.setSpeed (0, OpenSmart_QuadMotorDriver::MOTOR_ALL);
+        Temperatures result;
+        for (size_t probe = 0; probe < result.size (); probe++)
+            result [probe] = before [probe] - after [probe];
+        return result;
+    };
+
+    DEBUG_PRINTF ("*** factory_fanZonesCalibration: settle=%lu, run=%lu (per fan, and once with none)\n", SETTLE, RUN);
+    const Temperatures drift = fall (OpenSmart_QuadMotorDriver::MOTOR_ALL);    // with none running
+    Weights weights;
+    bool valid = true;
+    for (int motorId = 0; motorId < OpenSmart_QuadMotorDriver::MotorCount; motorId++) {
+        const Temperatures cooled = fall (motorId);
+        float coolingMaximum = 0.0f;
+        for (size_t probe = 0; probe < cooled.size (); probe++)
+            coolingMaximum = std::max (coolingMaximum, weights [motorId][probe] = std::max (cooled [probe] - drift [probe], 0.0f));
+        DEBUG_PRINTF ("+++ motor %d: cooling=%.2f, weights=[", motorId, coolingMaximum);
+        for (size_t probe = 0; probe < cooled.size (); probe++)
+            DEBUG_PRINTF ("%s%.2f", probe > 0 ? "," : "", weights [motorId][probe] = coolingMaximum > 0.0f ? (weights [motorId][probe] / coolingMaximum) : 0.0f);
+        DEBUG_PRINTF ("]\n");
+        if (coolingMaximum < COOLING_MINIMUM)
+            valid = false;
+    }
+    if (! valid)
+        DEBUG_PRINTF ("*** factory_fanZonesCalibration: not saved, a fan cooled less than %.2f (is the pack warm?)\n", COOLING_MINIMUM);
+    else
+        DEBUG_PRINTF ("*** factory_fanZonesCalibration: %s\n", ProgramInterfaceFanControllersStrategy_motorZones::weightsSave (weights) ? "saved" : "not saved, persistent storage failed");
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -82,6 +82,7 @@ public:
 #include "program/ProgramDiagnostics.hpp"
 using ProgramAlarmsInterface = ActivablePIN;
 #include "program/ProgramAlarms.hpp"
+#include "program/ProgramTimeline.hpp"
 
 // -----------------------------------------------------------------------------------------------
 
@@ -89,6 +90,7 @@ using ProgramAlarmsInterface = ActivablePIN;
 #include "connectivity/ConnectivityMulticastDNSPublisher.hpp"
 #include "connectivity/ConnectivityWebSocket.hpp"
 #include "connectivity/ConnectivityWebServer.hpp"
+#include "connectivity/ConnectivityBluetoothRadio.hpp"
 #include "connectivity/ConnectivityBluetoothServer.hpp"
 #include "connectivity/ConnectivityMQTTClient.hpp"
 #include "connectivity/ConnectivityNetworkTimeFetcher.hpp"
@@ -99,6 +101,7 @@ using ProgramAlarmsInterface = ActivablePIN;
 class ModuleConnectivity : public Component, public Diagnosticable {
 public:
     typedef struct {
+        BluetoothRadio::Config radio;
         BluetoothServer::Config blue;
         MulticastDNSPublisher::Config mdns;
         MQTTClient::Config mqtt;
@@ -114,6 +117,7 @@ private:
     const Config &config;
     const BooleanFunc _networkIsAvailable;
 
+    BluetoothRadio _radio;
     BluetoothServer _blue;
     MulticastDNSPublisher _mdns;
     MQTTClient _mqtt;
@@ -125,7 +129,8 @@ public:
     explicit ModuleConnectivity (const Config &cfg, const BooleanFunc networkIsAvailable) :
         config (cfg),
         _networkIsAvailable (networkIsAvailable),
-        _blue (config.blue),
+        _radio (config.radio),
+        _blue (config.blue, _radio),
         _mdns (config.mdns),
         _mqtt (config.mqtt),
         _wifi (config.wifi, _mdns),
@@ -135,6 +140,7 @@ public:
     void begin () override {
         _wifi.begin ();
         _mdns.begin ();
+        _radio.begin ();
         _blue.begin ();
         _mqtt.begin ();
         _webserver.begin ();
@@ -142,6 +148,7 @@ public:
     }
     void process () override {
         _wifi.process ();
+        _radio.process ();
         _blue.process ();
         if (_networkIsAvailable ()) {
             _mdns.process ();
@@ -154,6 +161,9 @@ public:
     MulticastDNSPublisher &mdns () {
         return _mdns;
     }
+    BluetoothRadio &radio () {
+        return _radio;
+    }
     BluetoothServer &blue () {
         return _blue;
     }
@@ -173,6 +183,7 @@ public:
 protected:
     void collectDiagnostics (JsonVariant &obj) const override {
         JsonObject sub = obj ["components"].to<JsonObject> ();
+        sub ["radio"] = _radio;
         sub ["blue"] = _blue;
         sub ["mdns"] = _mdns;
         sub ["mqtt"] = _mqtt;
@@ -190,34 +201,72 @@ protected:
 #include "batterypack/BatterypackMechanicsTemperatureCalibration.hpp"
 #include "batterypack/BatterypackManageTemperatureCalibration.hpp"
 #include "batterypack/BatterypackManageFanControllers.hpp"
+#include "batterypack/BatterypackInterfaceSerialDalyBMS.hpp"
+#include "batterypack/BatterypackMechanicsChargeEstimation.hpp"
 #include "batterypack/BatterypackManageSerialDalyBMS.hpp"
+#include "batterypack/BatterypackMechanicsCellAnalytics.hpp"
+#include "batterypack/BatterypackManageCellAnalytics.hpp"
+#include "batterypack/BatterypackMechanicsResistanceEstimation.hpp"
+#include "batterypack/BatterypackManageInternalResistance.hpp"
+#include "batterypack/BatterypackMechanicsBalancingScheduler.hpp"
+#include "batterypack/BatterypackManageBalancing.hpp"
 
 static inline constexpr size_t HARDWARE_TEMP_SIZE = ProgramInterfaceTemperatureSensors::CHANNELS;
 static inline constexpr float HARDWARE_TEMP_START = 5.0f, HARDWARE_TEMP_END = 60.0f, HARDWARE_TEMP_STEP = 0.5f;
 using ProgramManageTemperatureSensorsBatterypack = ProgramManageTemperatureBatterypackTemplate<HARDWARE_TEMP_SIZE - 1>;
 using ProgramManageTemperatureSensorsEnvironment = ProgramManageTemperatureEnvironmentTemplate<1>;
 using ProgramManageTemperatureSensorsCalibration = ProgramManageTemperatureCalibrationTemplate<HARDWARE_TEMP_SIZE, HARDWARE_TEMP_START, HARDWARE_TEMP_END, HARDWARE_TEMP_STEP>;
+using ProgramInterfaceFanControllersStrategy_motorZones = ProgramInterfaceFanControllersStrategy_motorZonesTemplate<HARDWARE_TEMP_SIZE - 1>;
 
 class ModuleBatterypack : public Component, public Diagnosticable {
 public:
+    enum class FanStrategy {
+        MotorMapWithRotation,
+        MotorOptimal,
+        MotorZones
+    };
+    enum class FanControl {
+        Pid,
+        Mpc
+    };
+
     typedef struct {
         ProgramManageTemperatureSensorsCalibration::Config temperatureSensorsCalibrator;
         ProgramInterfaceTemperatureSensors::Config temperatureSensorsInterface;
         ProgramManageTemperatureSensorsBatterypack::Config temperatureSensorsManagerBatterypack;
         ProgramManageTemperatureSensorsEnvironment::Config temperatureSensorsManagerEnvironment;
         double FAN_CONTROL_P, FAN_CONTROL_I, FAN_CONTROL_D, FAN_SMOOTH_A;
+        FanControl FAN_CONTROL;
+        MpcController<double>::Config fanControllingMpc;
+        FanStrategy FAN_STRATEGY;
+        ProgramInterfaceFanControllersStrategy_motorZones::Config fanControllersStrategyZones;
         ProgramInterfaceFanControllers::Config fanControllersInterface;
         ProgramManageFanControllers::Config fanControllersManager;
         ProgramManageSerialDalyBMS::Config batteryManagerManager;
+        ProgramManageCellAnalytics::Config batteryCellAnalytics;
+        ProgramManageInternalResistance::Config batteryInternalResistance;
+        ProgramManageBalancing::Config batteryBalancing;
         TemperatureSensor_DS18B20::Config ds18b20;
         DiagnosticablesManager::Config moduleDiagnostics;
+        interval_t intervalProcess;    // sensor sweeps and fan control, slower than the program loop
     } Config;
 
 private:
     const Config &config;
 
-    ProgramInterfaceFanControllersStrategy_motorMapWithRotation fanInterfaceStrategy;
-    PidController<double> fanControllingAlgorithm;
+    ProgramTimeline &timeline;
+    interval_t timelineBattery = 0, timelineTemperatures = 0, timelineEnvironment = 0;
+    std::optional<FanSpeedType> timelineFan;
+
+    ProgramInterfaceFanControllersStrategy_motorMapWithRotation fanInterfaceStrategyRotation;
+    ProgramInterfaceFanControllersStrategy_motorOptimal fanInterfaceStrategyOptimal;
+    ProgramInterfaceFanControllersStrategy_motorZones fanInterfaceStrategyZones;
+    ProgramInterfaceFanControllersStrategy &fanInterfaceStrategy;
+    PidController<double> fanControllingPid;
+    MpcController<double> fanControllingMpc;
+    ProgramManageFanControllersAlgorithm_pid fanControllingAlgorithmPid;
+    ProgramManageFanControllersAlgorithm_mpc fanControllingAlgorithmMpc;
+    ProgramManageFanControllersAlgorithm &fanControllingAlgorithm;
     AlphaSmoothing<double> fanSmoothingAlgorithm;
     ProgramManageTemperatureSensorsCalibration temperatureSensorsCalibrator;
     ProgramInterfaceTemperatureSensors temperatureSensorsInterface;
@@ -226,8 +275,12 @@ private:
     ProgramManageTemperatureSensorsEnvironment temperatureSensorsManagerEnvironment;
     ProgramManageFanControllers fanControllersManager;
     ProgramManageSerialDalyBMS batteryManager;
+    ProgramManageCellAnalytics batteryCellAnalytics;
+    ProgramManageInternalResistance batteryInternalResistance;
+    ProgramManageBalancing batteryBalancing;
 
     DiagnosticablesManager moduleDiagnostics;
+    Intervalable moduleInterval;
     Component::List moduleComponents;
     template <auto MethodPtr>
     void forEachComponent () {
@@ -235,11 +288,44 @@ private:
             (component->*MethodPtr) ();
     }
 
+    ProgramInterfaceFanControllersStrategy &selectFanStrategy (const FanStrategy strategy) {
+        switch (strategy) {
+        case FanStrategy::MotorOptimal :
+            return fanInterfaceStrategyOptimal;
+        case FanStrategy::MotorZones :
+            return fanInterfaceStrategyZones;
+        case FanStrategy::MotorMapWithRotation :
+        default :
+            return fanInterfaceStrategyRotation;
+        }
+    }
+
+    ProgramManageFanControllersAlgorithm &selectFanControl (const FanControl control) {
+        switch (control) {
+        case FanControl::Mpc :
+            return fanControllingAlgorithmMpc;
+        case FanControl::Pid :
+        default :
+            return fanControllingAlgorithmPid;
+        }
+    }
+
 public:
-    explicit ModuleBatterypack (const Config &conf) :
+    ModuleBatterypack (const Config &conf, ProgramTimeline &timeline) :
         config (conf),
+        timeline (timeline),
         //
-        fanControllingAlgorithm (config.FAN_CONTROL_P, config.FAN_CONTROL_I, config.FAN_CONTROL_D),
+        fanInterfaceStrategyZones (config.fanControllersStrategyZones, [&] () {
+            return ProgramInterfaceFanControllersStrategy_motorZones::TemperaturesSet (temperatureSensorsManagerBatterypack.setpoint (), temperatureSensorsManagerBatterypack.getTemperatures ());
+        }),
+        fanInterfaceStrategy (selectFanStrategy (config.FAN_STRATEGY)),
+        fanControllingPid (config.FAN_CONTROL_P, config.FAN_CONTROL_I, config.FAN_CONTROL_D),
+        fanControllingMpc (config.fanControllingMpc),
+        fanControllingAlgorithmPid (fanControllingPid),
+        fanControllingAlgorithmMpc (fanControllingMpc, [&] () {
+            return static_cast<double> (temperatureSensorsManagerEnvironment.getTemperature ());
+        }),
+        fanControllingAlgorithm (selectFanControl (config.FAN_CONTROL)),
         fanSmoothingAlgorithm (config.FAN_SMOOTH_A),
         temperatureSensorsCalibrator (config.temperatureSensorsCalibrator),
         temperatureSensorsInterface (config.temperatureSensorsInterface, [&] (const int channel, const uint16_t resistance) {
@@ -252,9 +338,15 @@ public:
             return ProgramManageFanControllers::TargetSet (temperatureSensorsManagerBatterypack.setpoint (), temperatureSensorsManagerBatterypack.current ());
         }),
         batteryManager (config.batteryManagerManager),
+        batteryCellAnalytics (config.batteryCellAnalytics, batteryManager),
+        batteryInternalResistance (config.batteryInternalResistance, batteryManager),
+        batteryBalancing (config.batteryBalancing, batteryManager, batteryInternalResistance, [&] () {
+            return ProgramManageBalancing::Thermal { .temperature = temperatureSensorsManagerBatterypack.max (), .cool = temperatureSensorsManagerBatterypack.setpoint (), .warning = temperatureSensorsManagerBatterypack.warning (), .fans = fanControllersInterface.getSpeed () > 0 };
+        }),
         //        programAlarms (config.programAlarms, programAlarmsInterface, { &temperatureSensorsManagerEnvironment, &temperatureSensorsManagerBatterypack, &dataDeliver, &dataPublish, &dataStorage, &programTime, &programPlatform }), XXX
-        moduleDiagnostics (config.moduleDiagnostics, { &temperatureSensorsCalibrator, &temperatureSensorsInterface, &fanControllersInterface, &temperatureSensorsManagerBatterypack, &temperatureSensorsManagerEnvironment, &fanControllersManager, this }),
-        moduleComponents ({ &temperatureSensorsCalibrator, &temperatureSensorsInterface, &fanControllersInterface, &temperatureSensorsManagerBatterypack, &temperatureSensorsManagerEnvironment, &fanControllersManager, this }) {
+        moduleDiagnostics (config.moduleDiagnostics, { &temperatureSensorsCalibrator, &temperatureSensorsInterface, &fanControllersInterface, &temperatureSensorsManagerBatterypack, &temperatureSensorsManagerEnvironment, &fanControllersManager, &batteryManager, &batteryCellAnalytics, &batteryInternalResistance, &batteryBalancing, this }),
+        moduleInterval (config.intervalProcess),
+        moduleComponents ({ &temperatureSensorsCalibrator, &temperatureSensorsInterface, &fanControllersInterface, &temperatureSensorsManagerBatterypack, &temperatureSensorsManagerEnvironment, &fanControllersManager, &batteryManager, &batteryCellAnalytics, &batteryInternalResistance, &batteryBalancing }) {
     }
 
     // XXX for now, to connect alarms and program status reads
@@ -267,7 +359,37 @@ public:
         forEachComponent<&Component::begin> ();
     }
     void process () override {
-        forEachComponent<&Component::process> ();
+        if (moduleInterval) {
+            forEachComponent<&Component::process> ();
+            timelineUpdate ();
+        }
+    }
+
+private:
+    // at the time each value was measured, not when it is pushed
+    void timelineUpdate () {
+        const ProgramInterfaceSerialDalyBMS::Status status = batteryManager.status ();
+        const interval_t battery = status.updated [ProgramInterfaceSerialDalyBMS::COMMAND_SOC - ProgramInterfaceSerialDalyBMS::COMMAND_FIRST];
+        if (battery != 0 && battery != timelineBattery) {
+            timeline.push (ProgramTimelineChannel::BatteryVoltage, status.voltage, battery);
+            timeline.push (ProgramTimelineChannel::BatteryCurrent, status.current, battery);
+            timeline.push (ProgramTimelineChannel::BatteryCharge, batteryManager.instant ().charge, battery);
+            timelineBattery = battery;
+        }
+        if (temperatureSensorsManagerBatterypack.measured () != timelineTemperatures) {
+            timelineTemperatures = temperatureSensorsManagerBatterypack.measured ();
+            timeline.push (ProgramTimelineChannel::BatteryTemperatureAvg, temperatureSensorsManagerBatterypack.avg (), timelineTemperatures);
+            timeline.push (ProgramTimelineChannel::BatteryTemperatureMin, temperatureSensorsManagerBatterypack.min (), timelineTemperatures);
+            timeline.push (ProgramTimelineChannel::BatteryTemperatureMax, temperatureSensorsManagerBatterypack.max (), timelineTemperatures);
+        }
+        if (temperatureSensorsManagerEnvironment.measured () != timelineEnvironment) {
+            timelineEnvironment = temperatureSensorsManagerEnvironment.measured ();
+            timeline.push (ProgramTimelineChannel::EnvironmentTemperature, temperatureSensorsManagerEnvironment.getTemperature (), timelineEnvironment);
+        }
+        if (! timelineFan.has_value () || fanControllersInterface.getSpeed () != *timelineFan) {    // a step function, so only changes
+            timelineFan = fanControllersInterface.getSpeed ();
+            timeline.push (ProgramTimelineChannel::FanSpeed, static_cast<float> (*timelineFan));
+        }
     }
 
 protected:
@@ -279,6 +401,7 @@ protected:
 
 // -----------------------------------------------------------------------------------------------
 
+#include "conditions/ConditionsMechanicsTyrePressure.hpp"
 #include "conditions/ProgramManageBluetoothTPMS.hpp"
 
 // -----------------------------------------------------------------------------------------------
@@ -294,6 +417,7 @@ protected:
 #include "program/ProgramTime.hpp"
 #include "program/ProgramPlatformArduinoESP32.hpp"
 #include "program/ProgramSecrets.hpp"
+#include "program/ProgramConfigFanControl.hpp"
 #include "program/ProgramConfig.hpp"
 
 // -----------------------------------------------------------------------------------------------
@@ -306,9 +430,10 @@ class Program : public Component, public Diagnosticable {
     PlatformArduinoESP32 platform;
     TwoWire i2c_bus0, i2c_bus1;
 
+    ProgramTimeline timeline;
     ModuleBatterypack moduleBatterypack;
-    ProgramManageBluetoothTPMS tyrePressureManager;
     ModuleConnectivity moduleConnectivity;
+    ProgramManageBluetoothTPMS tyrePressureManager;
 
     ProgramDataControl dataControl;
     ProgramDataDeliver dataDeliver;
@@ -316,6 +441,7 @@ class Program : public Component, public Diagnosticable {
     ProgramDataStorage dataStorage;
 
     class OperationalManager {
+        static inline constexpr int TEMPERATURE_STALE_INTERVALS = 3;    // sweeps are once per batterypack interval
         const Program *_program;
 
     public:
@@ -323,15 +449,15 @@ class Program : public Component, public Diagnosticable {
             _program (program) {};
         void collect (JsonVariant &) const;
     } operational;
-    Intervalable dataProcessInterval, dataDeliverInterval, dataCaptureInterval, dataDiagnoseInterval;
-    String dataCollect (const String &name, const std::function<void (JsonVariant &)> func) const {
+    Intervalable dataProcessInterval, dataCaptureInterval, dataDiagnoseInterval;    // delivery is at each sink's own rate
+    JsonCollector dataCollect (const String &name, const std::function<void (JsonVariant &)> func) const {
         JsonCollector collector (name, getTimeString (), address);
         JsonVariant obj = collector.document ().as<JsonVariant> ();
         func (obj);
         return collector;
     }
 
-    void dataCapture (const String &data, const bool publishData, const bool storageData) {
+    void dataCapture (const JsonCollector &data, const bool publishData, const bool storageData) {
         class StorageLineHandler : public ProgramDataStorage::LineCallback {
             ProgramDataPublish &_publish;
 
@@ -352,40 +478,51 @@ class Program : public Component, public Diagnosticable {
             }
             if (! dataPublish.publish (data, "data"))
                 if (storageData)
-                    dataStorage.append (data);
+                    dataStorage.append (data.text ());    // stored as text lines, whatever the publish encoding
         } else if (storageData)
-            dataStorage.append (data);
+            dataStorage.append (data.text ());
     }
 
     void dataProcess () {
 
-        const bool dataShouldDeliver = dataDeliverInterval, dataToDeliver = dataShouldDeliver && dataDeliver.available ();
+        const bool dataToDeliver = dataDeliver.due (config.dataPublishEnabled && dataPublish.available ());
         const bool dataShouldCapture = dataCaptureInterval, dataToCaptureToPublish = dataShouldCapture && (config.dataPublishEnabled && dataPublish.available ()), dataToCaptureToStorage = dataShouldCapture && (config.dataStorageEnabled && dataStorage.available ());
-        const bool diagShould = dataDiagnoseInterval && (config.diagDeliverEnabled || config.diagPublishEnabled), diagToDeliver = diagShould && (config.diagDeliverEnabled && dataDeliver.available ()), diagToPublish = diagShould && (config.diagPublishEnabled && dataPublish.available ());
+        const bool diagShould = dataDiagnoseInterval && (config.diagDeliverEnabled || config.diagPublishEnabled), diagToDeliver = diagShould && (config.diagDeliverEnabled && dataDeliver.availablePushed ()), diagToPublish = diagShould && (config.diagPublishEnabled && dataPublish.available ());
 
-        DEBUG_PRINTF ("Program::process: deliver=%d/%d, capture=%d/%d/%d, diagnose=%d/%d/%d\n", dataShouldDeliver, dataToDeliver, dataShouldCapture, dataToCaptureToPublish, dataToCaptureToStorage, diagShould, diagToDeliver, diagToPublish);
+        DEBUG_PRINTF ("Program::process: deliver=%d, capture=%d/%d/%d, diagnose=%d/%d/%d\n", dataToDeliver, dataShouldCapture, dataToCaptureToPublish, dataToCaptureToStorage, diagShould, diagToDeliver, diagToPublish);
 
         if (dataToDeliver || (dataToCaptureToPublish || dataToCaptureToStorage)) {
-            const String data = dataCollect ("data", [&] (JsonVariant &obj) {
+            const JsonCollector data = dataCollect ("data", [&] (JsonVariant &obj) {
                 operational.collect (obj);
             });
-            DEBUG_PRINTF ("Program::process: data, length=%d, content=<<<%s>>>\n", data.length (), data.c_str ());
+            DEBUG_PRINTF ("Program::process: data, length=%d, content=<<<%s>>>\n", data.text ().length (), data.text ().c_str ());
             if (dataToDeliver)
                 dataDeliver.deliver (data, "data", config.dataPublishEnabled && dataPublish.available ());
             if (dataToCaptureToPublish || dataToCaptureToStorage)
                 dataCapture (data, dataToCaptureToPublish, dataToCaptureToStorage);
         }
 
+        dataDeliver.alarms (programAlarms.toString (), [&] () {
+            return dataCollect ("alarms", [&] (JsonVariant &obj) {
+                obj ["alm"] = programAlarms.toString ();
+            });
+        });
+
         if (diagToDeliver || diagToPublish) {
-            const String diag = dataCollect ("diag", [&] (JsonVariant &obj) {
+            const JsonCollector diag = dataCollect ("diag", [&] (JsonVariant &obj) {
                 programDiagnostics.collect (obj);
             });
-            DEBUG_PRINTF ("Program::process: diag, length=%d, content=<<<%s>>>\n", diag.length (), diag.c_str ());
+            DEBUG_PRINTF ("Program::process: diag, length=%d, content=<<<%s>>>\n", diag.text ().length (), diag.text ().c_str ());
             if (diagToDeliver)
                 dataDeliver.deliver (diag, "diag", config.dataPublishEnabled && dataPublish.available ());
             if (diagToPublish)
                 dataPublish.publish (diag, "diag");
         }
+        dataDeliver.diagnostics ([&] () {
+            return dataCollect ("diag", [&] (JsonVariant &obj) {
+                programDiagnostics.collect (obj);
+            });
+        });
     }
 
     void process () override {
@@ -419,9 +556,9 @@ public:
         platform (config.programPlatform),
         i2c_bus0 (0),
         i2c_bus1 (1),
-        moduleBatterypack (config.moduleBatterypack),
-        tyrePressureManager (config.tyrePressureManager),
+        moduleBatterypack (config.moduleBatterypack, timeline),
         moduleConnectivity (config.moduleConnectivity, [&] () { return moduleConnectivity.wifi ().available (); }),    // for now, until other networks
+        tyrePressureManager (config.tyrePressureManager, timeline, moduleConnectivity.radio (), [&] () { return programTime.fetched (); }),
         //
         dataControl (config.dataControl, address, moduleConnectivity),
         dataDeliver (config.dataDeliver, address, moduleConnectivity.blue (), moduleConnectivity.mqtt (), moduleConnectivity.websocket ()),
@@ -429,7 +566,6 @@ public:
         dataStorage (config.dataStorage),
         operational (this),
         dataProcessInterval (config.dataProcessInterval),
-        dataDeliverInterval (config.dataDeliverInterval),
         dataCaptureInterval (config.dataCaptureInterval),
         dataDiagnoseInterval (config.dataDiagnoseInterval),
         //
@@ -437,11 +573,11 @@ public:
         programLogging (config.programLogging, getMacAddressBase (""), &moduleConnectivity.mqtt ()),
         programUpdater (config.programUpdater, [&] () { return moduleConnectivity.wifi ().available (); }),    // for now, until other networks
         programAlarmsInterface (config.programAlarmsInterface),
-        programAlarms (config.programAlarms, programAlarmsInterface, { &moduleBatterypack.getTemperatureSensorsManagerEnvironment (), &moduleBatterypack.getTemperatureSensorsManagerBatterypack (), &dataDeliver, &dataPublish, &dataStorage, &programTime, &platform }),
-        programDiagnostics (config.programDiagnostics, { &moduleConnectivity, &moduleBatterypack, &tyrePressureManager, &dataDeliver, &dataPublish, &dataStorage, &dataControl, &programTime, &programUpdater, &programAlarms, &platform, this }),
-        programComponents ({ &moduleBatterypack, &moduleConnectivity, &tyrePressureManager, &programAlarms, &dataDeliver, &dataPublish, &dataStorage, &dataControl, &programTime, &programUpdater, &programDiagnostics, this }),    // XXX note order of tpm / connectivity due to bluetooth init
+        programAlarms (config.programAlarms, programAlarmsInterface, { &moduleBatterypack.getTemperatureSensorsManagerEnvironment (), &moduleBatterypack.getTemperatureSensorsManagerBatterypack (), &tyrePressureManager, &dataDeliver, &dataPublish, &dataStorage, &programTime, &platform }),
+        programDiagnostics (config.programDiagnostics, { &moduleConnectivity, &moduleBatterypack, &tyrePressureManager, &dataDeliver, &dataPublish, &dataStorage, &dataControl, &programTime, &programUpdater, &programAlarms, &timeline, &platform, this }),
+        programComponents ({ &moduleBatterypack, &moduleConnectivity, &tyrePressureManager, &programAlarms, &dataDeliver, &dataPublish, &dataStorage, &dataControl, &programTime, &programUpdater, &programDiagnostics, this }),
         programInterval (config.programInterval) {
-        DEBUG_PRINTF ("Program::constructor: intervals [program=%lu] - process=%lu, deliver=%lu, capture=%lu, diagnose=%lu\n", config.programInterval, config.dataProcessInterval, config.dataDeliverInterval, config.dataCaptureInterval, config.dataDiagnoseInterval);
+        DEBUG_PRINTF ("Program::constructor: intervals [program=%lu] - process=%lu, capture=%lu, diagnose=%lu\n", config.programInterval, config.dataProcessInterval, config.dataCaptureInterval, config.dataDiagnoseInterval);
         i2c_bus0.setPins (config.i2c0.PIN_SDA, config.i2c0.PIN_SCL);
         i2c_bus1.setPins (config.i2c1.PIN_SDA, config.i2c1.PIN_SCL);
     };
@@ -470,20 +606,55 @@ protected:
 // -----------------------------------------------------------------------------------------------
 
 void Program::OperationalManager::collect (JsonVariant &obj) const {
+    // values are as recorded on the timeline, each at its own measurement time, and aligned to this frame
+    using Sample = ProgramTimeline::Sample;
+    const interval_t now = millis ();
+    const ProgramTimeline &timeline = _program->timeline;
     JsonObject tmp = obj ["tmp"].to<JsonObject> ();
     JsonObject bms = tmp ["bms"].to<JsonObject> ();
-    auto x = _program->moduleBatterypack.getBatteryManager ().instant ();
-    bms ["V"] = x.voltage;
-    bms ["I"] = x.current;
-    bms ["C"] = x.charge;
-    tmp ["env"] = _program->moduleBatterypack.getTemperatureSensorsManagerEnvironment ().getTemperature ();
+    const auto &batteryManager = _program->moduleBatterypack.getBatteryManager ();
+    Sample voltage, current, charge;
+    const interval_t bmsLimit = batteryManager.staleAfter (ProgramInterfaceSerialDalyBMS::CategoryInstant);
+    interval_t bmsAge = ProgramInterfaceSerialDalyBMS::AGE_NEVER;
+    if ((timeline.aligned (ProgramTimelineChannel::BatteryVoltage, now, &voltage, bmsLimit) || timeline.latest (ProgramTimelineChannel::BatteryVoltage, &voltage)) && timeline.aligned (ProgramTimelineChannel::BatteryCurrent, voltage.time, &current, 0) && timeline.aligned (ProgramTimelineChannel::BatteryCharge, voltage.time, &charge, 0)) {    // pushed together
+        bms ["V"] = voltage.value;
+        bms ["I"] = current.value;
+        bms ["C"] = charge.value;
+        bmsAge = now - voltage.time;
+    } else if (const auto instant = batteryManager.instant (); instant.age != ProgramInterfaceSerialDalyBMS::AGE_NEVER) {    // since pushed out of the timeline by newer samples
+        bms ["V"] = instant.voltage;
+        bms ["I"] = instant.current;
+        bms ["C"] = instant.charge;
+        bmsAge = instant.age;
+    }
+    if (bmsAge != ProgramInterfaceSerialDalyBMS::AGE_NEVER && bmsAge > bmsLimit)
+        bms ["stale"] = bmsAge / 1000;
+    const interval_t temperatureLimit = TEMPERATURE_STALE_INTERVALS * _program->config.moduleBatterypack.intervalProcess;
+    Sample environment, batteryAvg, batteryMin, batteryMax;
+    const bool envAligned = timeline.aligned (ProgramTimelineChannel::EnvironmentTemperature, now, &environment, temperatureLimit);
+    if (envAligned)
+        tmp ["env"] = environment.value;
     JsonObject bat = tmp ["bat"].to<JsonObject> ();
-    bat ["avg"] = _program->moduleBatterypack.getTemperatureSensorsManagerBatterypack ().avg ();
-    bat ["min"] = _program->moduleBatterypack.getTemperatureSensorsManagerBatterypack ().min ();
-    bat ["max"] = _program->moduleBatterypack.getTemperatureSensorsManagerBatterypack ().max ();
-    JsonArray val = bat ["val"].to<JsonArray> ();
-    for (const auto &v : _program->moduleBatterypack.getTemperatureSensorsManagerBatterypack ().getTemperatures ())
-        val.add (v);
+    const bool batAligned = timeline.aligned (ProgramTimelineChannel::BatteryTemperatureAvg, now, &batteryAvg, temperatureLimit) && timeline.aligned (ProgramTimelineChannel::BatteryTemperatureMin, batteryAvg.time, &batteryMin, 0) && timeline.aligned (ProgramTimelineChannel::BatteryTemperatureMax, batteryAvg.time, &batteryMax, 0);
+    if (batAligned) {
+        bat ["avg"] = batteryAvg.value;
+        bat ["min"] = batteryMin.value;
+        bat ["max"] = batteryMax.value;
+    }
+    const auto &temperatureSensorsManagerBatterypack = _program->moduleBatterypack.getTemperatureSensorsManagerBatterypack ();
+    if (batAligned && temperatureSensorsManagerBatterypack.measured () == batteryAvg.time) {    // the same sweep, not one since
+        JsonArray val = bat ["val"].to<JsonArray> ();
+        for (const auto &v : temperatureSensorsManagerBatterypack.getTemperatures ())
+            val.add (v);
+    }
+    // when each group was measured, in ms before this frame was collected
+    JsonObject age = tmp ["age"].to<JsonObject> ();
+    if (bmsAge != ProgramInterfaceSerialDalyBMS::AGE_NEVER)
+        age ["bms"] = bmsAge;
+    if (batAligned)
+        age ["bat"] = now - batteryAvg.time;
+    if (envAligned)
+        age ["env"] = now - environment.time;
     obj ["fan"] = _program->moduleBatterypack.getFanControllersInterface ().getSpeed ();
     obj ["alm"] = _program->programAlarms.toString ();
 }
@@ -20,8 +20,9 @@ typedef uint32_t _AlarmType;
 #define ALARM_UPDATE_LONG         _ALARM_NUMB (13)
 #define ALARM_SYSTEM_MEMORYLOW    _ALARM_NUMB (14)
 #define ALARM_SYSTEM_BADRESET     _ALARM_NUMB (15)
-#define _ALARM_COUNT              (16)
-static const char *_ALARM_NAMES [_ALARM_COUNT] = { "TIME_SYNC", "TIME_DRIFT", "TEMP_FAIL", "TEMP_MIN", "TEMP_WARN", "TEMP_MAX", "STORE_FAIL", "STORE_SIZE", "PUBLISH_FAIL", "PUBLISH_SIZE", "DELIVER_FAIL", "DELIVER_SIZE", "UPDATE_VERS", "UPDATE_LONG", "SYSTEM_MEMLOW", "SYSTEM_BADRESET" };
+#define ALARM_TYRE_LEAK           _ALARM_NUMB (16)
+#define _ALARM_COUNT              (17)
+static const char *_ALARM_NAMES [_ALARM_COUNT] = { "TIME_SYNC", "TIME_DRIFT", "TEMP_FAIL", "TEMP_MIN", "TEMP_WARN", "TEMP_MAX", "STORE_FAIL", "STORE_SIZE", "PUBLISH_FAIL", "PUBLISH_SIZE", "DELIVER_FAIL", "DELIVER_SIZE", "UPDATE_VERS", "UPDATE_LONG", "SYSTEM_MEMLOW", "SYSTEM_BADRESET", "TYRE_LEAK" };
 #define _ALARM_NAME(x) (_ALARM_NAMES [x])
 
 class AlarmSet {
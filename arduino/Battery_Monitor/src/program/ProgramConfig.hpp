@@ -15,6 +15,11 @@
 #define DEFAULT_BLUE_PIN 123456    // Secrets.hpp
 #endif
 
+// telemetry deltas, in the units of the frame: V, A, Ah, mV (cells), C (env, bat), ms (age)
+#define DEFAULT_DELTA_THRESHOLDS { { "V", 0.02f }, { "I", 0.05f }, { "C", 0.1f }, { "cells", 2.0f }, { "env", 0.1f }, { "bat", 0.1f }, { "age", 1000.0f } }
+// telemetry profiles, what the app shows of the frame: the bms with its staleness and age, without the other ages
+#define DEFAULT_PROFILE_SUMMARY { "tmp.bms.V", "tmp.bms.I", "tmp.bms.C", "tmp.bms.stale", "tmp.env", "tmp.bat", "tmp.age.bms", "fan", "alm" }
+
 // -----------------------------------------------------------------------------------------------
 
 /*
@@ -153,67 +158,105 @@ struct Config {
                                          .thermister = { .REFERENCE_RESISTANCE = 10000.0, .NOMINAL_RESISTANCE = 10000.0, .NOMINAL_TEMPERATURE = 25.0 }
 #endif
         },
-        .temperatureSensorsManagerBatterypack = { .channels = { 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15 }, .SETPOINT = 25.0, .FAILURE = -100.0, .MINIMAL = -20.0, .WARNING = 35.0, .MAXIMAL = 45.0 },
+        .temperatureSensorsManagerBatterypack = { .channels = { 0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15 }, .SETPOINT = DEFAULT_FAN_SETPOINT, .FAILURE = -100.0, .MINIMAL = -20.0, .WARNING = 35.0, .MAXIMAL = 45.0 },
         .temperatureSensorsManagerEnvironment = { .channel = 8, .FAILURE = -100.0 },
-        .FAN_CONTROL_P = 10.0,
-        .FAN_CONTROL_I = 0.1,
-        .FAN_CONTROL_D = 1.0,
-        .FAN_SMOOTH_A = 0.1,
+        .FAN_CONTROL_P = DEFAULT_FAN_CONTROL_P,
+        .FAN_CONTROL_I = DEFAULT_FAN_CONTROL_I,
+        .FAN_CONTROL_D = DEFAULT_FAN_CONTROL_D,
+        .FAN_SMOOTH_A = DEFAULT_FAN_SMOOTH_A,
+        .FAN_CONTROL = ModuleBatterypack::FanControl::Pid,
+        .fanControllingMpc = DEFAULT_FAN_CONTROL_MPC,
+        .FAN_STRATEGY = ModuleBatterypack::FanStrategy::MotorMapWithRotation,
+        .fanControllersStrategyZones = { .WEIGHTS = { { // [motor][probe], even until measured by factory_fanZonesCalibration (FACTORY_FANZONES_CALIBRATION build)
+                                             { 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 },
+                                             { 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 },
+                                             { 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 },
+                                             { 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 } } },
+                                         .SHARE_MINIMUM = DEFAULT_FAN_ZONES_SHARE_MINIMUM,
+                                         .SHARE_CHANGE = DEFAULT_FAN_ZONES_SHARE_CHANGE },
         .fanControllersInterface = { .hardware = { .I2C_ADDR = OpenSmart_QuadMotorDriver::I2cAddress, .PIN_I2C_SDA = PIN_OSQMD_I2CSDA, .PIN_I2C_SCL = PIN_OSQMD_I2CSCL, .PIN_PWMS = { PIN_OSQMD_PWM_0, PIN_OSQMD_PWM_1, PIN_OSQMD_PWM_2, PIN_OSQMD_PWM_3 }, .frequency = 5000, .invertedPWM = true },
                                          .DIRECTION = OpenSmart_QuadMotorDriver::MOTOR_CLOCKWISE,
-                                         .MIN_SPEED = 96,
-                                         .MAX_SPEED = 255,
+                                         .MIN_SPEED = DEFAULT_FAN_MIN_SPEED,
+                                         .MAX_SPEED = DEFAULT_FAN_MAX_SPEED,
                                          .MOTOR_ORDER = { 0, 1, 2, 3 },
-                                         .MOTOR_ROTATE = 5 * 60 * 1000 },
-        .fanControllersManager = {},
-        .batteryManagerManager = { .manager = { .manager = {
-                                                    .id = "manager",
-                                                    .capabilities = daly_bms::Capabilities::Managing + daly_bms::Capabilities::TemperatureSensing - daly_bms::Capabilities::FirmwareIndex - daly_bms::Capabilities::RealTimeClock,
-                                                    .categories = daly_bms::Categories::All,
-                                                    .debugging = daly_bms::Debugging::Errors + daly_bms::Debugging::Requests + daly_bms::Debugging::Responses,
-                                                },
-                                                .serialId = PIN_DALY_MANAGER_SERIAL_ID,
-                                                .serialRxPin = PIN_DALY_MANAGER_SERIAL_RX,
-                                                .serialTxPin = PIN_DALY_MANAGER_SERIAL_TX,
-                                                .enPin = PIN_DALY_MANAGER_SERIAL_EN },
-                                         .balance = { .manager = {
-                                                    .id = "balance",
-                                                    .capabilities = daly_bms::Capabilities::Balancing + daly_bms::Capabilities::TemperatureSensing - daly_bms::Capabilities::FirmwareIndex,
-                                                    .categories = daly_bms::Categories::All,
-                                                    .debugging = daly_bms::Debugging::Errors + daly_bms::Debugging::Requests + daly_bms::Debugging::Responses,
-                                                },
-                                                .serialId = PIN_DALY_BALANCE_SERIAL_ID,
-                                                .serialRxPin = PIN_DALY_BALANCE_SERIAL_RX,
-                                                .serialTxPin = PIN_DALY_BALANCE_SERIAL_TX,
-                                                .enPin = PIN_DALY_BALANCE_SERIAL_EN },
-                                         .intervalInstant = 15 * 1000,
-                                         .intervalStatus = 60 * 1000,
-                                         .intervalDiagnostics = 5 * 60 * 1000 },
-        .ds18b20 = { .PIN_DAT = PIN_DS18B0_DAT, .INDEX = 0 }
+                                         .MOTOR_ROTATE = DEFAULT_FAN_MOTOR_ROTATE,
+                                         .MOTOR_PERSIST = DEFAULT_FAN_MOTOR_PERSIST,
+                                         .output = DEFAULT_FAN_OUTPUT },
+        .fanControllersManager = { .HYSTERESIS = DEFAULT_FAN_HYSTERESIS },
+        .batteryManagerManager = { .manager = { .daly = { .manager = {
+                                                              .id = "manager",
+                                                              .capabilities = daly_bms::Capabilities::Managing + daly_bms::Capabilities::TemperatureSensing - daly_bms::Capabilities::FirmwareIndex - daly_bms::Capabilities::RealTimeClock,
+                                                              .categories = daly_bms::Categories::All,
+                                                              .debugging = daly_bms::Debugging::Errors + daly_bms::Debugging::Requests + daly_bms::Debugging::Responses,
+                                                          },
+                                                          .serialId = PIN_DALY_MANAGER_SERIAL_ID,
+                                                          .serialRxPin = PIN_DALY_MANAGER_SERIAL_RX,
+                                                          .serialTxPin = PIN_DALY_MANAGER_SERIAL_TX,
+                                                          .enPin = PIN_DALY_MANAGER_SERIAL_EN },
+                                                .categories = ProgramInterfaceSerialDalyBMS::CategoryAll,
+                                                .TIMEOUT = 1000 },
+                                   .balance = { .daly = { .manager = {
+                                                              .id = "balance",
+                                                              .capabilities = daly_bms::Capabilities::Balancing + daly_bms::Capabilities::TemperatureSensing - daly_bms::Capabilities::FirmwareIndex,
+                                                              .categories = daly_bms::Categories::All,
+                                                              .debugging = daly_bms::Debugging::Errors + daly_bms::Debugging::Requests + daly_bms::Debugging::Responses,
+                                                          },
+                                                          .serialId = PIN_DALY_BALANCE_SERIAL_ID,
+                                                          .serialRxPin = PIN_DALY_BALANCE_SERIAL_RX,
+                                                          .serialTxPin = PIN_DALY_BALANCE_SERIAL_TX,
+                                                          .enPin = PIN_DALY_BALANCE_SERIAL_EN },
+                                                .categories = ProgramInterfaceSerialDalyBMS::CategoryStatus | ProgramInterfaceSerialDalyBMS::CategoryDiagnostics,
+                                                .TIMEOUT = 1000 },
+                                   .intervalInstant = 15 * 1000,
+                                   .intervalStatus = 60 * 1000,
+                                   .intervalDiagnostics = 5 * 60 * 1000,
+                                   // XXX capacity, cells and resistance per the pack, OCV curve is a generic LiFePO4 one at rest
+                                   .charge = { .CAPACITY = 280.0f, .EFFICIENCY = 0.99f, .CELLS = 16, .RESISTANCE = 0.02f,
+                                               .OCV = { { { 0.00f, 2.90f }, { 0.05f, 3.15f }, { 0.10f, 3.22f }, { 0.20f, 3.26f }, { 0.30f, 3.29f }, { 0.50f, 3.31f }, { 0.60f, 3.32f }, { 0.70f, 3.33f }, { 0.80f, 3.34f }, { 0.90f, 3.35f }, { 1.00f, 3.45f } } },
+                                               .NOISE_PROCESS = 1e-8f, .NOISE_MEASUREMENT = 0.0025f,
+                                               .REST_CURRENT = 2.0f, .REST_SECONDS = 30.0f * 60.0f,
+                                               .VARIANCE_INITIAL = 0.01f },
+                                   .intervalChargePersist = 15 * 60 * 1000 },
+        .batteryCellAnalytics = { .analytics = { .DRIFT_ALPHA = 0.05f } },
+        // XXX activation (B) is a typical LiFePO4 figure, not measured on this pack
+        .batteryInternalResistance = { .pack = { .STEP_CURRENT = 10.0f, .STEP_SECONDS = 40.0f, .RESISTANCE_MAXIMUM = 0.2f, .FORGETTING = 0.995f, .ACTIVATION = 3000.0f, .VARIANCE_INITIAL = 1.0f },
+                                       .cell = { .STEP_CURRENT = 10.0f, .STEP_SECONDS = 11.0f * 60.0f, .RESISTANCE_MAXIMUM = 0.02f, .FORGETTING = 0.99f, .ACTIVATION = 3000.0f, .VARIANCE_INITIAL = 1.0f },
+                                       .CELL_CURRENT_DRIFT = 2.0f },
+        .batteryBalancing = { .scheduler = { .SPREAD_START = 30.0f, .SPREAD_STOP = 10.0f, .BLEED_POWER = 0.2f, .COUPLING_STILL = 2.0f, .COUPLING_FAN = 14.0f, .MARGIN = 3.0f, .PREFERENCE = 0.5f },
+                              .intervalDecide = 60 * 1000,
+                              .PERIOD = 10 * 60 * 1000,
+                              .RESISTANCE = 0.02f,    // as per the charge estimator, until measured online
+                              .ACTUATE = false },
+        .ds18b20 = { .PIN_DAT = PIN_DS18B0_DAT, .INDEX = 0 },
+        .intervalProcess = 5 * 1000    // as the program loop was, to which the fan control is tuned
     };
 
     // CONDITIONS
     ProgramManageBluetoothTPMS::Config tyrePressureManager = {
-        .front = "38:89:00:00:36:02", .rear = "38:8b:00:00:ed:63"
+        .front = "38:89:00:00:36:02", .rear = "38:8b:00:00:ed:63",
+        .trend = { .ATMOSPHERIC = 101.325f, .REFERENCE = 20.0f, .INTERVAL_RECORD = 5 * 60 * 1000, .WINDOW = 3.0f * 24.0f * 60.0f * 60.0f, .SPAN_MINIMUM = 12.0f * 60.0f * 60.0f, .INFLATION = 10.0f, .LEAK_RATE = 2.0f },
+        .intervalTrendPersist = 30 * 60 * 1000,
+        .intervalTrendRestoreWait = 10 * 60 * 1000
     };
 
     // CONNECTIVITY
     ModuleConnectivity::Config moduleConnectivity = {
-        .blue = { .name = DEFAULT_NAME, .serviceUUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b", .characteristicUUID = "beb5483e-36e1-4688-b7f5-ea07361b26a8", .pin = DEFAULT_BLUE_PIN, .intervalConnectionCheck = 1 * 60 * 1000 },
+        .radio = { .name = DEFAULT_NAME, .scanSeconds = 5, .idle = { .interval = 75, .window = 50, .rest = 0 }, .connected = { .interval = 200, .window = 30, .rest = 5 * 1000 }, .streaming = { .interval = 500, .window = 15, .rest = 25 * 1000 }, .streamingHold = 15 * 1000 },
+        .blue = { .name = DEFAULT_NAME, .serviceUUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b", .characteristicUUIDs = { .data = "beb5483e-36e1-4688-b7f5-ea07361b26a8", .diag = "beb5483f-36e1-4688-b7f5-ea07361b26a8", .alarms = "beb54840-36e1-4688-b7f5-ea07361b26a8", .control = "beb54841-36e1-4688-b7f5-ea07361b26a8" }, .pin = DEFAULT_BLUE_PIN, .intervalConnectionCheck = 1 * 60 * 1000, .notify = { .depth = 32, .timeout = 1000, .retries = 2 }, .link = { .phy2M = true, .dataLength = 251, .streaming = { .min = 20, .max = 30, .latency = 0, .timeout = 4000 }, .relaxed = { .min = 200, .max = 400, .latency = 2, .timeout = 6000 } } },
         .mdns = {},
         .mqtt = { .client = DEFAULT_NAME, .peers = { .order = DEFAULT_MQTT_PEERS, .retries = 3 }, .bufferSize = 3 * 1024 },
         .webserver = { .enabled = true, .port = 80 },
-        .websocket = { .enabled = true, .port = 81, .root = "/" },
+        .websocket = { .enabled = true, .port = 81, .root = "/", .clients = 4, .queueLimit = 8, .evictAfter = 5 },
         .wifi = { .host = DEFAULT_NAME, .peers = { .order = DEFAULT_WIFI_PEERS, .retries = 3 }, .intervalConnectionCheck = 1 * 60 * 1000 }
     };
 
     // CONTENT
-    ProgramDataDeliver::Config dataDeliver = { .topic = DEFAULT_NAME, .failureLimit = 3 };
-    ProgramDataPublish::Config dataPublish = { .topic = DEFAULT_NAME, .failureLimit = 3 };
+    ProgramDataDeliver::Config dataDeliver = { .topic = DEFAULT_NAME, .failureLimit = 3, .delta = { .enabled = true, .keyframeInterval = 12, .threshold = 0.0f, .thresholds = DEFAULT_DELTA_THRESHOLDS }, .blue = { .interval = 1 * 1000, .profile = { .fields = DEFAULT_PROFILE_SUMMARY, .precision = 2 } }, .webs = { .interval = 5 * 1000, .profile = { .fields = {}, .precision = 3 } }, .mqtt = { .interval = 15 * 1000, .profile = { .fields = {}, .precision = -1 } } };
+    ProgramDataPublish::Config dataPublish = { .topic = DEFAULT_NAME, .failureLimit = 3, .encoding = JsonEncoding::Text, .delta = { .enabled = false, .keyframeInterval = 8, .threshold = 0.0f, .thresholds = DEFAULT_DELTA_THRESHOLDS }, .profile = { .fields = {}, .precision = -1 } };
     ProgramDataStorage::Config dataStorage = { .filename = "/data.log", .remainLimit = 0.20, .failureLimit = 3 };
     ProgramDataControl::Config dataControl = { .url_version = "/version" };
     bool dataPublishEnabled = true, dataStorageEnabled = true, diagPublishEnabled = true, diagDeliverEnabled = true;
-    interval_t dataProcessInterval = 5 * 1000, dataDeliverInterval = 5 * 1000, dataCaptureInterval = 15 * 1000, dataDiagnoseInterval = 60 * 1000;
+    interval_t dataProcessInterval = 1 * 1000, dataCaptureInterval = 15 * 1000, dataDiagnoseInterval = 60 * 1000;    // delivery rates are per sink, in dataDeliver
 
     // PROGRAM
     ProgramTime::Config programTime = { .hardware = { .PIN_INTERRUPT = -1 }, .useragent = String (DEFAULT_NAME) + String ("/1.0"), .server = "http://matthewgream.net", .intervalUpdate = 60 * 60 * 1000, .intervalAdjust = 60 * 1000, .failureLimit = 3 };
@@ -222,7 +265,7 @@ struct Config {
     ProgramAlarmsInterface::Config programAlarmsInterface = { .PIN = -1, .ACTIVE = LOW };
     ProgramAlarms::Config programAlarms = {};
     DiagnosticablesManager::Config programDiagnostics = {};
-    interval_t programInterval = 5 * 1000;
+    interval_t programInterval = 1 * 1000;    // for the 1 Hz bluetooth feed; the batterypack keeps its own slower interval
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -0,0 +1,24 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// fan control defaults, apart from ProgramConfig so the workbench (tools/simulator) runs, and checks, the values shipped
+
+#define DEFAULT_FAN_SETPOINT  25.0
+#define DEFAULT_FAN_CONTROL_P 10.0    // reverse acting (see ProgramManageFanControllersAlgorithm_pid), tuned by the workbench
+#define DEFAULT_FAN_CONTROL_I 0.1
+#define DEFAULT_FAN_CONTROL_D 1.0
+#define DEFAULT_FAN_SMOOTH_A  0.1
+#define DEFAULT_FAN_CONTROL_MPC \
+    { .HEAT_CAPACITY = 90000.0, .COUPLING_AMBIENT = 2.0, .COUPLING_FAN = 12.0, .HORIZON_STEP = 60.0, .HORIZON_STEPS = 15, .CANDIDATES = 21, .WEIGHT_ENERGY = 1.0, .WEIGHT_EXCESS = 10.0, .ESTIMATE_ALPHA = 0.05 }    // XXX identify from pack logs
+#define DEFAULT_FAN_MIN_SPEED     96
+#define DEFAULT_FAN_MAX_SPEED     255
+#define DEFAULT_FAN_MOTOR_ROTATE  (5 * 60 * 1000)
+#define DEFAULT_FAN_MOTOR_PERSIST (60 * 60 * 1000)
+#define DEFAULT_FAN_OUTPUT        { .DEADBAND = 4, .SLEW_RATE = 32.0f, .DWELL_MINIMUM = 2 * 1000 }
+#define DEFAULT_FAN_HYSTERESIS    1.0f
+#define DEFAULT_FAN_ZONES_SHARE_MINIMUM 0.25
+#define DEFAULT_FAN_ZONES_SHARE_CHANGE  0.1
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -80,6 +80,9 @@ public:
             }
         }
     }
+    inline bool fetched () const {    // since boot, otherwise the time is as last persisted
+        return _fetchedTime > 0;
+    }
     //
     void collectDiagnostics (JsonVariant &obj) const override {
         JsonObject sub = obj ["time"].to<JsonObject> ();
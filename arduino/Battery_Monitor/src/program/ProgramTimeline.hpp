@@ -0,0 +1,33 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+#include <optional>
+
+enum class ProgramTimelineChannel : uint8_t {
+    BatteryVoltage,
+    BatteryCurrent,
+    BatteryCharge,
+    BatteryTemperatureAvg,
+    BatteryTemperatureMin,
+    BatteryTemperatureMax,
+    EnvironmentTemperature,
+    FanSpeed,
+    TyreFrontPressure,
+    TyreFrontTemperature,
+    TyreRearPressure,
+    TyreRearTemperature
+};
+
+class ProgramTimeline : public TimelineConcurrentSafe<512, ProgramTimelineChannel>, public Diagnosticable {
+protected:
+    void collectDiagnostics (JsonVariant &obj) const override {
+        JsonObject sub = obj ["timeline"].to<JsonObject> ();
+        sub ["size"] = size ();
+        sub ["pushed"] = pushed ();
+        sub ["span"] = span () / 1000;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -207,6 +207,64 @@ public:
 
 // -----------------------------------------------------------------------------------------------
 
+// lumped thermal model: C dT/dt = Q - (kAmb + kFan u) (T - Tamb), with heat Q estimated online from the
+// observed response, and a bounded search over constant fan speeds u across the horizon for the
+// least cost of energy (u^3) plus excess above the setpoint (squared)
+template <typename T>
+class MpcController {
+public:
+    typedef struct {
+        T HEAT_CAPACITY;                           // J/K
+        T COUPLING_AMBIENT, COUPLING_FAN;          // W/K, passive and additional at full fan speed
+        T HORIZON_STEP;                            // seconds
+        size_t HORIZON_STEPS, CANDIDATES;          // bounds the cost to HORIZON_STEPS * CANDIDATES model steps
+        T WEIGHT_ENERGY, WEIGHT_EXCESS, ESTIMATE_ALPHA;
+    } Config;
+
+    const Config &config;
+
+public:    // for serialization
+    T _q = T (0), _u = T (0), _c = T (0), _x = T (0);
+    interval_t _t = 0;
+
+private:
+    T cost (const T &u, const T &setpoint, const T &current, const T &ambient) const {
+        T temperature = current, total = T (0);
+        const T coupling = config.COUPLING_AMBIENT + config.COUPLING_FAN * u;
+        for (size_t step = 0; step < config.HORIZON_STEPS; step++) {
+            temperature += config.HORIZON_STEP * (_q - coupling * (temperature - ambient)) / config.HEAT_CAPACITY;
+            const T excess = std::max (T (0), temperature - setpoint);
+            total += config.HORIZON_STEP * (config.WEIGHT_ENERGY * u * u * u + config.WEIGHT_EXCESS * excess * excess);
+        }
+        return total;
+    }
+
+public:
+    explicit MpcController (const Config &cfg) :
+        config (cfg) {
+        assert (config.HEAT_CAPACITY > T (0) && config.HORIZON_STEPS > 0 && config.CANDIDATES > 1 && "Bad configuration values");
+    }
+    T apply (const T &setpoint, const T &current, const T &ambient) {    // fan speed 0 .. 1
+        const interval_t t = millis ();
+        if (_t > 0 && t > _t) {
+            const T q = config.HEAT_CAPACITY * (current - _x) / ((t - _t) / 1000.0) + (config.COUPLING_AMBIENT + config.COUPLING_FAN * _u) * (current - ambient);
+            _q = std::max (T (0), config.ESTIMATE_ALPHA * q + (T (1) - config.ESTIMATE_ALPHA) * _q);
+        }
+        T u_best = T (0), c_best = cost (T (0), setpoint, current, ambient);
+        for (size_t candidate = 1; candidate < config.CANDIDATES; candidate++) {
+            const T u = static_cast<T> (candidate) / static_cast<T> (config.CANDIDATES - 1), c = cost (u, setpoint, current, ambient);
+            if (c < c_best)
+                u_best = u, c_best = c;
+        }
+        _t = t;
+        _x = current;
+        _c = c_best;
+        return (_u = u_best);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
 template <typename T>
 class AlphaSmoothing {
     const T _alpha;
@@ -453,6 +511,128 @@ public:
     }
 };
 
+// -----------------------------------------------------------------------------------------------
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+// seqlock: one writer, any number of readers from any task, neither side takes a lock
+template <typename T>
+class SnapshotConcurrentSafe {
+    static_assert (std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+    std::atomic<uint32_t> _sequence { 0 };
+    T _value {};
+
+public:
+    void store (const T &value) {
+        const uint32_t sequence = _sequence.load (std::memory_order_relaxed);
+        _sequence.store (sequence + 1, std::memory_order_relaxed);    // odd: write in progress
+        std::atomic_thread_fence (std::memory_order_release);
+        std::memcpy (static_cast<void *> (&_value), &value, sizeof (T));
+        _sequence.store (sequence + 2, std::memory_order_release);
+    }
+    T load () const {
+        T value;
+        for (;;) {
+            const uint32_t sequence = _sequence.load (std::memory_order_acquire);
+            if ((sequence & 1) == 0) {
+                std::memcpy (static_cast<void *> (&value), &_value, sizeof (T));
+                std::atomic_thread_fence (std::memory_order_acquire);
+                if (_sequence.load (std::memory_order_relaxed) == sequence)
+                    return value;
+            }
+            std::this_thread::yield ();    // in case we preempted the writer
+        }
+    }
+    uint32_t version () const {
+        return _sequence.load (std::memory_order_acquire) >> 1;
+    }
+};
+
+// samples from unrelated sources on one monotonic (millis) timeline, in a fixed ring that overwrites the oldest;
+// samples may be pushed with their own (earlier) measurement time, so queries scan rather than assume order; times are
+// only ever compared as differences, so all is well across the millis () wrap as long as the ring spans less than half
+template <size_t CAPACITY, typename Channel = uint8_t>
+class TimelineConcurrentSafe {
+public:
+    struct Sample {
+        interval_t time;
+        Channel channel;
+        float value;
+    };
+
+private:
+    using offset_t = std::make_signed_t<interval_t>;
+    static inline offset_t offset (const interval_t time, const interval_t reference) {    // negative if before
+        return static_cast<offset_t> (time - reference);
+    }
+
+    std::array<Sample, CAPACITY> _samples;
+    size_t _next = 0, _size = 0;
+    counter_t _pushed = 0;
+    mutable std::mutex _mutex;
+
+    // latest at or before, earliest at or after
+    void bracket (const Channel channel, const interval_t time, const Sample **before, const Sample **after) const {
+        *before = nullptr, *after = nullptr;
+        for (size_t i = 0; i < _size; i++) {
+            const Sample &sample = _samples [i];
+            if (sample.channel != channel)
+                continue;
+            const offset_t relative = offset (sample.time, time);
+            if (relative <= 0 && (*before == nullptr || relative > offset ((*before)->time, time)))
+                *before = &sample;
+            if (relative >= 0 && (*after == nullptr || relative < offset ((*after)->time, time)))
+                *after = &sample;
+        }
+    }
+
+public:
+    void push (const Channel channel, const float value, const interval_t time = millis ()) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _samples [_next] = { time, channel, value };
+        _next = (_next + 1) % CAPACITY, _size = std::min (_size + 1, CAPACITY);
+        _pushed++;
+    }
+    bool latest (const Channel channel, Sample *sample) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        const Sample *before, *after;
+        bracket (channel, millis (), &before, &after);
+        if (before == nullptr)
+            return false;
+        *sample = *before;
+        return true;
+    }
+    // the sample nearest in time, if within limit
+    bool aligned (const Channel channel, const interval_t time, Sample *sample, const interval_t limit) const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        const Sample *before, *after;
+        bracket (channel, time, &before, &after);
+        const Sample *nearest = (before == nullptr) ? after : (after == nullptr) ? before : ((time - before->time) <= (after->time - time) ? before : after);
+        if (nearest == nullptr || static_cast<interval_t> (std::abs (offset (nearest->time, time))) > limit)
+            return false;
+        *sample = *nearest;
+        return true;
+    }
+    size_t size () const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return _size;
+    }
+    counter_t pushed () const {
+        std::lock_guard<std::mutex> guard (_mutex);
+        return _pushed;
+    }
+    interval_t span () const {    // oldest to newest
+        std::lock_guard<std::mutex> guard (_mutex);
+        if (_size == 0)
+            return 0;
+        const interval_t now = millis ();
+        const auto [oldest, newest] = std::minmax_element (_samples.begin (), _samples.begin () + _size, [now] (const Sample &a, const Sample &b) { return offset (a.time, now) < offset (b.time, now); });
+        return newest->time - oldest->time;
+    }
+};
+
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
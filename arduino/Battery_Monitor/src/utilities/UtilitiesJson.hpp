@@ -7,8 +7,26 @@
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
 
+#include <cmath>
+#include <vector>
+
+// the same document, as text or as MessagePack (the binary form of the same model, about half the size, with
+// floats as 4 bytes rather than 5 or 6 characters), chosen by each sink, the first byte tells them apart ('{' vs 0x8n/0xde)
+enum class JsonEncoding : uint8_t {
+    Text,
+    MsgPack
+};
+JsonEncoding JsonEncodingFromString (const char *format) {
+    return (format != nullptr && strcmp (format, "msgpack") == 0) ? JsonEncoding::MsgPack : JsonEncoding::Text;
+}
+const char *JsonEncodingToString (const JsonEncoding encoding) {
+    return encoding == JsonEncoding::MsgPack ? "msgpack" : "json";
+}
+
 class JsonCollector {
     JsonDocument doc;
+    mutable String _text;    // each encoding serialised once, on first use
+    mutable std::vector<uint8_t> _packed;
 
 public:
     explicit JsonCollector (const String &type, const String &time, const String &addr) {
@@ -16,143 +34,33 @@ public:
         doc ["time"] = time;
         doc ["addr"] = addr;
     }
+    explicit JsonCollector (JsonDocument &&document) :
+        doc (std::move (document)) { }
     inline JsonDocument &document () {
         return doc;
     }
-    operator String () const {
-        String output;
-        serializeJson (doc, output);
-        return output;
+    inline const JsonDocument &document () const {
+        return doc;
     }
-};
-
-// -----------------------------------------------------------------------------------------------
-// -----------------------------------------------------------------------------------------------
-
-namespace JsonFunctions {
-int findValueKey (const String &json, const String &key) {
-    return (json.isEmpty () || key.isEmpty ()) ? -1 : json.indexOf ("\"" + key + "\":");
-}
-int findValueStart (const String &json, const int keyPos) {
-    int valueStart = json.indexOf (":", keyPos);
-    if (valueStart != -1)
-        do
-            valueStart++;
-        while (valueStart < json.length () && isSpace (json.charAt (valueStart)));
-    return valueStart;
-}
-int findValueEnd (const String &json, const int valueStart) {
-    int valueEnd;
-    if (valueStart >= json.length ())
-        return -1;
-    if (json.charAt (valueStart) == '"') {
-        valueEnd = json.indexOf ("\"", valueStart + 1);
-        while (valueEnd > 0 && json.charAt (valueEnd - 1) == '\\')
-            valueEnd = json.indexOf ("\"", valueEnd + 1);
-        if (valueEnd >= 0)
-            valueEnd++;
-    } else {
-        const int commaPos = json.indexOf (",", valueStart), bracePos = json.indexOf ("}", valueStart);
-        if (commaPos == -1)
-            valueEnd = bracePos;
-        else if (bracePos == -1)
-            valueEnd = commaPos;
-        else
-            valueEnd = min (commaPos, bracePos);
+    const String &text () const {
+        if (_text.isEmpty ())
+            serializeJson (doc, _text);
+        return _text;
     }
-    return valueEnd;
-}
-int findValue (const String &json, const String &key, String &value) {
-    const int keyPos = findValueKey (json, key);
-    if (keyPos >= 0) {
-        const int valueStart = findValueStart (json, keyPos);
-        if (valueStart >= 0) {
-            const int valueEnd = findValueEnd (json, valueStart);
-            if (valueEnd >= 0) {
-                value = json.substring (valueStart, valueEnd);
-                return value.length ();
-            }
+    const std::vector<uint8_t> &packed () const {
+        if (_packed.empty ()) {
+            _packed.resize (measureMsgPack (doc));
+            serializeMsgPack (doc, _packed.data (), _packed.size ());
         }
+        return _packed;
     }
-    return -1;
-}
-int findNextElement (const String &json, const int startPos, String &element) {
-    int braceCount = 0;
-    bool inQuotes = false;
-    for (int i = startPos, j = startPos; i < json.length (); i++) {
-        const char c = json.charAt (i);
-        if (c == '"' && (i == startPos || json.charAt (i - 1) != '\\'))
-            inQuotes = ! inQuotes;
-        else if (! inQuotes) {
-            if (c == '{' || c == '[') {
-                braceCount++;
-            } else if (c == '}' || c == ']') {
-                braceCount--;
-                if (braceCount == 0) {
-                    element = json.substring (j, i + 1);
-                    return i + 1;
-                }
-            } else if (c == ',') {
-                if (i == j)
-                    j++;
-                if (i != startPos && braceCount == 0) {
-                    element = json.substring (j, i + 1);
-                    return i + 1;
-                }
-            }
-        }
+    size_t size (const JsonEncoding encoding) const {    // measured, rather than serialised, if not already
+        if (encoding == JsonEncoding::MsgPack)
+            return _packed.empty () ? measureMsgPack (doc) : _packed.size ();
+        return _text.isEmpty () ? measureJson (doc) : _text.length ();
     }
-    return -1;
-}
-}    // namespace JsonFunctions
-
-// -----------------------------------------------------------------------------------------------
-// -----------------------------------------------------------------------------------------------
-
-#include <vector>
-
-class JsonSplitter {
-    const int splitLength;
-    const std::vector<String> commonElements;
-
-public:
-    JsonSplitter (const int splitLength, const std::vector<String> &commonElements) :
-        splitLength (splitLength),
-        commonElements (commonElements) { }
-
-    void splitJson (const String &json, const std::function<void (const String &, const int)> callback) {
-        String common;
-        for (const auto &commonElement : commonElements) {
-            String value;
-            if (JsonFunctions::findValue (json, commonElement, value) >= 0) {
-                if (! common.isEmpty ())
-                    common += ",";
-                common += "\"" + commonElement + "\":" + value;
-            }
-        }
-        if (common.length () > 0)
-            common += ',';
-        String current, element;
-        int numbers = 0;
-        for (int cur = 1, nxt = 0; (nxt = JsonFunctions::findNextElement (json, cur, element)) > 0; cur = nxt) {
-            if (std::any_of (commonElements.begin (), commonElements.end (), [&element] (const String &commonElement) {
-                    return element.startsWith ("\"" + commonElement + "\":");
-                }))
-                continue;
-            if ((1 + common.length ()) + current.length () + (element.length () + 1) < splitLength) {    // +1 for the comma or brace
-                if (! current.isEmpty ())
-                    current += ",";
-                current += element;
-                numbers++;
-            } else {
-                if (! current.isEmpty ())
-                    callback ("{" + common + current + "}", numbers);
-                current = element;
-                numbers = 1;
-            }
-        }
-        if (! current.isEmpty ())
-            callback ("{" + common + current + "}", numbers);
+    operator String () const {
+        return text ();
     }
 };
 
@@ -192,6 +100,19 @@ bool convertToJson (const PidController<T> &src, JsonVariant dst) {
     }
     return true;
 }
+template <typename T>
+bool convertToJson (const MpcController<T> &src, JsonVariant dst) {
+    dst ["C"] = src.config.HEAT_CAPACITY;
+    dst ["kAmb"] = src.config.COUPLING_AMBIENT;
+    dst ["kFan"] = src.config.COUPLING_FAN;
+    if (src._t > 0) {
+        dst ["q"] = src._q;
+        dst ["u"] = src._u;
+        dst ["c"] = src._c;
+        dst ["t"] = src._t;
+    }
+    return true;
+}
 bool convertToJson (const ActivationTrackerWithDetail &src, JsonVariant dst) {
     if (dst ["count"] = src.count () > 0) {
         dst ["last"] = src.seconds ();
@@ -220,5 +141,255 @@ bool convertToJson (const JsonSerializable &src, JsonVariant dst) {
     return true;
 }
 
+// -----------------------------------------------------------------------------------------------
+
+// keyframe plus delta frames for one receiver: a keyframe is the full document, a delta carries only the members that
+// moved beyond their threshold against what the receiver holds (the last keyframe with the deltas since applied),
+// changed array elements as {"index": value}, and null for removed members; every frame has "seq", keyframes also
+// "key": true, so a receiver seeing a gap drops deltas until it has asked for and received a keyframe; the reference
+// only advances once the frame is known to have gone (commit), so a failed send does not open a gap
+
+class JsonDelta : public JsonSerializable {
+public:
+    typedef struct {
+        bool enabled;
+        counter_t keyframeInterval;                          // frames, between forced keyframes
+        float threshold;                                     // default, on numbers
+        std::vector<std::pair<String, float>> thresholds;    // by member name, inherited by everything beneath it
+    } Config;
+
+private:
+    const Config &config;
+
+    JsonDocument _reference, _pending;
+    bool _referenced = false, _pendingKey = false, _keyframeWanted = true;
+    uint32_t _sequence = 0;
+    counter_t _sinceKeyframe = 0, _keyframes = 0, _deltas = 0, _requests = 0;
+    uint64_t _bytesFull = 0, _bytesSent = 0;
+
+    static bool header (const char *name) {
+        return strcmp (name, "type") == 0 || strcmp (name, "time") == 0 || strcmp (name, "addr") == 0;
+    }
+    static bool structured (const JsonVariantConst value) {
+        return value.is<JsonObjectConst> () || value.is<JsonArrayConst> ();
+    }
+    float threshold (const char *name, const float inherited) const {
+        if (! std::isnan (inherited))
+            return inherited;
+        for (const auto &[key, value] : config.thresholds)
+            if (key == name)
+                return value;
+        return NAN;
+    }
+    static bool differs (const JsonVariantConst current, const JsonVariantConst reference, const float limit) {
+        if (current.is<bool> () || reference.is<bool> ())
+            return ! (current.is<bool> () && reference.is<bool> () && current.as<bool> () == reference.as<bool> ());
+        if (current.is<double> () && reference.is<double> ())
+            return limit > 0.0f ? std::fabs (current.as<double> () - reference.as<double> ()) > limit : current.as<double> () != reference.as<double> ();
+        if (current.is<const char *> () && reference.is<const char *> ())
+            return strcmp (current.as<const char *> (), reference.as<const char *> ()) != 0;
+        return ! (current.isNull () && reference.isNull ());
+    }
+    // what moved from reference to current, into out; false if nothing did
+    bool diff (const JsonVariantConst current, const JsonVariantConst reference, JsonVariant out, const float limit, const bool top = false) const {
+        if (current.is<JsonObjectConst> () && reference.is<JsonObjectConst> ()) {
+            const JsonObjectConst c = current.as<JsonObjectConst> (), r = reference.as<JsonObjectConst> ();
+            JsonObject o = out.to<JsonObject> ();
+            for (const JsonPairConst member : c)
+                if (! (top && header (member.key ().c_str ())))
+                    if (! diff (member.value (), r [member.key ()], o [member.key ()].to<JsonVariant> (), threshold (member.key ().c_str (), limit)))
+                        o.remove (member.key ());
+            for (const JsonPairConst member : r)
+                if (! (top && header (member.key ().c_str ())) && c [member.key ()].isUnbound ())
+                    o [member.key ()] = nullptr;
+            return o.size () > 0;
+        }
+        if (current.is<JsonArrayConst> () && reference.is<JsonArrayConst> () && current.size () == reference.size ()) {
+            const JsonArrayConst c = current.as<JsonArrayConst> (), r = reference.as<JsonArrayConst> ();
+            JsonObject o = out.to<JsonObject> ();
+            for (size_t i = 0; i < c.size (); i++) {
+                const String index (i);
+                if (! diff (c [i], r [i], o [index].to<JsonVariant> (), limit))
+                    o.remove (index);
+            }
+            return o.size () > 0;
+        }
+        if (reference.isUnbound () || structured (current) || structured (reference) || differs (current, reference, std::isnan (limit) ? config.threshold : limit)) {
+            out.set (current);    // new, changed shape, or moved enough
+            return true;
+        }
+        return false;
+    }
+    static void apply (JsonVariant target, const JsonVariantConst change) {    // as the receiver does
+        if (change.is<JsonObjectConst> () && target.is<JsonObject> ()) {
+            JsonObject t = target.as<JsonObject> ();
+            for (const JsonPairConst member : change.as<JsonObjectConst> ())
+                if (member.value ().isNull ())
+                    t.remove (member.key ());
+                else if (member.value ().is<JsonObjectConst> () && structured (t [member.key ()]))
+                    apply (t [member.key ()], member.value ());
+                else
+                    t [member.key ()].set (member.value ());
+        } else if (change.is<JsonObjectConst> () && target.is<JsonArray> ()) {
+            JsonArray t = target.as<JsonArray> ();
+            for (const JsonPairConst member : change.as<JsonObjectConst> ()) {
+                const size_t index = static_cast<size_t> (atoi (member.key ().c_str ()));
+                if (member.value ().is<JsonObjectConst> () && structured (t [index]))
+                    apply (t [index], member.value ());
+                else
+                    t [index].set (member.value ());
+            }
+        } else
+            target.set (change);
+    }
+
+public:
+    explicit JsonDelta (const Config &cfg) :
+        config (cfg) { }
+
+    void reset () {    // a new receiver
+        _referenced = false;
+        _keyframeWanted = true;
+    }
+    void request () {    // the receiver saw a gap
+        _keyframeWanted = true;
+        _requests++;
+    }
+    JsonDocument encode (const JsonDocument &full) {
+        const JsonObjectConst current = full.as<JsonObjectConst> ();
+        JsonDocument frame;
+        _pendingKey = _keyframeWanted || ! _referenced || (config.keyframeInterval > 0 && _sinceKeyframe >= config.keyframeInterval);
+        if (_pendingKey) {
+            _pending.set (current);
+            frame.set (current);
+            frame ["key"] = true;
+        } else {
+            for (const JsonPairConst member : current)
+                if (header (member.key ().c_str ()))
+                    frame [member.key ()].set (member.value ());
+            _pending.clear ();
+            diff (current, _reference.as<JsonObjectConst> (), _pending.to<JsonVariant> (), NAN, true);
+            for (const JsonPairConst member : _pending.as<JsonObjectConst> ())
+                frame [member.key ()].set (member.value ());
+        }
+        frame ["seq"] = _sequence;
+        _bytesFull += measureJson (full), _bytesSent += measureJson (frame);
+        return frame;
+    }
+    void commit () {    // the encoded frame went
+        if (_pendingKey) {
+            _reference = _pending;
+            _referenced = true, _keyframeWanted = false, _sinceKeyframe = 0;
+            _keyframes++;
+        } else {
+            apply (_reference.as<JsonVariant> (), _pending.as<JsonVariantConst> ());
+            _sinceKeyframe++;
+            _deltas++;
+        }
+        _sequence++;
+    }
+
+    void serialize (JsonVariant &obj) const override {
+        obj ["frames"] = _sequence;
+        obj ["keys"] = _keyframes;
+        obj ["deltas"] = _deltas;
+        if (_requests)
+            obj ["requests"] = _requests;
+        if (_bytesFull > 0)
+            obj ["ratio"] = ArithmeticToString (static_cast<float> (_bytesSent) / static_cast<float> (_bytesFull), 2);    // text sizes, sent / full
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+// what one sink gets of a frame: the members named by path ("tmp.bms.V", or "tmp.bat" for all beneath it), with
+// numbers rounded to the sink's precision (to integers at 0, smaller in MessagePack), and the headers always; the
+// paths are compiled once into a tree that each frame is copied through
+
+class JsonProfile : public JsonSerializable {
+public:
+    typedef struct {
+        std::vector<String> fields;    // dotted paths, or everything if none
+        int precision;                 // decimal places, or -1 as they are
+    } Config;
+
+private:
+    const Config &config;
+
+    JsonDocument _tree;    // an object per step, true where everything beneath goes, null for everything
+    const double _scale;
+    counter_t _frames = 0;
+    uint64_t _bytesFull = 0, _bytesSent = 0;
+
+    static void compile (JsonObject node, const String &path) {
+        const int dot = path.indexOf ('.');
+        const String step = dot < 0 ? path : path.substring (0, dot);
+        if (node [step].is<bool> ())
+            return;    // all of it already
+        if (dot < 0)
+            node [step] = true;
+        else
+            compile (node [step].is<JsonObject> () ? node [step].as<JsonObject> () : node [step].to<JsonObject> (), path.substring (dot + 1));
+    }
+    void members (const JsonObjectConst source, const JsonVariantConst tree, JsonObject target) const {
+        if (tree.is<JsonObjectConst> ()) {
+            for (const JsonPairConst step : tree.as<JsonObjectConst> ()) {
+                const JsonVariantConst value = source [step.key ()];
+                if (! value.isNull ())
+                    copy (value, step.value (), target [step.key ()].to<JsonVariant> ());
+            }
+        } else
+            for (const JsonPairConst member : source)
+                copy (member.value (), tree, target [member.key ()].to<JsonVariant> ());
+    }
+    void copy (const JsonVariantConst source, const JsonVariantConst tree, JsonVariant target) const {
+        if (source.is<JsonObjectConst> ())
+            members (source.as<JsonObjectConst> (), tree, target.to<JsonObject> ());
+        else if (source.is<JsonArrayConst> ()) {
+            JsonArray array = target.to<JsonArray> ();
+            for (const JsonVariantConst element : source.as<JsonArrayConst> ())
+                copy (element, tree, array.add<JsonVariant> ());
+        } else if (config.precision >= 0 && source.is<double> () && ! source.is<long> () && ! source.is<unsigned long> ()) {
+            const double rounded = std::round (source.as<double> () * _scale) / _scale;
+            if (config.precision == 0)
+                target.set (static_cast<long> (rounded));
+            else
+                target.set (static_cast<float> (rounded));
+        } else
+            target.set (source);
+    }
+
+public:
+    explicit JsonProfile (const Config &cfg) :
+        config (cfg),
+        _scale (std::pow (10.0, std::max (config.precision, 0))) {
+        if (! config.fields.empty ()) {
+            JsonObject root = _tree.to<JsonObject> ();
+            for (const String &field : config.fields)
+                compile (root, field);
+        }
+    }
+    JsonDocument apply (const JsonDocument &frame) {
+        const JsonObjectConst source = frame.as<JsonObjectConst> ();
+        JsonDocument profiled;
+        JsonObject target = profiled.to<JsonObject> ();
+        for (const char *name : { "type", "time", "addr" })
+            if (! source [name].isNull ())
+                target [name].set (source [name]);
+        members (source, _tree.as<JsonVariantConst> (), target);
+        _frames++;
+        _bytesFull += measureJson (frame), _bytesSent += measureJson (profiled);
+        return profiled;
+    }
+
+    void serialize (JsonVariant &obj) const override {
+        obj ["fields"] = config.fields.size ();    // 0 for all
+        obj ["precision"] = config.precision;
+        obj ["frames"] = _frames;
+        if (_bytesFull > 0)
+            obj ["ratio"] = ArithmeticToString (static_cast<float> (_bytesSent) / static_cast<float> (_bytesFull), 2);    // text sizes, profiled / full
+    }
+};
+
 // -----------------------------------------------------------------------------------------------
 // -----------------------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Daly polling benchmark: runs the real ProgramManageSerialDalyBMS / ProgramInterfaceSerialDalyBMS on the
+// host against devices presented by dalysim (or real units on usb serial adapters), in real time, and
+// reports the firmware's own diagnostics for throughput, latency, timeouts and recovery
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <DalyBMSInterface.hpp>
+#include "HostComponents.hpp"
+
+#include "utilities/Utilities.hpp"
+
+template <typename T>
+bool convertToJson (const Stats<T> &src, JsonVariant dst) {    // as per utilities/UtilitiesJson.hpp
+    dst ["cnt"] = src.cnt ();
+    if (src.cnt () > 0) {
+        dst ["avg"] = src.avg ();
+        dst ["min"] = src.min ();
+        dst ["max"] = src.max ();
+    }
+    return true;
+}
+
+#include "batterypack/BatterypackInterfaceSerialDalyBMS.hpp"
+#include "batterypack/BatterypackMechanicsChargeEstimation.hpp"
+#include "batterypack/BatterypackManageSerialDalyBMS.hpp"
+#include "batterypack/BatterypackMechanicsCellAnalytics.hpp"
+#include "batterypack/BatterypackManageCellAnalytics.hpp"
+#include "batterypack/BatterypackMechanicsResistanceEstimation.hpp"
+#include "batterypack/BatterypackManageInternalResistance.hpp"
+#include "batterypack/BatterypackMechanicsBalancingScheduler.hpp"
+#include "batterypack/BatterypackManageBalancing.hpp"
+
+#include <signal.h>
+
+// -----------------------------------------------------------------------------------------------
+
+static volatile sig_atomic_t running = 1;
+
+static void usage (const char *name) {
+    fprintf (stderr, "usage: %s --manager DEVICE [--balance DEVICE] [--seconds N] [--instant MS] [--status MS] [--diagnostics MS]\n"
+                     "          [--timeout MS] [--process MS] [--report S] [--pack-temperature C] [--fans 0|1]\n",
+             name);
+}
+
+static void report (const ProgramManageSerialDalyBMS &manager, const ProgramManageCellAnalytics &analytics, const ProgramManageInternalResistance &resistance, const ProgramManageBalancing &balancing) {
+    JsonVariant diagnostics;
+    static_cast<const Diagnosticable &> (manager).collectDiagnostics (diagnostics);
+    static_cast<const Diagnosticable &> (analytics).collectDiagnostics (diagnostics);
+    static_cast<const Diagnosticable &> (resistance).collectDiagnostics (diagnostics);
+    static_cast<const Diagnosticable &> (balancing).collectDiagnostics (diagnostics);
+    const auto instant = manager.instant ();
+    const auto status = manager.status ();
+    printf ("%.1fs: V=%.1f, I=%.1f, SOC=%.1f%% (bms %.1f%%), age=%ldms%s, cells=%d [%u..%u mV], diagnostics=%s\n", millis () / 1000.0,
+            instant.voltage, instant.current, instant.charge, instant.chargeReported, instant.age == ProgramInterfaceSerialDalyBMS::AGE_NEVER ? -1L : static_cast<long> (instant.age), instant.valid ? "" : " (stale)",
+            status.cells, status.cellVoltageMinimum, status.cellVoltageMaximum, diagnostics.serialize ().c_str ());
+    fflush (stdout);
+}
+
+int main (int argc, char *argv []) {
+    double seconds = 30.0, reportEvery = 5.0, packTemperature = 25.0;
+    bool fans = false;
+    interval_t processEvery = 5 * 1000;    // the batterypack module's intervalProcess
+    ProgramManageSerialDalyBMS::Config config = {
+        .manager = { .daly = { .manager = { .id = "manager", .capabilities = daly_bms::Capabilities::Managing + daly_bms::Capabilities::TemperatureSensing, .categories = daly_bms::Categories::All, .debugging = daly_bms::Debugging::Errors },
+                               .serialId = 1, .serialRxPin = -1, .serialTxPin = -1, .enPin = -1 },
+                     .categories = ProgramInterfaceSerialDalyBMS::CategoryAll, .TIMEOUT = 500 },
+        .balance = { .daly = { .manager = { .id = "balance", .capabilities = daly_bms::Capabilities::Balancing + daly_bms::Capabilities::TemperatureSensing, .categories = daly_bms::Categories::All, .debugging = daly_bms::Debugging::Errors },
+                               .serialId = 2, .serialRxPin = -1, .serialTxPin = -1, .enPin = -1 },
+                     .categories = ProgramInterfaceSerialDalyBMS::CategoryStatus | ProgramInterfaceSerialDalyBMS::CategoryDiagnostics, .TIMEOUT = 500 },
+        .intervalInstant = 250,
+        .intervalStatus = 1000,
+        .intervalDiagnostics = 5000,
+        .charge = { .CAPACITY = 280.0f, .EFFICIENCY = 0.99f, .CELLS = 16, .RESISTANCE = 0.02f,    // as per program/ProgramConfig.hpp
+                    .OCV = { { { 0.00f, 2.90f }, { 0.05f, 3.15f }, { 0.10f, 3.22f }, { 0.20f, 3.26f }, { 0.30f, 3.29f }, { 0.50f, 3.31f }, { 0.60f, 3.32f }, { 0.70f, 3.33f }, { 0.80f, 3.34f }, { 0.90f, 3.35f }, { 1.00f, 3.45f } } },
+                    .NOISE_PROCESS = 1e-8f, .NOISE_MEASUREMENT = 0.0025f, .REST_CURRENT = 2.0f, .REST_SECONDS = 30.0f * 60.0f, .VARIANCE_INITIAL = 0.01f },
+        .intervalChargePersist = 60 * 1000
+    };
+
+    ProgramManageBalancing::Config configBalancing = {    // as per program/ProgramConfig.hpp, but deciding more often
+        .scheduler = { .SPREAD_START = 30.0f, .SPREAD_STOP = 10.0f, .BLEED_POWER = 0.2f, .COUPLING_STILL = 2.0f, .COUPLING_FAN = 14.0f, .MARGIN = 3.0f, .PREFERENCE = 0.5f },
+        .intervalDecide = 1000,
+        .PERIOD = 10 * 1000,
+        .RESISTANCE = 0.02f,
+        .ACTUATE = true    // against dalysim, to exercise the balancing command
+    };
+    for (int i = 1; i < argc; i++) {
+        const String option = argv [i];
+        if (i + 1 >= argc) {
+            usage (argv [0]);
+            return 1;
+        }
+        const char *value = argv [++i];
+        if (option == "--manager") host::serial_devices [config.manager.daly.serialId] = value;
+        else if (option == "--balance") host::serial_devices [config.balance.daly.serialId] = value;
+        else if (option == "--seconds") seconds = atof (value);
+        else if (option == "--instant") config.intervalInstant = static_cast<interval_t> (atol (value));
+        else if (option == "--status") config.intervalStatus = static_cast<interval_t> (atol (value));
+        else if (option == "--diagnostics") config.intervalDiagnostics = static_cast<interval_t> (atol (value));
+        else if (option == "--timeout") config.manager.TIMEOUT = config.balance.TIMEOUT = static_cast<interval_t> (atol (value));
+        else if (option == "--process") processEvery = static_cast<interval_t> (atol (value));
+        else if (option == "--report") reportEvery = atof (value);
+        else if (option == "--pack-temperature") packTemperature = atof (value);
+        else if (option == "--fans") fans = atoi (value) != 0;
+        else {
+            usage (argv [0]);
+            return 1;
+        }
+    }
+    if (host::serial_devices.find (config.manager.daly.serialId) == host::serial_devices.end ()) {
+        usage (argv [0]);
+        return 1;
+    }
+
+    signal (SIGINT, [] (int) { running = 0; });
+    host::clock_real = true;
+    RandomNumber::seed (static_cast<unsigned long> (time (nullptr)));
+
+    const ProgramManageCellAnalytics::Config configAnalytics = { .analytics = { .DRIFT_ALPHA = 0.05f } };
+    ProgramManageSerialDalyBMS manager (config);
+    const ProgramManageInternalResistance::Config configResistance = {    // step windows scaled to the polling intervals given
+        .pack = { .STEP_CURRENT = 10.0f, .STEP_SECONDS = 2.5f * config.intervalInstant / 1000.0f, .RESISTANCE_MAXIMUM = 0.2f, .FORGETTING = 0.995f, .ACTIVATION = 3000.0f, .VARIANCE_INITIAL = 1.0f },
+        .cell = { .STEP_CURRENT = 10.0f, .STEP_SECONDS = 2.5f * config.intervalDiagnostics / 1000.0f, .RESISTANCE_MAXIMUM = 0.02f, .FORGETTING = 0.99f, .ACTIVATION = 3000.0f, .VARIANCE_INITIAL = 1.0f },
+        .CELL_CURRENT_DRIFT = 2.0f
+    };
+    ProgramManageCellAnalytics analytics (configAnalytics, manager);
+    ProgramManageInternalResistance resistance (configResistance, manager);
+    ProgramManageBalancing balancing (configBalancing, manager, resistance, [&] () {
+        return ProgramManageBalancing::Thermal { .temperature = static_cast<float> (packTemperature), .cool = 25.0f, .warning = 35.0f, .fans = fans };
+    });
+    manager.begin (), analytics.begin (), resistance.begin (), balancing.begin ();
+    Intervalable intervalReport (static_cast<interval_t> (reportEvery * 1000.0)), intervalProcess (processEvery);
+    bool reported = false;    // on the last pass, so the final report isn't printed twice
+    while (running && millis () < static_cast<interval_t> (seconds * 1000.0)) {
+        intervalProcess.wait ();
+        manager.process (), analytics.process (), resistance.process (), balancing.process ();
+        if ((reported = intervalReport))
+            report (manager, analytics, resistance, balancing);
+    }
+    if (! reported)
+        report (manager, analytics, resistance, balancing);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,356 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// Daly BMS emulator: presents one or more units on pseudo-terminals, answering the 0x90 - 0x98 requests
+// in the same 13 byte frame format as the real units, with configurable cells, current profile, response
+// latency, line rate, dropped responses and corrupted checksums
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------------------------
+
+struct Options {
+    int units = 2, cells = 16, sensors = 2;
+    double cellVoltage = 3.300, cellSpread = 0.015, cellResistance = 0.0008;    // V, V, ohm
+    std::string profile = "sine";                                               // constant, sine, step
+    double current = 40.0, period = 60.0;                                       // A (positive is charging), s
+    double capacity = 280.0, charge = 60.0;                                     // Ah, %
+    double latency = 20.0, jitter = 10.0;                                       // ms
+    int baud = 9600;                                                            // 0 for unlimited
+    double drop = 0.0, corrupt = 0.0;                                           // probabilities per response frame
+    std::string link;                                                           // symlink prefix for the slave devices
+    unsigned seed = 1;
+    bool verbose = false;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static double now () {
+    static const auto start = std::chrono::steady_clock::now ();
+    return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+// -----------------------------------------------------------------------------------------------
+
+class Unit {
+public:
+    static constexpr size_t FRAME_SIZE = 13;
+    using Frame = std::array<uint8_t, FRAME_SIZE>;
+
+private:
+    const Options &_options;
+    const int _index;
+    int _master = -1;
+    std::string _slave;
+    std::vector<uint8_t> _input;
+    std::vector<double> _cellOffsets;
+    double _charge, _updated = 0.0;
+
+    struct Pending {
+        double at;
+        Frame frame;
+        bool operator> (const Pending &other) const { return at > other.at; }
+    };
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> _pending;
+    double _lineFree = 0.0;
+
+public:
+    unsigned long requests = 0, responses = 0, dropped = 0, corrupted = 0, rejected = 0;
+
+private:
+    static uint8_t checksum (const Frame &frame) {
+        uint8_t sum = 0;
+        for (size_t i = 0; i < FRAME_SIZE - 1; i++)
+            sum += frame [i];
+        return sum;
+    }
+    double current (const double t) const {
+        if (_options.profile == "constant")
+            return _options.current;
+        if (_options.profile == "step")
+            return std::fmod (t, _options.period) < _options.period / 2.0 ? _options.current : -_options.current;
+        return _options.current * std::sin (2.0 * M_PI * t / _options.period);
+    }
+    void update (const double t) {
+        _charge = std::clamp (_charge + current (t) * (t - _updated) / 3600.0 / _options.capacity * 100.0, 0.0, 100.0);
+        _updated = t;
+    }
+    uint16_t cellVoltage (const int cell, const double t) const {
+        const double ocv = _options.cellVoltage + 0.002 * (_charge - 50.0);
+        return static_cast<uint16_t> (std::lround ((ocv + _cellOffsets [cell] + current (t) * _options.cellResistance) * 1000.0));
+    }
+    static uint8_t temperature (const double celsius) {
+        return static_cast<uint8_t> (std::clamp (std::lround (celsius + 40.0), 0L, 255L));
+    }
+    double sensorTemperature (const int sensor, const double t) const {
+        return 25.0 + 0.05 * std::abs (current (t)) + sensor * 0.5;
+    }
+
+    std::vector<Frame> respond (const uint8_t command, const uint8_t *request, const double t) {
+        std::vector<Frame> frames;
+        const auto frame = [&] (std::initializer_list<uint8_t> data) {
+            Frame f = { 0xA5, 0x01, command, 0x08 };
+            std::copy (data.begin (), data.end (), f.begin () + 4);
+            frames.push_back (f);
+        };
+        const auto hi = [] (const int v) { return static_cast<uint8_t> ((v >> 8) & 0xFF); };
+        const auto lo = [] (const int v) { return static_cast<uint8_t> (v & 0xFF); };
+        update (t);
+        int minCell = 0, maxCell = 0;
+        for (int cell = 1; cell < _options.cells; cell++) {
+            if (cellVoltage (cell, t) < cellVoltage (minCell, t))
+                minCell = cell;
+            if (cellVoltage (cell, t) > cellVoltage (maxCell, t))
+                maxCell = cell;
+        }
+        switch (command) {
+        case 0x90 : {
+            int total = 0;
+            for (int cell = 0; cell < _options.cells; cell++)
+                total += cellVoltage (cell, t);
+            const int voltage = total / 100, amps = static_cast<int> (std::lround (current (t) * 10.0)) + 30000, soc = static_cast<int> (std::lround (_charge * 10.0));
+            frame ({ hi (voltage), lo (voltage), hi (voltage), lo (voltage), hi (amps), lo (amps), hi (soc), lo (soc) });
+            break;
+        }
+        case 0x91 :
+            frame ({ hi (cellVoltage (maxCell, t)), lo (cellVoltage (maxCell, t)), static_cast<uint8_t> (maxCell + 1), hi (cellVoltage (minCell, t)), lo (cellVoltage (minCell, t)), static_cast<uint8_t> (minCell + 1), 0, 0 });
+            break;
+        case 0x92 :
+            frame ({ temperature (sensorTemperature (_options.sensors - 1, t)), static_cast<uint8_t> (_options.sensors), temperature (sensorTemperature (0, t)), 1, 0, 0, 0, 0 });
+            break;
+        case 0x93 : {
+            const uint32_t residual = static_cast<uint32_t> (_options.capacity * _charge / 100.0 * 1000.0);
+            frame ({ static_cast<uint8_t> (current (t) > 0.5 ? 1 : current (t) < -0.5 ? 2 : 0), 1, 1, 0, static_cast<uint8_t> (residual >> 24), static_cast<uint8_t> (residual >> 16), static_cast<uint8_t> (residual >> 8), static_cast<uint8_t> (residual) });
+            break;
+        }
+        case 0x94 :
+            frame ({ static_cast<uint8_t> (_options.cells), static_cast<uint8_t> (_options.sensors), static_cast<uint8_t> (current (t) > 0.5), static_cast<uint8_t> (current (t) < -0.5), 0, 0, 42, 0 });
+            break;
+        case 0x95 :
+            for (int group = 0; group * 3 < _options.cells; group++) {
+                std::array<uint8_t, 8> data = { static_cast<uint8_t> (group + 1) };
+                for (int i = 0; i < 3 && group * 3 + i < _options.cells; i++)
+                    data [1 + i * 2] = hi (cellVoltage (group * 3 + i, t)), data [2 + i * 2] = lo (cellVoltage (group * 3 + i, t));
+                frame ({ data [0], data [1], data [2], data [3], data [4], data [5], data [6], data [7] });
+            }
+            break;
+        case 0x96 :
+            for (int group = 0; group * 7 < _options.sensors; group++) {
+                std::array<uint8_t, 8> data = { static_cast<uint8_t> (group + 1) };
+                for (int i = 0; i < 7 && group * 7 + i < _options.sensors; i++)
+                    data [1 + i] = temperature (sensorTemperature (group * 7 + i, t));
+                frame ({ data [0], data [1], data [2], data [3], data [4], data [5], data [6], data [7] });
+            }
+            break;
+        case 0x97 :
+            frame ({ static_cast<uint8_t> (1 << (maxCell % 8)), 0, 0, 0, 0, 0, 0, 0 });
+            break;
+        case 0x98 :
+            frame ({ 0, 0, 0, 0, 0, 0, 0, 0 });
+            break;
+        default :    // settings writes: acknowledged with an echo
+            frame ({ request [0], request [1], request [2], request [3], request [4], request [5], request [6], request [7] });
+            if (_options.verbose)
+                printf ("unit %d: write 0x%02x [%02x %02x %02x %02x %02x %02x %02x %02x]\n", _index, command, request [0], request [1], request [2], request [3], request [4], request [5], request [6], request [7]);
+            break;
+        }
+        for (auto &f : frames)
+            f [FRAME_SIZE - 1] = checksum (f);
+        return frames;
+    }
+
+public:
+    Unit (const Options &options, const int index, std::mt19937 &random) :
+        _options (options),
+        _index (index),
+        _charge (options.charge) {
+        std::uniform_real_distribution<double> spread (-options.cellSpread, options.cellSpread);
+        for (int cell = 0; cell < options.cells; cell++)
+            _cellOffsets.push_back (spread (random));
+    }
+    bool open () {
+        if ((_master = posix_openpt (O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0 || grantpt (_master) != 0 || unlockpt (_master) != 0)
+            return false;
+        _slave = ptsname (_master);
+        struct termios tio;
+        if (tcgetattr (_master, &tio) == 0)
+            cfmakeraw (&tio), tcsetattr (_master, TCSANOW, &tio);
+        if (! _options.link.empty ()) {
+            const std::string link = _options.link + std::to_string (_index);
+            unlink (link.c_str ());
+            if (symlink (_slave.c_str (), link.c_str ()) == 0)
+                _slave = link + " -> " + _slave;
+        }
+        return true;
+    }
+    void close () {
+        if (! _options.link.empty ())
+            unlink ((_options.link + std::to_string (_index)).c_str ());
+        if (_master >= 0)
+            ::close (_master), _master = -1;
+    }
+    int fd () const {
+        return _master;
+    }
+    const std::string &slave () const {
+        return _slave;
+    }
+    double next () const {
+        return _pending.empty () ? -1.0 : _pending.top ().at;
+    }
+
+    void receive (std::mt19937 &random) {
+        uint8_t buffer [256];
+        const ssize_t length = ::read (_master, buffer, sizeof (buffer));
+        if (length <= 0)
+            return;
+        std::uniform_real_distribution<double> uniform (0.0, 1.0);
+        for (ssize_t i = 0; i < length; i++) {
+            _input.push_back (buffer [i]);
+            if (_input.size () == 1 && _input [0] != 0xA5) {
+                _input.clear ();
+                continue;
+            }
+            if (_input.size () < FRAME_SIZE)
+                continue;
+            Frame request;
+            std::copy (_input.begin (), _input.end (), request.begin ());
+            _input.clear ();
+            requests++;
+            if (request [1] != 0x40 || request [3] != 0x08 || request [FRAME_SIZE - 1] != checksum (request)) {
+                rejected++;
+                continue;
+            }
+            const double t = now ();
+            double at = std::max (t + (_options.latency + _options.jitter * uniform (random)) / 1000.0, _lineFree);
+            for (auto &response : respond (request [2], &request [4], t)) {
+                if (uniform (random) < _options.drop) {
+                    dropped++;
+                    continue;
+                }
+                if (uniform (random) < _options.corrupt)
+                    response [FRAME_SIZE - 1] ^= 0x5A, corrupted++;
+                if (_options.baud > 0)
+                    at += static_cast<double> (FRAME_SIZE * 10) / _options.baud;    // 8N1, so 10 bits per byte
+                _pending.push ({ at, response });
+            }
+            _lineFree = at;
+            if (_options.verbose)
+                printf ("unit %d: request 0x%02x\n", _index, request [2]);
+        }
+    }
+    void transmit () {
+        const double t = now ();
+        while (! _pending.empty () && _pending.top ().at <= t) {
+            if (::write (_master, _pending.top ().frame.data (), FRAME_SIZE) == static_cast<ssize_t> (FRAME_SIZE))
+                responses++;
+            _pending.pop ();
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+static void usage (const char *name) {
+    fprintf (stderr, "usage: %s [--units N] [--cells N] [--sensors N] [--cell-voltage V] [--cell-spread V] [--cell-resistance R]\n"
+                     "          [--profile constant|sine|step] [--current A] [--period S] [--capacity Ah] [--charge %%]\n"
+                     "          [--latency MS] [--jitter MS] [--baud N] [--drop P] [--corrupt P] [--link PREFIX] [--seed N] [--verbose 1]\n",
+             name);
+}
+
+int main (int argc, char *argv []) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const std::string option = argv [i];
+        if (i + 1 >= argc) {
+            usage (argv [0]);
+            return 1;
+        }
+        const char *value = argv [++i];
+        if (option == "--units") options.units = atoi (value);
+        else if (option == "--cells") options.cells = std::clamp (atoi (value), 1, 48);
+        else if (option == "--sensors") options.sensors = std::clamp (atoi (value), 1, 16);
+        else if (option == "--cell-voltage") options.cellVoltage = atof (value);
+        else if (option == "--cell-spread") options.cellSpread = atof (value);
+        else if (option == "--cell-resistance") options.cellResistance = atof (value);
+        else if (option == "--profile") options.profile = value;
+        else if (option == "--current") options.current = atof (value);
+        else if (option == "--period") options.period = atof (value);
+        else if (option == "--capacity") options.capacity = atof (value);
+        else if (option == "--charge") options.charge = atof (value);
+        else if (option == "--latency") options.latency = atof (value);
+        else if (option == "--jitter") options.jitter = atof (value);
+        else if (option == "--baud") options.baud = atoi (value);
+        else if (option == "--drop") options.drop = atof (value);
+        else if (option == "--corrupt") options.corrupt = atof (value);
+        else if (option == "--link") options.link = value;
+        else if (option == "--seed") options.seed = static_cast<unsigned> (atoi (value));
+        else if (option == "--verbose") options.verbose = atoi (value) != 0;
+        else {
+            usage (argv [0]);
+            return 1;
+        }
+    }
+
+    signal (SIGINT, [] (int) { running = 0; });
+    signal (SIGTERM, [] (int) { running = 0; });
+
+    std::mt19937 random (options.seed);
+    std::vector<Unit> units;
+    for (int index = 0; index < options.units; index++)
+        units.emplace_back (options, index, random);
+    for (auto &unit : units) {
+        if (! unit.open ()) {
+            perror ("posix_openpt");
+            return 1;
+        }
+        printf ("unit: %s\n", unit.slave ().c_str ());
+    }
+    fflush (stdout);
+
+    std::vector<struct pollfd> pfds;
+    for (const auto &unit : units)
+        pfds.push_back ({ .fd = unit.fd (), .events = POLLIN, .revents = 0 });
+    while (running) {
+        double wait = 0.1;
+        for (const auto &unit : units)
+            if (unit.next () >= 0.0)
+                wait = std::min (wait, std::max (0.0, unit.next () - now ()));
+        if (poll (pfds.data (), pfds.size (), static_cast<int> (std::ceil (wait * 1000.0))) < 0)
+            continue;
+        for (size_t i = 0; i < units.size (); i++) {
+            if (pfds [i].revents & POLLIN)
+                units [i].receive (random);
+            else if (pfds [i].revents & POLLHUP)
+                usleep (10000);    // no client attached
+            units [i].transmit ();
+        }
+    }
+
+    for (auto &unit : units) {
+        printf ("unit: %s, requests=%lu, responses=%lu, rejected=%lu, dropped=%lu, corrupted=%lu\n", unit.slave ().c_str (), unit.requests, unit.responses, unit.rejected, unit.dropped, unit.corrupted);
+        unit.close ();
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
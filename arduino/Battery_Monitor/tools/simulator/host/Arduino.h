@@ -0,0 +1,100 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// host shim: just enough of the Arduino core for the firmware headers used by the simulator, with a
+// simulated clock so that millis () based logic (PidController, Intervalable, etc) runs in simulated time
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define DEBUG_PRINTF(...) \
+    do { \
+    } while (0)
+
+class String : public std::string {
+public:
+    String () { }
+    String (const char *s) :
+        std::string (s ? s : "") { }
+    String (const std::string &s) :
+        std::string (s) { }
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    explicit String (const T v) :
+        std::string (std::to_string (v)) { }
+    bool isEmpty () const { return empty (); }
+    int indexOf (const char c, const int from = 0) const {
+        const auto p = find (c, from);
+        return p == npos ? -1 : static_cast<int> (p);
+    }
+    String substring (const int a, const int b = -1) const { return String (substr (a, b < 0 ? npos : b - a)); }
+    bool startsWith (const String &s) const { return rfind (s, 0) == 0; }
+    long toInt () const { return atol (c_str ()); }
+    float toFloat () const { return static_cast<float> (atof (c_str ())); }
+    String operator+ (const String &o) const { return String (static_cast<const std::string &> (*this) + static_cast<const std::string &> (o)); }
+    String operator+ (const char *o) const { return String (static_cast<const std::string &> (*this) + o); }
+};
+inline String operator+ (const char *a, const String &b) { return String (std::string (a) + static_cast<const std::string &> (b)); }
+
+namespace host {
+inline unsigned long clock_ms = 0;
+inline bool clock_real = false;    // wall clock, for running against real i/o
+inline const std::chrono::steady_clock::time_point clock_start = std::chrono::steady_clock::now ();
+inline void advance (const unsigned long ms) { clock_ms += ms; }
+}    // namespace host
+
+inline unsigned long micros () {
+    if (host::clock_real)
+        return static_cast<unsigned long> (std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - host::clock_start).count ());
+    return host::clock_ms * 1000UL;
+}
+inline unsigned long millis () {
+    if (host::clock_real)
+        return micros () / 1000UL;
+    return host::clock_ms;
+}
+inline void delay (const unsigned long ms) {
+    if (host::clock_real)
+        std::this_thread::sleep_for (std::chrono::milliseconds (ms));
+    else
+        host::advance (ms);
+}
+
+#define RTC_NOINIT_ATTR
+
+#define OUTPUT 0x03
+#define HIGH 0x1
+#define LOW 0x0
+inline void pinMode (const int, const int) { }
+inline void digitalWrite (const int, const int) { }
+
+inline char *ltoa (const long v, char *s, const int) {
+    sprintf (s, "%ld", v);
+    return s;
+}
+inline char *dtostrf (const double v, const int, const int p, char *s) {
+    sprintf (s, "%.*f", p, v);
+    return s;
+}
+inline long map (const long x, const long a, const long b, const long c, const long d) { return (x - a) * (d - c) / (b - a) + c; }
+inline long random (const long m) { return m > 0 ? rand () % m : 0; }
+inline long random (const long a, const long b) { return b > a ? a + rand () % (b - a) : a; }
+inline void randomSeed (const unsigned long s) { srand (s); }
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
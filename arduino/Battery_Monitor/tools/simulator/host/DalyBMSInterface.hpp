@@ -0,0 +1,281 @@
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// host shim: the part of DalyBMSInterface (github.com/matthewgream/DalyBMSInterface) that the firmware's
+// polling uses, over the HardwareSerial shim, so that dalybench runs the firmware's own adapter against dalysim
+
+#pragma once
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+#include <array>
+
+namespace daly_bms {
+
+enum class Capabilities : uint32_t { None = 0,
+                                     Managing = 1 << 0,
+                                     Balancing = 1 << 1,
+                                     TemperatureSensing = 1 << 2,
+                                     FirmwareIndex = 1 << 3,
+                                     RealTimeClock = 1 << 4,
+                                     All = 0x1F };
+enum class Categories : uint32_t { None = 0,
+                                   Information = 1 << 0,
+                                   Conditions = 1 << 1,
+                                   Diagnostics = 1 << 2,
+                                   Commands = 1 << 3,
+                                   All = 0x0F };
+enum class Debugging : uint32_t { None = 0,
+                                  Errors = 1 << 0,
+                                  Requests = 1 << 1,
+                                  Responses = 1 << 2,
+                                  All = 0x07 };
+
+#define DALY_BMS_FLAGS_OPERATORS(T) \
+    constexpr T operator+ (const T a, const T b) { return static_cast<T> (static_cast<uint32_t> (a) | static_cast<uint32_t> (b)); } \
+    constexpr T operator- (const T a, const T b) { return static_cast<T> (static_cast<uint32_t> (a) & ~static_cast<uint32_t> (b)); }
+DALY_BMS_FLAGS_OPERATORS (Capabilities)
+DALY_BMS_FLAGS_OPERATORS (Categories)
+DALY_BMS_FLAGS_OPERATORS (Debugging)
+#undef DALY_BMS_FLAGS_OPERATORS
+
+// -----------------------------------------------------------------------------------------------
+
+class Interface;
+
+class RequestResponse {
+    friend class Interface;
+
+public:
+    using Data = std::array<uint8_t, 8>;
+
+private:
+    const uint8_t _command;
+    const Capabilities _requires;
+    unsigned long _time = 0;
+
+protected:
+    static inline uint16_t u16 (const uint8_t *data) { return static_cast<uint16_t> ((data [0] << 8) | data [1]); }
+    static inline uint32_t u32 (const uint8_t *data) { return (static_cast<uint32_t> (u16 (&data [0])) << 16) | u16 (&data [2]); }
+    static inline int8_t temperature (const uint8_t value) { return static_cast<int8_t> (static_cast<int> (value) - 40); }
+    virtual void prepare (Data &) const { }
+    virtual void decode (const uint8_t *data) = 0;
+
+public:
+    explicit RequestResponse (const uint8_t command, const Capabilities capability = Capabilities::None) :
+        _command (command),
+        _requires (capability) { }
+    virtual ~RequestResponse () = default;
+    uint8_t getCommand () const { return _command; }
+    bool isValid () const { return _time > 0; }
+    unsigned long time () const { return _time; }    // of the last complete response
+};
+
+struct RequestResponse_SOC : RequestResponse {
+    float voltage = 0.0f, current = 0.0f, charge = 0.0f;
+    RequestResponse_SOC () :
+        RequestResponse (0x90) { }
+    void decode (const uint8_t *data) override {
+        voltage = u16 (&data [0]) / 10.0f, current = (u16 (&data [4]) - 30000.0f) / 10.0f, charge = u16 (&data [6]) / 10.0f;
+    }
+};
+struct RequestResponse_VOLTAGE_MINMAX : RequestResponse {
+    uint16_t maximumVoltage = 0, minimumVoltage = 0;
+    uint8_t maximumCell = 0, minimumCell = 0;
+    RequestResponse_VOLTAGE_MINMAX () :
+        RequestResponse (0x91) { }
+    void decode (const uint8_t *data) override {
+        maximumVoltage = u16 (&data [0]), maximumCell = data [2], minimumVoltage = u16 (&data [3]), minimumCell = data [5];
+    }
+};
+struct RequestResponse_TEMPERATURE_MINMAX : RequestResponse {
+    int8_t maximumTemperature = 0, minimumTemperature = 0;
+    uint8_t maximumSensor = 0, minimumSensor = 0;
+    RequestResponse_TEMPERATURE_MINMAX () :
+        RequestResponse (0x92, Capabilities::TemperatureSensing) { }
+    void decode (const uint8_t *data) override {
+        maximumTemperature = temperature (data [0]), maximumSensor = data [1], minimumTemperature = temperature (data [2]), minimumSensor = data [3];
+    }
+};
+struct RequestResponse_MOSFET : RequestResponse {
+    uint8_t state = 0, lifeCycles = 0;
+    bool chargeMosfet = false, dischargeMosfet = false;
+    uint32_t residualCapacity = 0;
+    RequestResponse_MOSFET () :
+        RequestResponse (0x93) { }
+    void decode (const uint8_t *data) override {
+        state = data [0], chargeMosfet = data [1] != 0, dischargeMosfet = data [2] != 0, lifeCycles = data [3], residualCapacity = u32 (&data [4]);
+    }
+};
+struct RequestResponse_STATUS : RequestResponse {
+    uint8_t cells = 0, sensors = 0, dio = 0;
+    bool charger = false, load = false;
+    uint16_t cycles = 0;
+    RequestResponse_STATUS () :
+        RequestResponse (0x94) { }
+    void decode (const uint8_t *data) override {
+        cells = data [0], sensors = data [1], charger = data [2] != 0, load = data [3] != 0, dio = data [4], cycles = u16 (&data [5]);
+    }
+};
+struct RequestResponse_VOLTAGES : RequestResponse {
+    static constexpr size_t PER_FRAME = 3;
+    std::array<uint16_t, 48> voltages {};
+    RequestResponse_VOLTAGES () :
+        RequestResponse (0x95) { }
+    void decode (const uint8_t *data) override {
+        if (data [0] > 0)
+            for (size_t i = 0, cell = (data [0] - 1) * PER_FRAME; i < PER_FRAME && cell < voltages.size (); i++, cell++)
+                voltages [cell] = u16 (&data [1 + i * 2]);
+    }
+};
+struct RequestResponse_TEMPERATURES : RequestResponse {
+    static constexpr size_t PER_FRAME = 7;
+    std::array<int8_t, 16> temperatures {};
+    RequestResponse_TEMPERATURES () :
+        RequestResponse (0x96, Capabilities::TemperatureSensing) { }
+    void decode (const uint8_t *data) override {
+        if (data [0] > 0)
+            for (size_t i = 0, sensor = (data [0] - 1) * PER_FRAME; i < PER_FRAME && sensor < temperatures.size (); i++, sensor++)
+                temperatures [sensor] = temperature (data [1 + i]);
+    }
+};
+struct RequestResponse_BALANCES : RequestResponse {
+    std::array<uint8_t, 6> balances {};
+    RequestResponse_BALANCES () :
+        RequestResponse (0x97) { }
+    void decode (const uint8_t *data) override { std::copy (data, data + balances.size (), balances.begin ()); }
+};
+struct RequestResponse_FAILURES : RequestResponse {
+    std::array<uint8_t, 8> failures {};
+    RequestResponse_FAILURES () :
+        RequestResponse (0x98) { }
+    void decode (const uint8_t *data) override { std::copy (data, data + failures.size (), failures.begin ()); }
+};
+struct RequestResponse_BALANCING : RequestResponse {    // acknowledged with an echo
+    bool enabled = false;
+    RequestResponse_BALANCING () :
+        RequestResponse (0xE3, Capabilities::Balancing) { }
+    void setEnabled (const bool value) { enabled = value; }
+    void prepare (Data &data) const override { data [0] = enabled ? 1 : 0; }
+    void decode (const uint8_t *) override { }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+class Manager {
+public:
+    typedef struct {
+        String id;
+        Capabilities capabilities;
+        Categories categories;
+        Debugging debugging;
+    } Config;
+
+    struct {
+        RequestResponse_SOC soc;
+    } instant;
+    struct {
+        RequestResponse_STATUS status;
+        RequestResponse_VOLTAGE_MINMAX voltages;
+        RequestResponse_TEMPERATURE_MINMAX temperatures;
+        RequestResponse_MOSFET mosfet;
+    } status;
+    struct {
+        RequestResponse_VOLTAGES voltages;
+        RequestResponse_TEMPERATURES temperatures;
+        RequestResponse_BALANCES balances;
+        RequestResponse_FAILURES failures;
+    } diagnostics;
+    struct {
+        RequestResponse_BALANCING balancing;
+    } commands;
+};
+
+class Interface : public Manager {
+public:
+    typedef struct {
+        Manager::Config manager;
+        int serialId, serialRxPin, serialTxPin, enPin;
+    } Config;
+
+private:
+    static constexpr size_t FRAME_SIZE = 13, FRAME_DATA = 4;
+    static constexpr uint8_t FRAME_START = 0xA5, FRAME_ADDRESS_HOST = 0x40, FRAME_ADDRESS_BMS = 0x01;
+    using Frame = std::array<uint8_t, FRAME_SIZE>;
+
+    const Config &_config;
+    HardwareSerial _serial;
+    Frame _frame {};
+    size_t _frameOffset = 0;
+    RequestResponse *_request = nullptr;
+    size_t _framesExpected = 0, _framesReceived = 0;
+
+    static uint8_t checksum (const Frame &frame) {
+        uint8_t sum = 0;
+        for (size_t i = 0; i < FRAME_SIZE - 1; i++)
+            sum += frame [i];
+        return sum;
+    }
+    size_t frames (const RequestResponse &request) const {
+        if (&request == &diagnostics.voltages)
+            return std::max<size_t> (1, (status.status.cells + RequestResponse_VOLTAGES::PER_FRAME - 1) / RequestResponse_VOLTAGES::PER_FRAME);
+        if (&request == &diagnostics.temperatures)
+            return std::max<size_t> (1, (status.status.sensors + RequestResponse_TEMPERATURES::PER_FRAME - 1) / RequestResponse_TEMPERATURES::PER_FRAME);
+        return 1;
+    }
+    void received (const Frame &frame) {
+        if (_request == nullptr || frame [2] != _request->getCommand ())
+            return;
+        _request->decode (&frame [FRAME_DATA]);
+        if (++_framesReceived >= _framesExpected)
+            _request->_time = std::max (millis (), 1UL), _request = nullptr;
+    }
+
+public:
+    explicit Interface (const Config &config) :
+        _config (config),
+        _serial (config.serialId) { }
+    bool begin () {
+        if (_config.enPin >= 0)
+            pinMode (_config.enPin, OUTPUT), digitalWrite (_config.enPin, HIGH);
+        _serial.begin (9600, SERIAL_8N1, _config.serialRxPin, _config.serialTxPin);
+        return true;
+    }
+    void end () {
+        _serial.end ();
+    }
+    bool issue (RequestResponse &request) {    // replaces any request not yet answered
+        if ((static_cast<uint32_t> (request._requires) & ~static_cast<uint32_t> (_config.manager.capabilities)) != 0)
+            return false;
+        Frame frame = { FRAME_START, FRAME_ADDRESS_HOST, request.getCommand (), 8 };
+        RequestResponse::Data data {};
+        request.prepare (data);
+        std::copy (data.begin (), data.end (), frame.begin () + FRAME_DATA);
+        frame [FRAME_SIZE - 1] = checksum (frame);
+        _request = &request, _framesExpected = frames (request), _framesReceived = 0, _frameOffset = 0;
+        return _serial.write (frame.data (), frame.size ()) == frame.size ();
+    }
+    void process () {
+        while (_serial.available () > 0) {
+            const uint8_t byte = static_cast<uint8_t> (_serial.read ());
+            if ((_frameOffset == 0 && byte != FRAME_START) || (_frameOffset == 1 && byte != FRAME_ADDRESS_BMS)) {
+                _frameOffset = 0;
+                continue;
+            }
+            _frame [_frameOffset++] = byte;
+            if (_frameOffset == FRAME_SIZE) {
+                _frameOffset = 0;
+                if (_frame [FRAME_SIZE - 1] == checksum (_frame))
+                    received (_frame);
+                else if (static_cast<uint32_t> (_config.manager.debugging) & static_cast<uint32_t> (Debugging::Errors))
+                    fprintf (stderr, "daly_bms::Interface[%s]: checksum error, command=0x%02x\n", _config.manager.id.c_str (), _frame [2]);
+            }
+        }
+    }
+};
+
+}    // namespace daly_bms
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
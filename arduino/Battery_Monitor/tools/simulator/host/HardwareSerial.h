@@ -0,0 +1,108 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// host shim: HardwareSerial over a tty/pty device, with onReceive callbacks delivered from a reader
+// thread after a short idle gap, as the ESP32 uart event task does on its rx timeout
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define SERIAL_8N1 0x800001c
+
+namespace host {
+inline std::map<int, std::string> serial_devices;    // serialId -> device path
+}
+
+class HardwareSerial {
+public:
+    using OnReceiveCb = std::function<void (void)>;
+
+private:
+    static inline constexpr int RX_IDLE_US = 2000;
+
+    const int _id;
+    int _fd = -1;
+    std::thread _thread;
+    std::atomic<bool> _running { false };
+    std::mutex _mutex;
+    OnReceiveCb _callback;
+
+    void reader () {
+        while (_running) {
+            struct pollfd pfd = { .fd = _fd, .events = POLLIN, .revents = 0 };
+            if (poll (&pfd, 1, 50) <= 0)
+                continue;
+            if (pfd.revents & (POLLHUP | POLLERR)) {
+                std::this_thread::sleep_for (std::chrono::milliseconds (50));
+                continue;
+            }
+            usleep (RX_IDLE_US);
+            OnReceiveCb callback;
+            {
+                std::lock_guard<std::mutex> guard (_mutex);
+                callback = _callback;
+            }
+            if (callback)
+                callback ();
+            else
+                std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        }
+    }
+
+public:
+    explicit HardwareSerial (const int id) :
+        _id (id) { }
+    ~HardwareSerial () {
+        end ();
+    }
+    void begin (const unsigned long, const uint32_t, const int, const int) {
+        const auto device = host::serial_devices.find (_id);
+        if (device == host::serial_devices.end () || (_fd = open (device->second.c_str (), O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0) {
+            fprintf (stderr, "HardwareSerial[%d]: no device\n", _id);
+            return;
+        }
+        struct termios tio;
+        if (tcgetattr (_fd, &tio) == 0)
+            cfmakeraw (&tio), tcsetattr (_fd, TCSANOW, &tio);
+        _running = true;
+        _thread = std::thread (&HardwareSerial::reader, this);
+    }
+    void end () {
+        _running = false;
+        if (_thread.joinable ())
+            _thread.join ();
+        if (_fd >= 0)
+            close (_fd), _fd = -1;
+    }
+    void onReceive (OnReceiveCb function, const bool = false) {
+        std::lock_guard<std::mutex> guard (_mutex);
+        _callback = function;
+    }
+    int available () {
+        int count = 0;
+        return (_fd >= 0 && ioctl (_fd, FIONREAD, &count) == 0) ? count : 0;
+    }
+    int read () {
+        uint8_t byte;
+        return (_fd >= 0 && ::read (_fd, &byte, 1) == 1) ? byte : -1;
+    }
+    size_t write (const uint8_t *buffer, const size_t size) {
+        return (_fd >= 0 && ::write (_fd, buffer, size) == static_cast<ssize_t> (size)) ? size : 0;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,263 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// host stand-ins for the pieces of the firmware that the simulated classes depend upon but that
+// are tied to the device (ArduinoJson, NVS, the motor driver, the platform)
+
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+
+// just enough of ArduinoJson to record diagnostics and print them; types without a convertToJson are ignored,
+// and JsonObject / JsonArray are distinct from JsonVariant as they are on the device
+struct JsonNode {
+    enum Type { Null, Scalar, Object, Array } type = Null;
+    std::string scalar;
+    std::vector<std::pair<std::string, std::shared_ptr<JsonNode>>> object;
+    std::vector<std::shared_ptr<JsonNode>> array;
+    std::string serialize () const {
+        std::string result;
+        switch (type) {
+        case Null :
+            return "null";
+        case Scalar :
+            return scalar;
+        case Object :
+            for (const auto &[key, node] : object)
+                result += (result.empty () ? "" : ",") + ("\"" + key + "\":") + node->serialize ();
+            return "{" + result + "}";
+        case Array :
+            for (const auto &node : array)
+                result += (result.empty () ? "" : ",") + node->serialize ();
+            return "[" + result + "]";
+        }
+        return result;
+    }
+};
+
+class JsonVariant;
+class JsonReference {
+protected:
+    std::shared_ptr<JsonNode> _node;
+
+public:
+    explicit JsonReference (std::shared_ptr<JsonNode> node = std::make_shared<JsonNode> ()) :
+        _node (node) { }
+    JsonVariant operator[] (const std::string &key) const;
+    template <typename T>
+    bool set (const T &value);
+    template <typename T>
+    T to () const {
+        *_node = JsonNode ();
+        _node->type = std::is_same_v<T, class JsonArray> ? JsonNode::Array : std::is_same_v<T, class JsonObject> ? JsonNode::Object : JsonNode::Null;
+        return T (_node);
+    }
+    template <typename T>
+    void add (const T &value);
+    std::string serialize () const {
+        return _node->serialize ();
+    }
+};
+class JsonVariant : public JsonReference {
+public:
+    using JsonReference::JsonReference;
+    template <typename T>
+    JsonVariant &operator= (const T &value) {
+        set (value);
+        return *this;
+    }
+};
+class JsonObject : public JsonReference {
+public:
+    using JsonReference::JsonReference;
+    operator JsonVariant () const { return JsonVariant (_node); }
+};
+class JsonArray : public JsonReference {
+public:
+    using JsonReference::JsonReference;
+    operator JsonVariant () const { return JsonVariant (_node); }
+};
+
+template <typename T>
+auto convertToJsonIfAvailable (const T &value, JsonVariant dst, int) -> decltype (convertToJson (value, dst), void ()) {
+    convertToJson (value, dst);
+}
+template <typename T>
+void convertToJsonIfAvailable (const T &, JsonVariant, long) { }
+
+inline JsonVariant JsonReference::operator[] (const std::string &key) const {
+    if (_node->type != JsonNode::Object)
+        *_node = JsonNode (), _node->type = JsonNode::Object;
+    for (const auto &[name, node] : _node->object)
+        if (name == key)
+            return JsonVariant (node);
+    _node->object.emplace_back (key, std::make_shared<JsonNode> ());
+    return JsonVariant (_node->object.back ().second);
+}
+template <typename T>
+bool JsonReference::set (const T &value) {
+    if constexpr (std::is_same_v<T, bool>)
+        _node->type = JsonNode::Scalar, _node->scalar = value ? "true" : "false";
+    else if constexpr (std::is_floating_point_v<T>) {
+        char buffer [32];
+        snprintf (buffer, sizeof (buffer), "%g", static_cast<double> (value));
+        _node->type = JsonNode::Scalar, _node->scalar = buffer;
+    } else if constexpr (std::is_arithmetic_v<T>)
+        _node->type = JsonNode::Scalar, _node->scalar = std::to_string (value);
+    else if constexpr (std::is_convertible_v<T, std::string>)
+        _node->type = JsonNode::Scalar, _node->scalar = "\"" + std::string (value) + "\"";
+    else
+        convertToJsonIfAvailable (value, JsonVariant (_node), 0);
+    return true;
+}
+template <typename T>
+void JsonReference::add (const T &value) {
+    if (_node->type != JsonNode::Array)
+        *_node = JsonNode (), _node->type = JsonNode::Array;
+    _node->array.push_back (std::make_shared<JsonNode> ());
+    JsonVariant (_node->array.back ()).set (value);
+}
+class JsonSerializable {
+public:
+    virtual void serialize (JsonVariant &) const = 0;
+};
+
+class Component {
+protected:
+    ~Component () {};
+
+public:
+    typedef std::vector<Component *> List;
+    virtual void begin () { }
+    virtual void process () { }
+};
+
+class Diagnosticable {
+protected:
+    ~Diagnosticable () {};
+
+public:
+    virtual void collectDiagnostics (JsonVariant &) const = 0;
+};
+
+// -----------------------------------------------------------------------------------------------
+
+struct RandomNumber {
+    static void seed (const unsigned long seed) {
+        ::randomSeed (seed);
+    }
+    template <typename T>
+    static T get (T max) {
+        return static_cast<T> (::random (static_cast<long> (max)));
+    }
+    template <typename T>
+    static T get (T min, T max) {
+        return static_cast<T> (::random (static_cast<long> (min), static_cast<long> (max)));
+    }
+};
+
+class PersistentData {
+    static inline std::map<std::string, uint32_t> _store;
+    static inline std::map<std::string, String> _strings;
+    const std::string _space;
+
+public:
+    explicit PersistentData (const char *space) :
+        _space (space) { }
+    bool get (const char *name, uint32_t *value) const {
+        const auto it = _store.find (_space + "/" + name);
+        if (it == _store.end ())
+            return false;
+        *value = it->second;
+        return true;
+    }
+    bool set (const char *name, const uint32_t value) {
+        _store [_space + "/" + name] = value;
+        return true;
+    }
+    bool get (const char *name, String *value) const {
+        const auto it = _strings.find (_space + "/" + name);
+        if (it == _strings.end ())
+            return false;
+        *value = it->second;
+        return true;
+    }
+    bool set (const char *name, const String &value) {
+        _strings [_space + "/" + name] = value;
+        return true;
+    }
+    static void reset () {
+        _store.clear ();
+        _strings.clear ();
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+// records what the strategies ask of the hardware, so the simulation can derive airflow, power and wear
+class OpenSmart_QuadMotorDriver {
+public:
+    static inline constexpr int MotorCount = 4;
+    static inline constexpr uint8_t I2cAddress = 0x20;
+    typedef std::array<int, MotorCount> MotorSpeedPins;
+
+    typedef struct {
+        uint8_t I2C_ADDR;
+        int PIN_I2C_SDA, PIN_I2C_SCL;
+        MotorSpeedPins PIN_PWMS;
+        int frequency;
+        bool invertedPWM;
+    } Config;
+
+    enum MotorID {
+        MOTOR_ALL = -1,
+        MOTOR_A = 0,
+        MOTOR_B = 1,
+        MOTOR_C = 2,
+        MOTOR_D = 3
+    };
+    enum MotorDirection {
+        MOTOR_CLOCKWISE = 0,
+        MOTOR_ANTICLOCKWISE = 1
+    };
+
+    static inline constexpr int MotorSpeedResolution = 8;
+    typedef uint8_t MotorSpeed;
+
+    struct Motor {
+        MotorSpeed speed = 0;
+        bool enabled = false;
+        unsigned long writes = 0;
+    };
+
+private:
+    std::array<Motor, MotorCount> _motors;
+
+    template <typename F>
+    void apply (const int motorID, F func) {
+        for (int id = 0; id < MotorCount; id++)
+            if (motorID == MOTOR_ALL || motorID == id)
+                func (_motors [id]);
+    }
+
+public:
+    explicit OpenSmart_QuadMotorDriver (const Config &) { }
+    void setSpeed (const MotorSpeed speed, const int motorID = MOTOR_ALL) {
+        apply (motorID, [&] (Motor &motor) { motor.speed = speed, motor.writes++; });
+    }
+    void setDirection (const MotorDirection, const int motorID = MOTOR_ALL) {
+        apply (motorID, [&] (Motor &motor) { motor.enabled = true, motor.writes++; });
+    }
+    void stop (const int motorID = MOTOR_ALL) {
+        apply (motorID, [&] (Motor &motor) { motor.enabled = false, motor.writes++; });
+    }
+    const std::array<Motor, MotorCount> &motors () const {
+        return _motors;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
@@ -0,0 +1,423 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// fan control workbench: runs the real fan interface, strategies, manager and control algorithms
+// against a lumped thermal model of the pack and a simulated motor driver, in simulated time, so
+// that gains / smoothing / strategies can be compared and tuned without waiting for the weather; overshoot is
+// scored against a reference run with every fan flat out whenever above setpoint, on the same weather and load, as
+// much of it cannot be avoided with ambient above setpoint; --check is the build's guard on the shipped defaults
+
+#include <Arduino.h>
+#include "HostComponents.hpp"
+
+#include "utilities/Utilities.hpp"
+#include "batterypack/BatterypackInterfaceFanControllers.hpp"
+#include "batterypack/BatterypackManageFanControllers.hpp"
+#include "program/ProgramConfigFanControl.hpp"
+
+#include <chrono>
+#include <random>
+
+// -----------------------------------------------------------------------------------------------
+
+// the pack as a node per fan along it, each cooled by its own fan, sharing heat with its neighbours, and read
+// by the probes over it; the manager sees the hottest probe, as the firmware does
+struct Model {
+    static inline constexpr size_t NODES = OpenSmart_QuadMotorDriver::MotorCount, PROBES = 15;
+    double HEAT_CAPACITY = 90000.0;                                               // J/K, the whole pack
+    double COUPLING_AMBIENT = 2.0, COUPLING_FAN = 3.0, COUPLING_NODE = 4.0;       // W/K, passive (whole pack), per fan at full speed, between neighbours
+    std::array<double, NODES> LOAD_SHARES = { 0.35, 0.30, 0.20, 0.15 };           // of the heat, uneven along the pack
+    OpenSmart_QuadMotorDriver::MotorSpeed STALL = 80;                             // below which the fan does not turn
+    double FAN_POWER = 2.5;                                                       // W per fan at full speed
+    double AMBIENT_MEAN = 22.0, AMBIENT_SWING = 8.0;                              // daily sinusoid, peaking mid-afternoon
+    double LOAD_IDLE = 5.0, LOAD_CHARGE = 60.0, LOAD_DISCHARGE = 45.0;            // W of heat
+    double LOAD_VARIANCE = 0.3;                                                   // day to day
+    static size_t node (const size_t probe) {
+        return probe * NODES / PROBES;
+    }
+};
+
+struct Parameters {
+    double Kp = DEFAULT_FAN_CONTROL_P, Ki = DEFAULT_FAN_CONTROL_I, Kd = DEFAULT_FAN_CONTROL_D, alpha = DEFAULT_FAN_SMOOTH_A;
+    String control = "pid", strategy = "rotation";
+};
+
+struct Weights {
+    double overshoot = 10.0, energy = 0.05, wear = 0.02;    // per K.h (avoidable), per Wh, per start
+};
+
+struct Result {
+    double overshoot = 0.0, avoidable = 0.0, peak = 0.0, energy = 0.0, runtime = 0.0;    // K.h, K.h above the reference, K, Wh, fan hours
+    unsigned long starts = 0, writes = 0;
+    std::vector<float> trajectory;                                                        // hottest probe per step, when recorded for a reference
+    double score (const Weights &weights) const {
+        return weights.overshoot * avoidable + weights.energy * energy + weights.wear * static_cast<double> (starts);
+    }
+};
+
+// -----------------------------------------------------------------------------------------------
+
+using ProgramInterfaceFanControllersStrategy_motorZones = ProgramInterfaceFanControllersStrategy_motorZonesTemplate<Model::PROBES>;
+
+class ProgramManageFanControllersAlgorithm_full : public ProgramManageFanControllersAlgorithm {    // the reference: full cooling whenever above setpoint
+public:
+    String name () const override {
+        return "full";
+    }
+    double apply (const double, const double) override {
+        return 100.0;
+    }
+    bool smoothed () const override {
+        return false;
+    }
+    void serialize (JsonVariant &) const override { }
+};
+
+class Simulation {
+    static inline constexpr double SETPOINT = DEFAULT_FAN_SETPOINT;
+    static inline constexpr interval_t STEP = 5 * 1000;    // as per the program interval
+
+    const Model &_model;
+    std::mt19937 _random;
+
+    ProgramInterfaceFanControllers::Config _interfaceConfig = {
+        .hardware = {},
+        .DIRECTION = OpenSmart_QuadMotorDriver::MOTOR_CLOCKWISE,
+        .MIN_SPEED = DEFAULT_FAN_MIN_SPEED,
+        .MAX_SPEED = DEFAULT_FAN_MAX_SPEED,
+        .MOTOR_ORDER = { 0, 1, 2, 3 },
+        .MOTOR_ROTATE = DEFAULT_FAN_MOTOR_ROTATE,
+        .MOTOR_PERSIST = DEFAULT_FAN_MOTOR_PERSIST,
+        .output = DEFAULT_FAN_OUTPUT
+    };
+    ProgramManageFanControllers::Config _managerConfig = { .HYSTERESIS = DEFAULT_FAN_HYSTERESIS };
+    MpcController<double>::Config _mpcConfig = DEFAULT_FAN_CONTROL_MPC;
+    ProgramInterfaceFanControllersStrategy_motorZones::Config _zonesConfig = { .WEIGHTS = zoneWeights (), .SHARE_MINIMUM = DEFAULT_FAN_ZONES_SHARE_MINIMUM, .SHARE_CHANGE = DEFAULT_FAN_ZONES_SHARE_CHANGE };
+
+    std::array<double, Model::NODES> _temperatures;
+    double _ambient, _load = 0.0;
+
+    ProgramInterfaceFanControllersStrategy_motorAll _strategyAll;
+    ProgramInterfaceFanControllersStrategy_motorMapWithRotation _strategyRotation;
+    ProgramInterfaceFanControllersStrategy_motorOptimal _strategyOptimal;
+    ProgramInterfaceFanControllersStrategy_motorZones _strategyZones;
+    PidController<double> _pid;
+    MpcController<double> _mpc;
+    AlphaSmoothing<double> _smoothing;
+    ProgramManageFanControllersAlgorithm_pid _algorithmPid;
+    ProgramManageFanControllersAlgorithm_mpc _algorithmMpc;
+    ProgramManageFanControllersAlgorithm_full _algorithmFull;
+    ProgramInterfaceFanControllers _interface;
+    ProgramManageFanControllers _manager;
+
+    static ProgramInterfaceFanControllersStrategy_motorZones::ZoneWeights zoneWeights () {    // as factory_fanZonesCalibration would measure them
+        ProgramInterfaceFanControllersStrategy_motorZones::ZoneWeights weights;
+        for (size_t motorId = 0; motorId < Model::NODES; motorId++)
+            for (size_t probe = 0; probe < Model::PROBES; probe++)
+                weights [motorId][probe] = (Model::node (probe) == motorId) ? 1.0f : (std::abs (static_cast<int> (Model::node (probe)) - static_cast<int> (motorId)) == 1 ? 0.25f : 0.0f);
+        return weights;
+    }
+    ProgramInterfaceFanControllersStrategy &selectStrategy (const String &strategy) {
+        if (strategy == "optimal")
+            return _strategyOptimal;
+        if (strategy == "zones")
+            return _strategyZones;
+        if (strategy == "all")
+            return _strategyAll;
+        return _strategyRotation;
+    }
+    ProgramManageFanControllersAlgorithm &selectControl (const String &control) {
+        if (control == "mpc")
+            return _algorithmMpc;
+        if (control == "full")
+            return _algorithmFull;
+        return _algorithmPid;
+    }
+
+    double ambient (const double hours) const {
+        return _model.AMBIENT_MEAN + _model.AMBIENT_SWING * std::sin (2.0 * M_PI * (hours - 9.0) / 24.0);
+    }
+    double load (const double hours, const double scale) const {
+        const double hour = std::fmod (hours, 24.0);
+        if (hour >= 10.0 && hour < 15.0)
+            return _model.LOAD_IDLE + _model.LOAD_CHARGE * scale;
+        if (hour >= 18.0 && hour < 23.0)
+            return _model.LOAD_IDLE + _model.LOAD_DISCHARGE * scale;
+        return _model.LOAD_IDLE;
+    }
+    std::array<float, Model::PROBES> probes () const {
+        std::array<float, Model::PROBES> temperatures;
+        for (size_t probe = 0; probe < Model::PROBES; probe++)
+            temperatures [probe] = static_cast<float> (_temperatures [Model::node (probe)]);
+        return temperatures;
+    }
+    double hottest () const {
+        return *std::max_element (_temperatures.begin (), _temperatures.end ());
+    }
+
+public:
+    Simulation (const Model &model, const Parameters &parameters, const unsigned seed) :
+        _model (model),
+        _random (seed),
+        _ambient (model.AMBIENT_MEAN),
+        _strategyZones (_zonesConfig, [&] () {
+            return ProgramInterfaceFanControllersStrategy_motorZones::TemperaturesSet (static_cast<float> (SETPOINT), probes ());
+        }),
+        _pid (parameters.Kp, parameters.Ki, parameters.Kd),
+        _mpc (_mpcConfig),
+        _smoothing (parameters.alpha),
+        _algorithmPid (_pid),
+        _algorithmMpc (_mpc, [&] () { return _ambient; }),
+        _interface (_interfaceConfig, selectStrategy (parameters.strategy)),
+        _manager (_managerConfig, _interface, selectControl (parameters.control), _smoothing, [&] () {
+            return ProgramManageFanControllers::TargetSet (static_cast<float> (SETPOINT), static_cast<float> (hottest ()));
+        }) {
+        _temperatures.fill (model.AMBIENT_MEAN);
+    }
+
+    Result run (const double hours, const std::vector<float> *reference = nullptr, const bool record = false) {
+        host::clock_ms = 0;
+        PersistentData::reset ();
+        _interface.begin ();
+        _manager.begin ();
+
+        Result result;
+        std::array<bool, OpenSmart_QuadMotorDriver::MotorCount> spinning {};
+        std::uniform_real_distribution<double> variance (1.0 - _model.LOAD_VARIANCE, 1.0 + _model.LOAD_VARIANCE);
+        double scale = variance (_random);
+        const double step = static_cast<double> (STEP) / 1000.0, stepHours = step / 3600.0;
+        const double capacity = _model.HEAT_CAPACITY / Model::NODES, passive = _model.COUPLING_AMBIENT / Model::NODES;
+        size_t index = 0;
+        for (double now = 0.0; now < hours; now += stepHours, index++) {
+            if (std::fmod (now, 24.0) < stepHours)
+                scale = variance (_random);
+            _ambient = ambient (now), _load = load (now, scale);
+
+            host::advance (STEP);
+            _interface.process ();
+            _manager.process ();
+
+            double power = 0.0;
+            std::array<double, Model::NODES> heat;
+            for (size_t node = 0; node < Model::NODES; node++) {
+                const auto &motor = _interface.getHardware ().motors () [node];
+                const bool turning = motor.enabled && motor.speed >= _model.STALL;
+                const double fraction = turning ? static_cast<double> (motor.speed) / 255.0 : 0.0;
+                if (turning) {
+                    power += _model.FAN_POWER * fraction * fraction * fraction;
+                    result.runtime += stepHours;
+                    if (! spinning [node])
+                        result.starts++;
+                }
+                spinning [node] = turning;
+                heat [node] = _load * _model.LOAD_SHARES [node] - (passive + _model.COUPLING_FAN * fraction) * (_temperatures [node] - _ambient);
+                for (const int neighbour : { static_cast<int> (node) - 1, static_cast<int> (node) + 1 })
+                    if (neighbour >= 0 && neighbour < static_cast<int> (Model::NODES))
+                        heat [node] -= _model.COUPLING_NODE * (_temperatures [node] - _temperatures [neighbour]);
+            }
+            for (size_t node = 0; node < Model::NODES; node++)
+                _temperatures [node] += step * heat [node] / capacity;
+
+            const double temperature = hottest (), excess = std::max (0.0, temperature - SETPOINT);
+            result.overshoot += excess * stepHours, result.peak = std::max (result.peak, excess), result.energy += power * stepHours;
+            if (reference != nullptr && index < reference->size ())
+                result.avoidable += std::max (0.0, temperature - std::max (SETPOINT, static_cast<double> ((*reference) [index]))) * stepHours;
+            if (record)
+                result.trajectory.push_back (static_cast<float> (temperature));
+        }
+        for (const auto &motor : _interface.getHardware ().motors ())
+            result.writes += motor.writes;
+        return result;
+    }
+};
+
+static std::vector<float> referenceRun (const Model &model, const Parameters &parameters, const double hours, const unsigned seed) {    // same weather and load, all fans flat out whenever above setpoint
+    Parameters reference = parameters;
+    reference.control = "full", reference.strategy = "all";
+    return Simulation (model, reference, seed).run (hours, nullptr, true).trajectory;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+using Vector = std::array<double, 4>;    // Kp, Ki, Kd, alpha
+static constexpr Vector BOUNDS_LOWER = { 0.0, 0.0, 0.0, 0.01 }, BOUNDS_UPPER = { 50.0, 1.0, 20.0, 1.0 };
+
+static Vector bounded (Vector x) {
+    for (size_t i = 0; i < x.size (); i++)
+        x [i] = std::clamp (x [i], BOUNDS_LOWER [i], BOUNDS_UPPER [i]);
+    return x;
+}
+static Parameters parameterise (const Parameters &base, const Vector &x) {
+    Parameters parameters = base;
+    parameters.Kp = x [0], parameters.Ki = x [1], parameters.Kd = x [2], parameters.alpha = x [3];
+    return parameters;
+}
+
+struct Evaluator {
+    const Model &model;
+    const Parameters &base;
+    const Weights &weights;
+    const double hours;
+    const unsigned seed;
+    const std::vector<float> reference = referenceRun (model, base, hours, seed);
+    unsigned long count = 0;
+    double operator() (const Vector &x) {
+        count++;
+        return Simulation (model, parameterise (base, bounded (x)), seed).run (hours, &reference).score (weights);
+    }
+};
+
+static Vector searchGrid (Evaluator &evaluate, const int levels) {
+    Vector best = {}, x;
+    double bestScore = std::numeric_limits<double>::max ();
+    std::array<int, 4> index {};
+    while (index [3] < levels) {
+        for (size_t i = 0; i < x.size (); i++)
+            x [i] = BOUNDS_LOWER [i] + (BOUNDS_UPPER [i] - BOUNDS_LOWER [i]) * index [i] / (levels - 1);
+        const double score = evaluate (x);
+        if (score < bestScore)
+            bestScore = score, best = x;
+        for (size_t i = 0; i < index.size () && ++index [i] == levels && i < index.size () - 1; i++)
+            index [i] = 0;
+    }
+    return best;
+}
+
+static Vector searchNelderMead (Evaluator &evaluate, const Vector &start, const int iterations) {
+    static constexpr double REFLECT = 1.0, EXPAND = 2.0, CONTRACT = 0.5, SHRINK = 0.5;
+    constexpr size_t N = std::tuple_size_v<Vector>;
+    std::array<std::pair<Vector, double>, N + 1> simplex;
+    simplex [0] = { bounded (start), evaluate (bounded (start)) };
+    for (size_t i = 0; i < N; i++) {
+        Vector x = start;
+        x [i] += (BOUNDS_UPPER [i] - BOUNDS_LOWER [i]) * 0.1;
+        simplex [i + 1] = { bounded (x), evaluate (bounded (x)) };
+    }
+    const auto point = [] (const Vector &a, const Vector &b, const double t) {    // a + t (b - a)
+        Vector x;
+        for (size_t i = 0; i < N; i++)
+            x [i] = a [i] + t * (b [i] - a [i]);
+        return bounded (x);
+    };
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        std::sort (simplex.begin (), simplex.end (), [] (const auto &a, const auto &b) { return a.second < b.second; });
+        Vector centroid {};
+        for (size_t j = 0; j < N; j++)
+            for (size_t i = 0; i < N; i++)
+                centroid [i] += simplex [j].first [i] / N;
+        auto &worst = simplex [N];
+        const Vector reflected = point (centroid, worst.first, -REFLECT);
+        const double reflectedScore = evaluate (reflected);
+        if (reflectedScore < simplex [0].second) {
+            const Vector expanded = point (centroid, worst.first, -EXPAND);
+            const double expandedScore = evaluate (expanded);
+            worst = (expandedScore < reflectedScore) ? std::pair (expanded, expandedScore) : std::pair (reflected, reflectedScore);
+        } else if (reflectedScore < simplex [N - 1].second) {
+            worst = { reflected, reflectedScore };
+        } else {
+            const Vector contracted = point (centroid, worst.first, CONTRACT);
+            const double contractedScore = evaluate (contracted);
+            if (contractedScore < worst.second)
+                worst = { contracted, contractedScore };
+            else
+                for (size_t j = 1; j <= N; j++)
+                    simplex [j].first = point (simplex [0].first, simplex [j].first, SHRINK), simplex [j].second = evaluate (simplex [j].first);
+        }
+    }
+    std::sort (simplex.begin (), simplex.end (), [] (const auto &a, const auto &b) { return a.second < b.second; });
+    return simplex [0].first;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+static void report (const char *label, const Parameters &parameters, const Result &result, const Weights &weights) {
+    printf ("%s: control=%s, strategy=%s, Kp=%.3f, Ki=%.4f, Kd=%.3f, alpha=%.3f --> overshoot=%.2f K.h (avoidable %.2f K.h, peak %.2f K), energy=%.1f Wh, fan=%.1f h, starts=%lu, writes=%lu, score=%.2f\n",
+            label, parameters.control.c_str (), parameters.strategy.c_str (), parameters.Kp, parameters.Ki, parameters.Kd, parameters.alpha,
+            result.overshoot, result.avoidable, result.peak, result.energy, result.runtime, result.starts, result.writes, result.score (weights));
+}
+static Result simulate (const char *label, const Model &model, const Parameters &parameters, const double hours, const unsigned seed, const Weights &weights) {
+    const std::vector<float> reference = referenceRun (model, parameters, hours, seed);
+    const Result result = Simulation (model, parameters, seed).run (hours, &reference);
+    report (label, parameters, result, weights);
+    return result;
+}
+
+static void usage (const char *name) {
+    fprintf (stderr, "usage: %s [--hours H] [--seed N] [--control pid|mpc|full] [--strategy rotation|optimal|zones|all]\n"
+                     "          [--kp X] [--ki X] [--kd X] [--alpha X] [--search none|grid|nelder-mead] [--levels N] [--iterations N]\n"
+                     "          [--check K.h/day] (exit 1 if the avoidable overshoot is above it, or the energy above the reference's)\n"
+                     "          [--load-charge W] [--load-discharge W] [--ambient-mean C] [--ambient-swing C]\n"
+                     "          [--weight-overshoot X] [--weight-energy X] [--weight-wear X]\n",
+             name);
+}
+
+int main (int argc, char *argv []) {
+    Model model;
+    Parameters parameters;
+    Weights weights;
+    double hours = 24.0 * 365.0, searchHours = 24.0 * 30.0;
+    unsigned seed = 1;
+    String search = "none";
+    int levels = 5, iterations = 100;
+    double check = -1.0;
+
+    for (int i = 1; i < argc; i++) {
+        const String option = argv [i];
+        if (i + 1 >= argc) {
+            usage (argv [0]);
+            return 1;
+        }
+        const char *value = argv [++i];
+        if (option == "--hours") hours = atof (value);
+        else if (option == "--search-hours") searchHours = atof (value);
+        else if (option == "--seed") seed = static_cast<unsigned> (atoi (value));
+        else if (option == "--control") parameters.control = value;
+        else if (option == "--strategy") parameters.strategy = value;
+        else if (option == "--kp") parameters.Kp = atof (value);
+        else if (option == "--ki") parameters.Ki = atof (value);
+        else if (option == "--kd") parameters.Kd = atof (value);
+        else if (option == "--alpha") parameters.alpha = atof (value);
+        else if (option == "--search") search = value;
+        else if (option == "--levels") levels = std::max (2, atoi (value));
+        else if (option == "--iterations") iterations = atoi (value);
+        else if (option == "--check") check = atof (value);
+        else if (option == "--load-charge") model.LOAD_CHARGE = atof (value);
+        else if (option == "--load-discharge") model.LOAD_DISCHARGE = atof (value);
+        else if (option == "--ambient-mean") model.AMBIENT_MEAN = atof (value);
+        else if (option == "--ambient-swing") model.AMBIENT_SWING = atof (value);
+        else if (option == "--weight-overshoot") weights.overshoot = atof (value);
+        else if (option == "--weight-energy") weights.energy = atof (value);
+        else if (option == "--weight-wear") weights.wear = atof (value);
+        else {
+            usage (argv [0]);
+            return 1;
+        }
+    }
+
+    const auto started = std::chrono::steady_clock::now ();
+    Parameters reference = parameters;
+    reference.control = "full", reference.strategy = "all";
+    const Result referenced = simulate ("reference", model, reference, hours, seed, weights);
+    const Result baseline = simulate ("baseline", model, parameters, hours, seed, weights);
+    if (check >= 0.0) {    // for the build: the shipped defaults must not regress
+        const double avoidable = baseline.avoidable / (hours / 24.0);
+        const bool passed = avoidable <= check && baseline.energy <= referenced.energy;
+        printf ("check: %s, avoidable=%.3f K.h/day (limit %.3f), energy=%.1f Wh (reference %.1f Wh)\n", passed ? "PASS" : "FAIL", avoidable, check, baseline.energy, referenced.energy);
+        if (! passed)
+            return 1;
+    }
+    if (search == "grid" || search == "nelder-mead") {
+        Evaluator evaluate { model, parameters, weights, searchHours, seed };
+        const Vector start = { parameters.Kp, parameters.Ki, parameters.Kd, parameters.alpha };
+        const Vector best = (search == "grid") ? searchGrid (evaluate, levels) : searchNelderMead (evaluate, start, iterations);
+        const Parameters tuned = parameterise (parameters, best);
+        printf ("search: %s, %lu evaluations of %.0f hours\n", search.c_str (), evaluate.count, searchHours);
+        simulate ("tuned", model, tuned, hours, seed + 1, weights);    // validate on unseen weather
+    }
+    printf ("elapsed: %.2f s\n", std::chrono::duration<double> (std::chrono::steady_clock::now () - started).count ());
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
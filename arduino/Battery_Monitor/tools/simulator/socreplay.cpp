@@ -0,0 +1,178 @@
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
+
+// state of charge replay: runs the firmware's ChargeEstimatorKalman over a recorded trace of bms samples,
+// as csv "time_ms,current_A,voltage_V[,reference_percent]" (a header line is skipped), and reports the
+// estimate over time and, if the trace carries a reference, the error against it; --generate writes a
+// synthetic trace (with current sensor bias, voltage polarisation and noise) with the true charge as reference
+
+#include <Arduino.h>
+
+#include "batterypack/BatterypackMechanicsChargeEstimation.hpp"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+// -----------------------------------------------------------------------------------------------
+
+using Estimator = ChargeEstimatorKalman<11>;
+
+static Estimator::Config config = {    // as per program/ProgramConfig.hpp
+    .CAPACITY = 280.0f,
+    .EFFICIENCY = 0.99f,
+    .CELLS = 16,
+    .RESISTANCE = 0.02f,
+    .OCV = { { { 0.00f, 2.90f }, { 0.05f, 3.15f }, { 0.10f, 3.22f }, { 0.20f, 3.26f }, { 0.30f, 3.29f }, { 0.50f, 3.31f }, { 0.60f, 3.32f }, { 0.70f, 3.33f }, { 0.80f, 3.34f }, { 0.90f, 3.35f }, { 1.00f, 3.45f } } },
+    .NOISE_PROCESS = 1e-8f,
+    .NOISE_MEASUREMENT = 0.0025f,
+    .REST_CURRENT = 2.0f,
+    .REST_SECONDS = 30.0f * 60.0f,
+    .VARIANCE_INITIAL = 0.01f
+};
+
+struct Sample {
+    double time, current, voltage, reference;
+};
+
+static void usage (const char *name) {
+    fprintf (stderr, "usage: %s [--capacity AH] [--cells N] [--initial PERCENT] [--every S] [--quiet] TRACE.csv\n"
+                     "       %s --generate TRACE.csv [--days N] [--interval S] [--bias A] [--seed N] [--capacity AH] [--cells N]\n",
+             name, name);
+}
+
+static double ocv (const double charge) {    // per cell, from the same table the estimator uses
+    const auto &table = config.OCV;
+    for (size_t i = 1; i < table.size (); i++)
+        if (charge <= table [i].first || i == table.size () - 1)
+            return table [i - 1].second + (table [i].second - table [i - 1].second) * (std::clamp (charge, 0.0, 1.0) - table [i - 1].first) / (table [i].first - table [i - 1].first);
+    return table.back ().second;
+}
+
+static int generate (const char *filename, const double days, const double interval, const double bias, const unsigned seed) {
+    std::ofstream out (filename);
+    if (! out) {
+        fprintf (stderr, "%s: cannot write\n", filename);
+        return 1;
+    }
+    std::mt19937 rng (seed);
+    std::normal_distribution<double> noiseCurrent (0.0, 0.3), noiseVoltage (0.0, 0.01);
+    std::uniform_real_distribution<double> uniform (0.0, 1.0);
+    const double capacity = config.CAPACITY, resistance = config.RESISTANCE, tau = 600.0, polarisationResistance = 0.015;
+    double charge = 0.8, polarisation = 0.0, current = 0.0, until = 0.0;
+    out << "time_ms,current_A,voltage_V,reference_percent\n";
+    for (double t = 0.0; t < days * 86400.0; t += interval) {
+        if (t >= until) {    // phases of drive, charge and rest, of random durations
+            const double r = uniform (rng);
+            if (charge < 0.2 || (r < 0.25 && charge < 0.9))
+                current = 40.0 + 60.0 * uniform (rng), until = t + 3600.0 * (0.5 + 2.0 * uniform (rng));
+            else if (r < 0.6 && charge > 0.3)
+                current = -(10.0 + 90.0 * uniform (rng)), until = t + 3600.0 * (0.2 + 1.5 * uniform (rng));
+            else
+                current = -0.5 * uniform (rng), until = t + 3600.0 * (1.0 + 6.0 * uniform (rng));
+        }
+        if ((charge >= 1.0 && current > 0.0) || (charge <= 0.0 && current < 0.0))
+            current = 0.0;
+        charge = std::clamp (charge + current * interval / (3600.0 * capacity), 0.0, 1.0);
+        polarisation += (current * polarisationResistance - polarisation) * (1.0 - std::exp (-interval / tau));
+        const double voltage = ocv (charge) * config.CELLS + current * resistance + polarisation;
+        char line [128];
+        snprintf (line, sizeof (line), "%.0f,%.2f,%.3f,%.3f\n", t * 1000.0, current + bias + noiseCurrent (rng), voltage + noiseVoltage (rng), charge * 100.0);
+        out << line;
+    }
+    return 0;
+}
+
+static bool parse (const std::string &line, Sample &sample) {
+    std::istringstream fields (line);
+    std::string field;
+    double values [4] = { 0.0, 0.0, 0.0, std::nan ("") };
+    int count = 0;
+    while (count < 4 && std::getline (fields, field, ',')) {
+        char *end;
+        values [count] = strtod (field.c_str (), &end);
+        if (end == field.c_str ())
+            return false;
+        count++;
+    }
+    if (count < 3)
+        return false;
+    sample = { values [0] / 1000.0, values [1], values [2], values [3] };
+    return true;
+}
+
+int main (int argc, char *argv []) {
+    const char *trace = nullptr, *generated = nullptr;
+    double initial = std::nan (""), every = 3600.0, days = 30.0, interval = 15.0, bias = 0.5;
+    unsigned seed = 1;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++) {
+        const String option = argv [i];
+        if (option == "--quiet") {
+            quiet = true;
+            continue;
+        }
+        if (option.startsWith ("--") && i + 1 >= argc) {
+            usage (argv [0]);
+            return 1;
+        }
+        if (option == "--capacity") config.CAPACITY = static_cast<float> (atof (argv [++i]));
+        else if (option == "--cells") config.CELLS = atoi (argv [++i]);
+        else if (option == "--initial") initial = atof (argv [++i]);
+        else if (option == "--every") every = atof (argv [++i]);
+        else if (option == "--generate") generated = argv [++i];
+        else if (option == "--days") days = atof (argv [++i]);
+        else if (option == "--interval") interval = atof (argv [++i]);
+        else if (option == "--bias") bias = atof (argv [++i]);
+        else if (option == "--seed") seed = static_cast<unsigned> (atol (argv [++i]));
+        else if (! option.startsWith ("--") && trace == nullptr) trace = argv [i];
+        else {
+            usage (argv [0]);
+            return 1;
+        }
+    }
+    if (generated != nullptr)
+        return generate (generated, days, interval, bias, seed);
+    if (trace == nullptr) {
+        usage (argv [0]);
+        return 1;
+    }
+    std::ifstream in (trace);
+    if (! in) {
+        fprintf (stderr, "%s: cannot read\n", trace);
+        return 1;
+    }
+
+    Estimator estimator (config);
+    if (! std::isnan (initial))
+        estimator.restore ({ static_cast<float> (initial / 100.0), config.VARIANCE_INITIAL });
+    std::string line;
+    Sample sample, previous = { std::nan (""), 0.0, 0.0, 0.0 };
+    size_t samples = 0, references = 0;
+    double errorSquared = 0.0, errorMaximum = 0.0, reported = -every;
+    const auto started = std::chrono::steady_clock::now ();
+    if (! quiet)
+        printf ("time_h,current_A,voltage_V,estimate_percent,deviation_percent,reference_percent\n");
+    while (std::getline (in, line)) {
+        if (! parse (line, sample))
+            continue;
+        estimator.update (static_cast<float> (sample.current), static_cast<float> (sample.voltage), std::isnan (previous.time) ? 0.0f : static_cast<float> (sample.time - previous.time));
+        previous = sample, samples++;
+        if (! std::isnan (sample.reference)) {
+            const double error = estimator.charge () - sample.reference;
+            errorSquared += error * error, errorMaximum = std::max (errorMaximum, std::abs (error)), references++;
+        }
+        if (! quiet && sample.time - reported >= every)
+            printf ("%.2f,%.1f,%.2f,%.2f,%.2f,%.2f\n", sample.time / 3600.0, sample.current, sample.voltage, estimator.charge (), estimator.deviation (), sample.reference), reported = sample.time;
+    }
+    const double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - started).count ();
+    fprintf (stderr, "samples=%zu, corrections=%u, final=%.2f%% (+/-%.2f%%), %.0f ns/sample", samples, estimator.corrections (), estimator.charge (), estimator.deviation (), samples > 0 ? elapsed * 1e9 / samples : 0.0);
+    if (references > 0)
+        fprintf (stderr, ", reference=%.2f%%, rms=%.2f%%, max=%.2f%%", previous.reference, std::sqrt (errorSquared / references), errorMaximum);
+    fprintf (stderr, "\n");
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------
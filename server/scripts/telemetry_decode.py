@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+
+# decodes the MessagePack telemetry frames (BatteryMonitor/<id>/<type>/msgpack) back into the same json the
+# text topics carry, and reassembles keyframe plus delta frames into full frames; as a library, decode () takes
+# the payload bytes and Assembler.frame () the decoded frames of one stream; as a filter, it reads mosquitto_sub
+# lines formatted as '%t %x' (topic, payload in hex), or plain json lines, and writes full json frames, e.g.
+#   mosquitto_sub -F '%t %x' -t 'BatteryMonitor/+/data' -t 'BatteryMonitor/+/data/msgpack' | telemetry_decode.py
+
+import json
+import struct
+import sys
+
+##################################################################################################################################
+
+class _Reader:
+    def __init__(self, data):
+        self.data, self.offset = data, 0
+    def take(self, n):
+        if self.offset + n > len(self.data):
+            raise ValueError(f"truncated at {self.offset} (wanted {n} of {len(self.data) - self.offset})")
+        chunk = self.data[self.offset:self.offset + n]
+        self.offset += n
+        return chunk
+    def unpack(self, fmt):
+        return struct.unpack('>' + fmt, self.take(struct.calcsize('>' + fmt)))[0]
+
+def _value(r):
+    b = r.unpack('B')
+    if b <= 0x7f: return b
+    if b >= 0xe0: return b - 0x100
+    if 0x80 <= b <= 0x8f: return _map(r, b & 0x0f)
+    if 0x90 <= b <= 0x9f: return _array(r, b & 0x0f)
+    if 0xa0 <= b <= 0xbf: return r.take(b & 0x1f).decode('utf-8')
+    simple = {
+        0xc0: lambda: None, 0xc2: lambda: False, 0xc3: lambda: True,
+        0xc4: lambda: bytes(r.take(r.unpack('B'))), 0xc5: lambda: bytes(r.take(r.unpack('H'))), 0xc6: lambda: bytes(r.take(r.unpack('I'))),
+        0xca: lambda: r.unpack('f'), 0xcb: lambda: r.unpack('d'),
+        0xcc: lambda: r.unpack('B'), 0xcd: lambda: r.unpack('H'), 0xce: lambda: r.unpack('I'), 0xcf: lambda: r.unpack('Q'),
+        0xd0: lambda: r.unpack('b'), 0xd1: lambda: r.unpack('h'), 0xd2: lambda: r.unpack('i'), 0xd3: lambda: r.unpack('q'),
+        0xd9: lambda: r.take(r.unpack('B')).decode('utf-8'), 0xda: lambda: r.take(r.unpack('H')).decode('utf-8'), 0xdb: lambda: r.take(r.unpack('I')).decode('utf-8'),
+        0xdc: lambda: _array(r, r.unpack('H')), 0xdd: lambda: _array(r, r.unpack('I')),
+        0xde: lambda: _map(r, r.unpack('H')), 0xdf: lambda: _map(r, r.unpack('I')),
+    }
+    if b in simple: return simple[b]()
+    raise ValueError(f"unsupported type 0x{b:02x} at {r.offset - 1}")
+
+def _array(r, n):
+    return [_value(r) for _ in range(n)]
+def _map(r, n):
+    return {str(_value(r)): _value(r) for _ in range(n)}
+
+def _float(x):
+    return float(f"{x:.6g}")    # floats arrive as float32, so trim the binary noise (e.g. 3.299999952 -> 3.3)
+def _tidy(v):
+    if isinstance(v, float): return _float(v)
+    if isinstance(v, list): return [_tidy(x) for x in v]
+    if isinstance(v, dict): return {k: _tidy(x) for k, x in v.items()}
+    return v
+
+def decode(data):
+    r = _Reader(bytes(data))
+    v = _value(r)
+    if r.offset != len(r.data):
+        raise ValueError(f"{len(r.data) - r.offset} trailing bytes")
+    return _tidy(v)
+
+def is_msgpack(data):
+    return len(data) > 0 and (0x80 <= data[0] <= 0x8f or data[0] in (0xde, 0xdf))
+
+##################################################################################################################################
+
+_HEADERS = ('type', 'time', 'addr')
+
+def _structured(v):
+    return isinstance(v, (dict, list))
+
+def _apply(target, change):
+    for k, v in change.items():
+        if isinstance(target, list):
+            k = int(k)
+        elif v is None:
+            target.pop(k, None)
+            continue
+        if isinstance(v, dict) and _structured(target[k] if isinstance(target, list) else target.get(k)):
+            _apply(target[k], v)
+        else:
+            target[k] = v
+
+class Assembler:
+    # a keyframe ("key": true) replaces the state, a delta applies to it if its "seq" follows on, otherwise the
+    # stream has a gap and deltas are dropped until the next keyframe; frames without "seq" are already full
+    def __init__(self):
+        self.state, self.expected, self.dropped = None, None, 0
+    def frame(self, frame):
+        if 'seq' not in frame:
+            return frame
+        seq = frame.pop('seq')
+        if frame.pop('key', False):
+            self.state = frame
+        elif self.state is None or seq != self.expected:
+            self.state, self.dropped = None, self.dropped + 1
+            return None
+        else:
+            _apply(self.state, {k: v for k, v in frame.items() if k not in _HEADERS})
+            self.state.update({k: frame[k] for k in _HEADERS if k in frame})
+        self.expected = seq + 1
+        return json.loads(json.dumps(self.state))
+
+##################################################################################################################################
+
+def main():
+    assemblers = {}
+    for line in sys.stdin:
+        line = line.rstrip('\n')
+        if line.startswith('{'):
+            topic, data = '', line.encode('utf-8')    # plain json, one stream
+        else:
+            topic, _, payload = line.rpartition(' ')
+            try:
+                data = bytes.fromhex(payload)
+            except ValueError:
+                print(line, flush=True)    # neither, pass it through
+                continue
+        try:
+            frame = decode(data) if is_msgpack(data) else json.loads(data.decode('utf-8'))
+        except ValueError as e:
+            print(f"telemetry_decode: {topic}: {e}", file=sys.stderr)
+            continue
+        stream = topic.removesuffix('/msgpack')
+        frame = assemblers.setdefault(stream, Assembler()).frame(frame) if isinstance(frame, dict) else frame
+        if frame is not None:
+            print(json.dumps(frame, separators=(',', ':')), flush=True)
+        else:
+            print(f"telemetry_decode: {topic}: delta without its keyframe, dropped", file=sys.stderr)
+
+if __name__ == '__main__':
+    main()